@@ -158,6 +158,20 @@ void QextSerialPortPrivate::setBaudRate(BaudRateType baudRate, bool update)
     }
 }
 
+#ifdef Q_OS_UNIX
+void QextSerialPortPrivate::setCustomBaudRate(int baudRate, bool update)
+{
+    if (baudRate <= 0) {
+        QESP_WARNING()<<"QextSerialPort does not support baudRate:"<<baudRate;
+        return;
+    }
+    Settings.BaudRate=(BaudRateType)baudRate;
+    settingsDirtyFlags |= DFE_BaudRate;
+    if (update && q_func()->isOpen())
+        updatePortSettings();
+}
+#endif
+
 void QextSerialPortPrivate::setParity(ParityType parity, bool update)
 {
     switch (parity) {
@@ -697,6 +711,33 @@ ulong QextSerialPort::lastError() const
     return d_func()->lastErr;
 }
 
+#ifdef Q_OS_UNIX
+/*!
+    Returns the file descriptor of the open port, or -1 if the port is not open.
+    Useful for callers that want to poll() the port from their own thread, which
+    is best done with a port opened in Polling mode.
+*/
+int QextSerialPort::handle() const
+{
+    QReadLocker locker(&d_func()->lock);
+    return isOpen() ? d_func()->fd : -1;
+}
+
+/*!
+    Sets the baud rate to any \a baudRate the driver can manage, not just the
+    BaudRateType values. A rate with no Bxxx constant is set with termios2 and
+    BOTHER on Linux and with IOSSIOSPEED on MacOS. Other systems fall back to
+    38400, check baudRate() and lastError() after opening.
+*/
+void QextSerialPort::setCustomBaudRate(int baudRate)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    if (d->Settings.BaudRate != baudRate)
+        d->setCustomBaudRate(baudRate, true);
+}
+#endif
+
 /*!
     Returns the line status as stored by the port function.  This function will retrieve the states
     of the following lines: DCD, CTS, DSR, and RI.  On POSIX systems, the following additional lines
@@ -204,6 +204,10 @@ public:
 
     ulong lineStatus();
     QString errorString();
+#ifdef Q_OS_UNIX
+    int handle() const;
+    void setCustomBaudRate(int baudRate);
+#endif
 
 public Q_SLOTS:
     void setPortName(const QString & name);
@@ -24,7 +24,8 @@ qextserialport-library:!qextserialport-buildlib {
                               $$PWD/qextserialport_global.h
     SOURCES                += $$PWD/qextserialport.cpp \
                               $$PWD/qextserialenumerator.cpp
-    unix:SOURCES           += $$PWD/qextserialport_unix.cpp
+    unix:SOURCES           += $$PWD/qextserialport_unix.cpp \
+                              $$PWD/qextserialport_custombaud.cpp
     unix:!macx:SOURCES     += $$PWD/qextserialenumerator_unix.cpp
     macx:SOURCES           += $$PWD/qextserialenumerator_osx.cpp
     win32:SOURCES          += $$PWD/qextserialport_win.cpp \
@@ -0,0 +1,78 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+/*
+    Rates that have no Bxxx constant. This lives in its own file because
+    Linux's <asm/termbits.h> declares a struct termios of its own and can't
+    be included alongside <termios.h>.
+*/
+#if defined(__linux__)
+#  include <asm/termbits.h>
+#  include <asm/ioctls.h>
+extern "C" int ioctl(int fd, unsigned long request, ...);
+#elif defined(__APPLE__)
+#  include <sys/ioctl.h>
+#  include <IOKit/serial/ioss.h>
+#endif
+
+/*
+    Sets the line speed of the open port \a fd to \a baudRate bits per second.
+    Has to be called after tcsetattr(), which would put the old speed back.
+    Returns false if the platform or driver can't do it.
+*/
+bool qesp_setCustomBaudRate(int fd, int baudRate)
+{
+#if defined(__linux__) && defined(TCGETS2) && defined(BOTHER)
+    struct termios2 tio;
+
+    if (::ioctl(fd, TCGETS2, &tio) < 0)
+        return false;
+
+    tio.c_cflag &= ~CBAUD;
+    tio.c_cflag |= BOTHER;
+    tio.c_ospeed = baudRate;
+#  ifdef IBSHIFT
+    tio.c_cflag &= ~(CBAUD << IBSHIFT);
+    tio.c_cflag |= BOTHER << IBSHIFT;
+#  endif
+    tio.c_ispeed = baudRate;
+
+    return ::ioctl(fd, TCSETS2, &tio) == 0;
+#elif defined(__APPLE__) && defined(IOSSIOSPEED)
+    speed_t speed = baudRate;
+
+    return ::ioctl(fd, IOSSIOSPEED, &speed) == 0;
+#else
+    (void)fd;
+    (void)baudRate;
+    return false;
+#endif
+}
@@ -191,6 +191,7 @@ public:
     QSocketNotifier *readNotifier;
     struct termios Posix_CommConfig;
     struct termios old_termios;
+    bool customBaudRate;
 #elif (defined Q_OS_WIN)
     HANDLE Win_Handle;
     OVERLAPPED overlap;
@@ -209,6 +210,9 @@ public:
 
     /*fill PortSettings*/
     void setBaudRate(BaudRateType baudRate, bool update=true);
+#ifdef Q_OS_UNIX
+    void setCustomBaudRate(int baudRate, bool update=true);
+#endif
     void setDataBits(DataBitsType dataBits, bool update=true);
     void setParity(ParityType parity, bool update=true);
     void setStopBits(StopBitsType stopbits, bool update=true);
@@ -239,4 +243,8 @@ public:
     QextSerialPort * q_ptr;
 };
 
+#ifdef Q_OS_UNIX
+bool qesp_setCustomBaudRate(int fd, int baudRate);
+#endif
+
 #endif //_QEXTSERIALPORT_P_H_
@@ -46,6 +46,7 @@ void QextSerialPortPrivate::platformSpecificInit()
 {
     fd = 0;
     readNotifier = 0;
+    customBaudRate = false;
 }
 
 /*!
@@ -242,6 +243,7 @@ void QextSerialPortPrivate::updatePortSettings()
         return;
 
     if (settingsDirtyFlags & DFE_BaudRate) {
+        customBaudRate = false;
         switch (Settings.BaudRate) {
         case BAUD50:
             setBaudRate2Termios(&Posix_CommConfig, B50);
@@ -340,6 +342,11 @@ void QextSerialPortPrivate::updatePortSettings()
             setBaudRate2Termios(&Posix_CommConfig, B4000000);
             break;
 #endif
+        default:
+            /*no Bxxx constant, the real rate goes in after tcsetattr() below*/
+            setBaudRate2Termios(&Posix_CommConfig, B38400);
+            customBaudRate = true;
+            break;
         }
     }
     if (settingsDirtyFlags & DFE_Parity) {
@@ -426,9 +433,16 @@ void QextSerialPortPrivate::updatePortSettings()
     }
 
     /*if any thing in Posix_CommConfig changed, flush*/
-    if (settingsDirtyFlags & DFE_Settings_Mask)
+    if (settingsDirtyFlags & DFE_Settings_Mask) {
         ::tcsetattr(fd, TCSAFLUSH, &Posix_CommConfig);
 
+        /*tcsetattr() just put the port back to 38400*/
+        if (customBaudRate && !qesp_setCustomBaudRate(fd, Settings.BaudRate)) {
+            QESP_WARNING()<<"QextSerialPort could not set custom baudRate:"<<Settings.BaudRate;
+            lastErr = E_INVALID_DEVICE;
+        }
+    }
+
     if (settingsDirtyFlags & DFE_TimeOut) {
         int millisec = Settings.Timeout_Millisec;
         if (millisec == -1) {
@@ -24,8 +24,13 @@
 #include "SerialPortDlg.h"
 #include "ZigbeeCommon.h"
 
+#ifdef Q_OS_UNIX
+#define NUM_PORT_SPEEDS 8
+static int port_speed[NUM_PORT_SPEEDS] = { 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600 };
+#else
 #define NUM_PORT_SPEEDS 5
 static int port_speed[NUM_PORT_SPEEDS] = { 9600, 19200, 38400, 57600, 115200 }; 
+#endif
 
 
 SerialPortDlg::SerialPortDlg(QWidget *parent, QSettings *settings)
@@ -52,6 +57,7 @@ void SerialPortDlg::onOK()
 
 	m_settings->setValue(ZIGBEE_PORT, port);
 	m_settings->setValue(ZIGBEE_SPEED, speed);
+	m_settings->setValue(ZIGBEE_FLOW_CONTROL, m_flowControlCheck->isChecked());
 
 	accept();
 }
@@ -119,8 +125,18 @@ void SerialPortDlg::layoutWindow()
 			m_speedCombo->setCurrentIndex(i);
 	}
 
+	// keep a custom rate from the ini rather than lose it on Ok
+	if (m_speedCombo->findData(currentSpeed) < 0) {
+		m_speedCombo->addItem(QString::number(currentSpeed), currentSpeed);
+		m_speedCombo->setCurrentIndex(m_speedCombo->count() - 1);
+	}
+
 	formLayout->addRow("Port Speed", m_speedCombo);
 
+	m_flowControlCheck = new QCheckBox(this);
+	m_flowControlCheck->setChecked(m_settings->value(ZIGBEE_FLOW_CONTROL, false).toBool());
+	formLayout->addRow("RTS/CTS", m_flowControlCheck);
+
 	QHBoxLayout *btnLayout = new QHBoxLayout();
 	m_okBtn = new QPushButton("Ok", this);
 	m_okBtn->setMaximumSize(QSize(80, 24));
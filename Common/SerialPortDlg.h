@@ -24,6 +24,7 @@
 #include <qsettings.h>
 #include <qpushbutton.h>
 #include <qcombobox.h>
+#include <qcheckbox.h>
 
 
 class SerialPortDlg : public QDialog
@@ -45,6 +46,7 @@ private:
 
 	QComboBox *m_portCombo;
 	QComboBox *m_speedCombo;
+	QCheckBox *m_flowControlCheck;
 
 	QPushButton *m_okBtn;
 	QPushButton *m_cancelBtn;
@@ -0,0 +1,144 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "ZigbeeATBatch.h"
+#include "ZigbeeCommon.h"
+#include "ZigbeeUtils.h"
+
+
+// over everything after the length
+static char frameChecksum(const QByteArray &packet)
+{
+	quint8 sum = 0;
+
+	for (int i = 3; i < packet.length(); i++)
+		sum += 0xff & packet.at(i);
+
+	return (char)(0xff - sum);
+}
+
+
+ZigbeeATBatch::ZigbeeATBatch()
+{
+	m_id = 0;
+	m_apply = false;
+	m_timeout = ZIGBEE_DEFAULT_AT_BATCH_TIMEOUT;
+	m_pending = 0;
+}
+
+void ZigbeeATBatch::read(quint64 address, quint16 command)
+{
+	ZigbeeATCommand atCommand;
+
+	atCommand.m_address = address;
+	atCommand.m_command = command;
+
+	m_commands.append(atCommand);
+}
+
+void ZigbeeATBatch::write(quint64 address, quint16 command, const QByteArray &param)
+{
+	ZigbeeATCommand atCommand;
+
+	atCommand.m_address = address;
+	atCommand.m_command = command;
+	atCommand.m_write = true;
+	atCommand.m_param = param;
+
+	m_commands.append(atCommand);
+}
+
+// hold the writes until an AC at the end instead of applying each one
+void ZigbeeATBatch::setApply(bool apply)
+{
+	m_apply = apply;
+}
+
+void ZigbeeATBatch::setTimeout(int msecs)
+{
+	m_timeout = msecs;
+}
+
+int ZigbeeATBatch::count() const
+{
+	return m_commands.count();
+}
+
+// every command, apply changes included, came back with an OK status
+bool ZigbeeATBatch::succeeded() const
+{
+	for (int i = 0; i < m_commands.count(); i++) {
+		if (m_commands.at(i).m_status != 0)
+			return false;
+	}
+
+	return true;
+}
+
+// true while anything other than the apply changes is unanswered, the
+// AC frames wait until then
+bool ZigbeeATBatch::waitingOnChanges() const
+{
+	for (int i = 0; i < m_commands.count(); i++) {
+		const ZigbeeATCommand &atCommand = m_commands.at(i);
+
+		if (!atCommand.m_applyChanges && atCommand.m_status == ZIGBEE_AT_STATUS_PENDING)
+			return true;
+	}
+
+	return false;
+}
+
+// ZIGBEE_FT_AT_COMMAND applies a write straight away, the queued form
+// holds it until an AC. The frame id stays 0 and is leased on the way out.
+QByteArray ZigbeeATBatch::buildATCommand(quint8 frameType, quint16 command, const QByteArray &param)
+{
+	QByteArray packet;
+
+	packet.append(ZIGBEE_START_DELIM);
+	putU16(&packet, 4 + param.length());
+	packet.append(frameType);
+	packet.append((char)0x00); // frame id
+	putU16(&packet, command);
+	packet.append(param);
+	packet.append(frameChecksum(packet));
+
+	return packet;
+}
+
+// options 0x02 applies a write straight away, 0 leaves it for an AC
+QByteArray ZigbeeATBatch::buildRemoteATCommand(quint64 address, quint16 netAddress, quint8 options,
+	quint16 command, const QByteArray &param)
+{
+	QByteArray packet;
+
+	packet.append(ZIGBEE_START_DELIM);
+	putU16(&packet, 15 + param.length());
+	packet.append(ZIGBEE_FT_REMOTE_AT_COMMAND);
+	packet.append((char)0x00); // frame id
+	putU64(&packet, address);
+	putU16(&packet, netAddress);
+	packet.append(options);
+	putU16(&packet, command);
+	packet.append(param);
+	packet.append(frameChecksum(packet));
+
+	return packet;
+}
@@ -0,0 +1,95 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef ZIGBEE_AT_BATCH_H
+#define ZIGBEE_AT_BATCH_H
+
+#include <qbytearray.h>
+#include <qlist.h>
+
+// m_status of a command that hasn't been answered and of one whose
+// response never came, otherwise it is the radio's AT status byte
+#define ZIGBEE_AT_STATUS_PENDING          -1
+#define ZIGBEE_AT_STATUS_TIMEOUT          -2
+
+// msecs a command in a batch waits for its response by default
+#define ZIGBEE_DEFAULT_AT_BATCH_TIMEOUT   5000
+
+// most commands in one batch, the apply changes included
+#define ZIGBEE_MAX_AT_BATCH               256
+
+// One AT read or write in a batch. The address is the remote radio, 0 for
+// the local one. A read has no param. The status and value are filled in
+// from the response, the value is whatever data came back with it.
+class ZigbeeATCommand
+{
+public:
+	ZigbeeATCommand() : m_address(0), m_command(0), m_write(false), m_applyChanges(false),
+		m_status(ZIGBEE_AT_STATUS_PENDING), m_sent(false) {}
+
+	quint64 m_address;
+	quint16 m_command;
+	bool m_write;
+	QByteArray m_param;
+
+	// the AC the controller adds at the end for each radio written to
+	bool m_applyChanges;
+
+	int m_status;
+	QByteArray m_value;
+
+	// the frame as it is queued and whether it has been
+	QByteArray m_frame;
+	bool m_sent;
+};
+
+// A set of AT commands handed to the controller in one go. They are all
+// queued together, with a few in flight at a time, and each response is
+// matched to its command by frame id rather than by command code. With
+// apply set, writes are held by the radio until a single AC goes to each
+// radio that was written to, once every other command has its answer.
+// The finished batch comes back in one atBatchComplete() signal.
+class ZigbeeATBatch
+{
+public:
+	ZigbeeATBatch();
+
+	void read(quint64 address, quint16 command);
+	void write(quint64 address, quint16 command, const QByteArray &param);
+	void setApply(bool apply);
+	void setTimeout(int msecs);
+
+	int count() const;
+	bool succeeded() const;
+	bool waitingOnChanges() const;
+
+	static QByteArray buildATCommand(quint8 frameType, quint16 command, const QByteArray &param);
+	static QByteArray buildRemoteATCommand(quint64 address, quint16 netAddress, quint8 options,
+		quint16 command, const QByteArray &param);
+
+	// set by the controller when the batch is submitted, never 0
+	quint32 m_id;
+	bool m_apply;
+	int m_timeout;
+	int m_pending;
+	QList<ZigbeeATCommand> m_commands;
+};
+
+#endif // ZIGBEE_AT_BATCH_H
@@ -0,0 +1,204 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <string.h>
+
+#include <qfile.h>
+
+#include "ZigbeeAddressCache.h"
+#include "ZigbeeCommon.h"
+#include "ZigbeeUtils.h"
+
+#define CACHE_MAGIC           "ZBNA"
+#define CACHE_VERSION         1
+#define CACHE_HEADER_LEN      18
+#define CACHE_RECORD_LEN      10
+
+// more than any network we would see, anything bigger is a bad file
+#define CACHE_MAX_RECORDS     65536
+
+
+ZigbeeAddressCache::ZigbeeAddressCache()
+{
+	m_panID = 0;
+	m_dirty = false;
+}
+
+void ZigbeeAddressCache::clear()
+{
+	m_map.clear();
+	m_panID = 0;
+	m_dirty = false;
+}
+
+bool ZigbeeAddressCache::load(const QString &path)
+{
+	clear();
+
+	QFile file(path);
+
+	// not there yet is normal the first time
+	if (!file.exists())
+		return false;
+
+	if (!file.open(QIODevice::ReadOnly)) {
+		qDebug("Error opening address cache %s", qPrintable(path));
+		return false;
+	}
+
+	QByteArray data = file.readAll();
+
+	file.close();
+
+	if (data.length() < CACHE_HEADER_LEN || memcmp(data.constData(), CACHE_MAGIC, 4)
+			|| data.at(4) != CACHE_VERSION) {
+		qDebug("%s is not an address cache", qPrintable(path));
+		return false;
+	}
+
+	quint32 count = getU32(data, 14);
+
+	if (count > CACHE_MAX_RECORDS || data.length() != CACHE_HEADER_LEN + (int)count * CACHE_RECORD_LEN) {
+		qDebug("Address cache %s is truncated or corrupt", qPrintable(path));
+		return false;
+	}
+
+	m_panID = getU64(data, 6);
+
+	for (int pos = CACHE_HEADER_LEN; pos < data.length(); pos += CACHE_RECORD_LEN) {
+		quint64 address = getU64(data, pos);
+		quint16 netAddress = getU16(data, pos + 8);
+
+		if (address != 0 && netAddress != ZIGBEE_BROADCAST_ADDRESS)
+			m_map.insert(address, netAddress);
+	}
+
+	return true;
+}
+
+bool ZigbeeAddressCache::save(const QString &path) const
+{
+	QByteArray data;
+
+	data.reserve(CACHE_HEADER_LEN + m_map.count() * CACHE_RECORD_LEN);
+	data.append(CACHE_MAGIC, 4);
+	data.append((char)CACHE_VERSION);
+	data.append((char)0);
+	putU64(&data, m_panID);
+	putU32(&data, m_map.count());
+
+	QHash<quint64, quint16>::const_iterator it;
+
+	for (it = m_map.constBegin(); it != m_map.constEnd(); ++it) {
+		putU64(&data, it.key());
+		putU16(&data, it.value());
+	}
+
+	QString tmpPath = path + ".tmp";
+	QFile file(tmpPath);
+
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qDebug("Error opening address cache %s", qPrintable(tmpPath));
+		return false;
+	}
+
+	bool ok = file.write(data) == data.length();
+
+	file.close();
+
+	// QFile::rename() won't replace an existing file
+	if (ok) {
+		QFile::remove(path);
+		ok = QFile::rename(tmpPath, path);
+	}
+
+	if (!ok) {
+		qDebug("Error writing address cache %s", qPrintable(path));
+		QFile::remove(tmpPath);
+	}
+
+	return ok;
+}
+
+bool ZigbeeAddressCache::lookup(quint64 address, quint16 *netAddress) const
+{
+	QHash<quint64, quint16>::const_iterator it = m_map.constFind(address);
+
+	if (it == m_map.constEnd())
+		return false;
+
+	*netAddress = it.value();
+
+	return true;
+}
+
+void ZigbeeAddressCache::update(quint64 address, quint16 netAddress)
+{
+	if (address == 0 || netAddress == ZIGBEE_BROADCAST_ADDRESS) {
+		invalidate(address);
+		return;
+	}
+
+	QHash<quint64, quint16>::iterator it = m_map.find(address);
+
+	if (it != m_map.end() && it.value() == netAddress)
+		return;
+
+	m_map.insert(address, netAddress);
+	m_dirty = true;
+}
+
+void ZigbeeAddressCache::invalidate(quint64 address)
+{
+	if (m_map.remove(address) > 0)
+		m_dirty = true;
+}
+
+// addresses learned on another PAN mean nothing on this one
+void ZigbeeAddressCache::setPanID(quint64 panID)
+{
+	if (panID == m_panID)
+		return;
+
+	if (m_panID != 0 && !m_map.isEmpty())
+		m_map.clear();
+
+	m_panID = panID;
+	m_dirty = true;
+}
+
+quint64 ZigbeeAddressCache::panID() const
+{
+	return m_panID;
+}
+
+int ZigbeeAddressCache::count() const
+{
+	return m_map.count();
+}
+
+bool ZigbeeAddressCache::isDirty() const
+{
+	return m_dirty;
+}
+
+void ZigbeeAddressCache::setDirty(bool dirty)
+{
+	m_dirty = dirty;
+}
@@ -0,0 +1,66 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef ZIGBEE_ADDRESS_CACHE_H
+#define ZIGBEE_ADDRESS_CACHE_H
+
+#include <qglobal.h>
+#include <qhash.h>
+#include <qstring.h>
+
+// The 64 to 16-bit address map, kept on disk so a restarted gateway can
+// address nodes directly instead of making the radio broadcast a network
+// address discovery for each one.
+//
+// The file starts with "ZBNA", a version byte, a reserved byte, the 8 byte
+// PAN ID the addresses belong to and a 4 byte record count. Each record is
+// the 8 byte address and its 2 byte network address, big-endian. The
+// whole file is written to path.tmp first and renamed over the old one.
+//
+// Entries are only hints. A transmit status confirms or corrects them and
+// a delivery failure drops them.
+//
+// Not thread safe, the controller holds m_statsMutex around every call.
+class ZigbeeAddressCache
+{
+public:
+	ZigbeeAddressCache();
+
+	void clear();
+	bool load(const QString &path);
+	bool save(const QString &path) const;
+
+	bool lookup(quint64 address, quint16 *netAddress) const;
+	void update(quint64 address, quint16 netAddress);
+	void invalidate(quint64 address);
+
+	void setPanID(quint64 panID);
+	quint64 panID() const;
+	int count() const;
+
+	bool isDirty() const;
+	void setDirty(bool dirty);
+
+private:
+	QHash<quint64, quint16> m_map;
+	quint64 m_panID;
+	bool m_dirty;
+};
+
+#endif // ZIGBEE_ADDRESS_CACHE_H
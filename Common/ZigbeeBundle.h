@@ -0,0 +1,59 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef ZIGBEE_BUNDLE_H
+#define ZIGBEE_BUNDLE_H
+
+#include <qbytearray.h>
+
+#include "ZigbeeCommon.h"
+
+#define ZIGBEE_DEFAULT_BUNDLE_WINDOW 5
+#define ZIGBEE_MAX_BUNDLE_WINDOW 100
+
+// Small messages for a device with bundle=true held back for up to the
+// bundle window and sent together in one transmit request. Each message
+// is a length byte followed by that many bytes of data. The due time is
+// msecs on the controller's clock, the 16-bit address the latest one the
+// controller had when a message was added.
+class ZigbeeBundle
+{
+public:
+	ZigbeeBundle() : m_netAddress(ZIGBEE_BROADCAST_ADDRESS), m_priority(ZIGBEE_TX_INTERACTIVE), m_due(0), m_count(0) {}
+
+	// false if data won't fit in maxPayload along with what is already here
+	bool append(const QByteArray &data, int maxPayload) {
+		if (data.length() > 0xff || m_data.length() + 1 + data.length() > maxPayload)
+			return false;
+
+		m_data.append((char)data.length());
+		m_data.append(data);
+		m_count++;
+
+		return true;
+	}
+
+	QByteArray m_data;
+	quint16 m_netAddress;
+	int m_priority;
+	qint64 m_due;
+	int m_count;
+};
+
+#endif // ZIGBEE_BUNDLE_H
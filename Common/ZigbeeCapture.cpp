@@ -0,0 +1,169 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <string.h>
+
+#include "ZigbeeCapture.h"
+#include "ZigbeeUtils.h"
+
+#define CAPTURE_MAGIC           "ZBCAP"
+#define CAPTURE_VERSION         1
+#define CAPTURE_HEADER_LEN      8
+#define CAPTURE_RECORD_LEN      11
+
+
+ZigbeeCapture::ZigbeeCapture()
+{
+	m_file = NULL;
+	m_apiMode = 1;
+}
+
+ZigbeeCapture::~ZigbeeCapture()
+{
+	close();
+}
+
+bool ZigbeeCapture::openWrite(const QString &path, int apiMode)
+{
+	char header[CAPTURE_HEADER_LEN];
+
+	close();
+
+	QMutexLocker lock(&m_mutex);
+
+	m_file = new QFile(path);
+
+	if (!m_file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qDebug("Error opening capture file %s", qPrintable(path));
+		delete m_file;
+		m_file = NULL;
+		return false;
+	}
+
+	m_apiMode = apiMode;
+
+	memcpy(header, CAPTURE_MAGIC, 5);
+	header[5] = CAPTURE_VERSION;
+	header[6] = apiMode;
+	header[7] = 0;
+
+	m_file->write(header, CAPTURE_HEADER_LEN);
+
+	m_clock.start();
+
+	return true;
+}
+
+bool ZigbeeCapture::openRead(const QString &path)
+{
+	char header[CAPTURE_HEADER_LEN];
+
+	close();
+
+	QMutexLocker lock(&m_mutex);
+
+	m_file = new QFile(path);
+
+	if (!m_file->open(QIODevice::ReadOnly)) {
+		qDebug("Error opening capture file %s", qPrintable(path));
+		delete m_file;
+		m_file = NULL;
+		return false;
+	}
+
+	if (m_file->read(header, CAPTURE_HEADER_LEN) != CAPTURE_HEADER_LEN
+			|| memcmp(header, CAPTURE_MAGIC, 5) || header[5] != CAPTURE_VERSION) {
+		qDebug("%s is not a capture file", qPrintable(path));
+		delete m_file;
+		m_file = NULL;
+		return false;
+	}
+
+	m_apiMode = header[6];
+
+	return true;
+}
+
+void ZigbeeCapture::close()
+{
+	QMutexLocker lock(&m_mutex);
+
+	if (m_file) {
+		m_file->close();
+		delete m_file;
+		m_file = NULL;
+	}
+}
+
+bool ZigbeeCapture::isOpen() const
+{
+	return m_file != NULL;
+}
+
+int ZigbeeCapture::apiMode() const
+{
+	return m_apiMode;
+}
+
+// the rx and tx sides of the controller can be on different threads
+void ZigbeeCapture::write(int direction, const char *data, int len)
+{
+	char record[CAPTURE_RECORD_LEN];
+
+	QMutexLocker lock(&m_mutex);
+
+	if (!m_file || len <= 0 || len > 0xffff)
+		return;
+
+	quint64 nsecs = m_clock.nsecsElapsed();
+
+	for (int i = 0; i < 8; i++)
+		record[i] = 0xff & (nsecs >> (56 - (8 * i)));
+
+	record[8] = direction;
+	record[9] = 0xff & (len >> 8);
+	record[10] = 0xff & len;
+
+	m_file->write(record, CAPTURE_RECORD_LEN);
+	m_file->write(data, len);
+}
+
+bool ZigbeeCapture::read(qint64 *nsecs, int *direction, QByteArray *data)
+{
+	char record[CAPTURE_RECORD_LEN];
+
+	QMutexLocker lock(&m_mutex);
+
+	if (!m_file)
+		return false;
+
+	if (m_file->read(record, CAPTURE_RECORD_LEN) != CAPTURE_RECORD_LEN)
+		return false;
+
+	*nsecs = (qint64)getU64(record);
+	*direction = record[8];
+
+	int len = getU16(record + 9);
+
+	*data = m_file->read(len);
+
+	// a capture cut short by a crash
+	return data->length() == len;
+}
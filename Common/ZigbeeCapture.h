@@ -0,0 +1,63 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef ZIGBEE_CAPTURE
+#define ZIGBEE_CAPTURE
+
+#include <qglobal.h>
+#include <qbytearray.h>
+#include <qstring.h>
+#include <qfile.h>
+#include <qmutex.h>
+#include <qelapsedtimer.h>
+
+#define ZIGBEE_CAPTURE_RX       0
+#define ZIGBEE_CAPTURE_TX       1
+
+// A timestamped record of the raw serial bytes in both directions, exactly
+// as they went over the wire, so escaped if the radio was in AP=2.
+//
+// The file starts with "ZBCAP", a version byte, the API mode byte and a
+// reserved byte. Each record is an 8 byte nsec timestamp from when the
+// capture was opened, a direction byte, a 2 byte length and the data.
+// Numbers are big-endian like everything else on the wire.
+class ZigbeeCapture
+{
+public:
+	ZigbeeCapture();
+	~ZigbeeCapture();
+
+	bool openWrite(const QString &path, int apiMode);
+	bool openRead(const QString &path);
+	void close();
+	bool isOpen() const;
+	int apiMode() const;
+
+	void write(int direction, const char *data, int len);
+	bool read(qint64 *nsecs, int *direction, QByteArray *data);
+
+private:
+	QFile *m_file;
+	QMutex m_mutex;
+	QElapsedTimer m_clock;
+	int m_apiMode;
+};
+
+#endif // ZIGBEE_CAPTURE
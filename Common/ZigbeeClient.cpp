@@ -79,8 +79,12 @@ void ZigbeeClient::appClientReceiveMulticast(int servicePort, SYNTRO_EHEAD *mult
 
 	len -= sizeof(SYNTRO_RECORD_HEADER) + sizeof(quint64);
 
-	if (address == 0)
+	if (address == 0 && len >= 2 && ((p[8] << 8) | p[9]) == ZIGBEE_GATEWAY_DELIVERY_REPORT)
+		processDeliveryReport(QByteArray((const char *)(p + 8), len));
+	else if (address == 0)
 		processRadioList(QByteArray((const char *)(p + 8), len));
+	else if (convertUC2ToInt(head->subType) == ZIGBEE_RECORD_IO_SAMPLE)
+		processIOSample(address, QByteArray((const char *)(p + 8), len));
 	else
 		emit receiveData(address, QByteArray((const char *)(p + 8), len));
 
@@ -89,6 +93,24 @@ void ZigbeeClient::appClientReceiveMulticast(int servicePort, SYNTRO_EHEAD *mult
 	free(multicast);
 }
 
+// the gateway's replies to what we send it, only tx notices for now
+void ZigbeeClient::appClientReceiveE2E(int servicePort, SYNTRO_EHEAD *header, int len)
+{
+	if (servicePort != m_controlPort) {
+		logWarn(QString("E2E received to invalid port %1").arg(servicePort));
+		free(header);
+		return;
+	}
+
+	quint8 *p = (quint8 *)(header + 1);
+
+	if (len >= (int)(sizeof(quint64) + sizeof(ZIGBEE_GATEWAY_RESPONSE))
+			&& ((p[8] << 8) | p[9]) == ZIGBEE_GATEWAY_TX_NOTICE)
+		processTxNotice(QByteArray((const char *)(p + 8), len - 8));
+
+	free(header);
+}
+
 bool ZigbeeClient::sendData(quint64 address, QByteArray data)
 {
 	if (!clientIsConnected())
@@ -127,13 +149,13 @@ void ZigbeeClient::processRadioList(QByteArray data)
 	zgr.cmd = getU16(data, pos);
 	pos += 2;
 
-	if (zgr.cmd != ZIGBEE_AT_CMD_ND)
+	if (zgr.cmd != ZIGBEE_AT_CMD_ND && zgr.cmd != ZIGBEE_GATEWAY_NODE_UPDATE)
 		return;
 
 	zgr.recCount = getU16(data, pos);
 	pos += 2;
 
-	if (zgr.recCount < 1)
+	if (zgr.recCount < 1 && zgr.cmd == ZIGBEE_AT_CMD_ND)
 		emit receiveRadioList(list);
 
 	if (data.length() < (int)(sizeof(zgr) + (zgr.recCount * sizeof(node))))
@@ -160,5 +182,75 @@ void ZigbeeClient::processRadioList(QByteArray data)
 		list.append(zb);
 	}
 
-	emit receiveRadioList(list);
+	// an update only carries the nodes that joined or changed
+	if (zgr.cmd == ZIGBEE_GATEWAY_NODE_UPDATE) {
+		for (int i = 0; i < list.count(); i++)
+			emit receiveNodeUpdate(list.at(i));
+	}
+	else {
+		emit receiveRadioList(list);
+	}
+}
+
+// data the gateway could not deliver, after any retries
+void ZigbeeClient::processDeliveryReport(QByteArray data)
+{
+	int pos = 2;
+
+	if (data.length() < (int)sizeof(ZIGBEE_GATEWAY_RESPONSE))
+		return;
+
+	int recCount = getU16(data, pos);
+	pos += 2;
+
+	if (data.length() < pos + (recCount * ZIGBEE_DELIVERY_REPORT_SIZE))
+		return;
+
+	for (int i = 0; i < recCount; i++) {
+		quint64 address = getU64(data, pos);
+		int status = 0xff & data.at(pos + 8);
+		int attempts = 0xff & data.at(pos + 9);
+
+		pos += ZIGBEE_DELIVERY_REPORT_SIZE;
+
+		emit receiveDeliveryReport(address, status, attempts);
+	}
+}
+
+void ZigbeeClient::processIOSample(quint64 address, QByteArray data)
+{
+	ZigbeeIOSample sample;
+
+	if (!sample.unpack(address, data)) {
+		logWarn(QString("Bad IO sample record from 0x%1").arg(address, 16, 16, QChar('0')));
+		return;
+	}
+
+	emit receiveIOSample(sample);
+}
+
+// busy means the gateway refused data for address until a clear notice
+// comes, dropped is how many queued frames it had to throw away
+void ZigbeeClient::processTxNotice(QByteArray data)
+{
+	int pos = 2;
+
+	if (data.length() < (int)sizeof(ZIGBEE_GATEWAY_RESPONSE))
+		return;
+
+	int recCount = getU16(data, pos);
+	pos += 2;
+
+	if (data.length() < pos + (recCount * ZIGBEE_TX_NOTICE_SIZE))
+		return;
+
+	for (int i = 0; i < recCount; i++) {
+		quint64 address = getU64(data, pos);
+		bool busy = data.at(pos + 8) == ZIGBEE_TX_NOTICE_BUSY;
+		int dropped = getU16(data, pos + 9);
+
+		pos += ZIGBEE_TX_NOTICE_SIZE;
+
+		emit receiveTxNotice(address, busy, dropped);
+	}
 }
@@ -23,6 +23,7 @@
 #include "SyntroLib.h"
 #include "ZigbeeCommon.h"
 #include "ZigbeeStats.h"
+#include "ZigbeeIOSample.h"
 
 
 class ZigbeeClient : public Endpoint
@@ -36,14 +37,22 @@ public:
 
 signals:
 	void receiveData(quint64 address, QByteArray data);
+	void receiveIOSample(const ZigbeeIOSample &sample);
 	void receiveRadioList(QList<ZigbeeStats>);
+	void receiveNodeUpdate(ZigbeeStats);
+	void receiveDeliveryReport(quint64 address, int status, int attempts);
+	void receiveTxNotice(quint64 address, bool busy, int dropped);
 
 protected:
 	void appClientInit();
 	void appClientReceiveMulticast(int servicePort, SYNTRO_EHEAD *multicast, int len);
+	void appClientReceiveE2E(int servicePort, SYNTRO_EHEAD *header, int len);
 
 private:
 	void processRadioList(QByteArray data);
+	void processDeliveryReport(QByteArray data);
+	void processTxNotice(QByteArray data);
+	void processIOSample(quint64 address, QByteArray data);
 
 	int m_receivePort;
 	int m_controlPort;
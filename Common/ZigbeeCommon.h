@@ -25,6 +25,9 @@
 #define ZIGBEE_NODEID       "nodeID"
 #define ZIGBEE_READONLY     "readOnly"
 #define ZIGBEE_POLLINTERVAL "pollInterval"
+#define ZIGBEE_TXPRIORITY   "txPriority"
+#define ZIGBEE_FRAGMENT     "fragment"
+#define ZIGBEE_BUNDLE       "bundle"
 
 #define ZIGBEE_MULTICAST_SERVICE  "multicastService"
 #define ZIGBEE_E2E_SERVICE        "e2eService"
@@ -32,9 +35,53 @@
 
 #define ZIGBEE_PORT                   "zigbeePort"
 #define ZIGBEE_SPEED                  "zigbeeSpeed"
+
+// true for RTS/CTS hardware flow control with the radio
+#define ZIGBEE_FLOW_CONTROL           "zigbeeFlowControl"
 #define NODE_DISCOVER_INTERVAL        "nodeDiscoverInterval"
 #define MULTICAST_Q_EXPIRE_INTERVAL   "multicastQExpireInterval"
 
+// serial I/O from a controller owned thread instead of the caller's event loop
+#define ZIGBEE_IO_THREAD              "zigbeeIOThread"
+#define ZIGBEE_IO_PRIORITY            "zigbeeIOPriority"
+#define ZIGBEE_IO_CPU                 "zigbeeIOCpu"
+
+// 1 for AP=1, 2 for AP=2 (escaped)
+#define ZIGBEE_API_MODE               "zigbeeApiMode"
+
+// file to record the raw serial traffic to, see ZigbeeCapture
+#define ZIGBEE_CAPTURE_FILE           "zigbeeCaptureFile"
+
+// file the 64 to 16-bit address map is kept in across restarts, see
+// ZigbeeAddressCache
+#define ZIGBEE_ADDRESS_CACHE          "zigbeeAddressCache"
+
+// transmit requests a destination may have waiting on a transmit status
+#define ZIGBEE_TX_WINDOW              "zigbeeTxWindow"
+
+// queued data frames at which a destination is congested and clear again
+#define ZIGBEE_TX_HIGH_WATER          "zigbeeTxHighWater"
+#define ZIGBEE_TX_LOW_WATER           "zigbeeTxLowWater"
+
+// times to resend a transmit request that failed, 0 for never, and the
+// msecs to wait before the first resend, doubling after that
+#define ZIGBEE_TX_RETRIES             "zigbeeTxRetries"
+#define ZIGBEE_TX_RETRY_BACKOFF       "zigbeeTxRetryBackoff"
+
+// msecs small messages for a bundle=true device are held to go together
+#define ZIGBEE_BUNDLE_WINDOW          "zigbeeBundleWindow"
+
+// transmit requests per second the AIMD pacing stays between, a max of
+// 0 turns pacing off
+#define ZIGBEE_TX_RATE_MAX            "zigbeeTxRateMax"
+#define ZIGBEE_TX_RATE_MIN            "zigbeeTxRateMin"
+
+// send data over the routes in route record indicators, and the AR value
+// to set on the local radio to make it a many-to-one concentrator, in
+// tens of seconds between broadcasts, 0xFF for off, unset leaves it alone
+#define ZIGBEE_SOURCE_ROUTING         "zigbeeSourceRouting"
+#define ZIGBEE_MANY_TO_ONE            "zigbeeManyToOne"
+
 
 // Device type from ND response
 // LOCAL is appended for the local radio
@@ -45,11 +92,20 @@
 
 #define ZIGBEE_START_DELIM		          0x7E
 
+// API mode 2 escaping
+#define ZIGBEE_ESCAPE_CHAR                0x7D
+#define ZIGBEE_XON                        0x11
+#define ZIGBEE_XOFF                       0x13
+#define ZIGBEE_ESCAPE_XOR                 0x20
+
 // Frame types
 #define ZIGBEE_FT_AT_COMMAND              0x08
+#define ZIGBEE_FT_AT_COMMAND_QUEUED       0x09
 #define ZIGBEE_FT_TRANSMIT_REQUEST	      0x10
+#define ZIGBEE_FT_CREATE_SOURCE_ROUTE     0x21
 #define ZIGBEE_FT_REMOTE_AT_COMMAND       0x17
 #define ZIGBEE_FT_AT_COMMAND_RESPONSE     0x88
+#define ZIGBEE_FT_MODEM_STATUS            0x8A
 #define ZIGBEE_FT_TRANSMIT_STATUS	      0x8B
 #define ZIGBEE_FT_RECEIVE_PACKET	      0x90
 #define ZIGBEE_FT_EXPLICIT_RX_IND         0x91
@@ -57,19 +113,62 @@
 #define ZIGBEE_FT_SENSOR_READ_IND         0x94
 #define ZIGBEE_FT_NODE_ID_IND             0x95
 #define ZIGBEE_FT_REMOTE_COMMAND_RESPONSE 0x97
+#define ZIGBEE_FT_ROUTE_RECORD_IND        0xA1
 
 #define ZIGBEE_BROADCAST_ADDRESS          0xFFFE
 
+// Transmit priority classes, highest first. AT commands are control, data
+// is interactive unless a device is configured as bulk.
+#define ZIGBEE_TX_CONTROL                 0
+#define ZIGBEE_TX_INTERACTIVE             1
+#define ZIGBEE_TX_BULK                    2
+#define ZIGBEE_TX_CLASSES                 3
+
+// Transmit status delivery status values
+#define ZIGBEE_DELIVERY_SUCCESS           0x00
+#define ZIGBEE_DELIVERY_MAC_ACK_FAILURE   0x01
+#define ZIGBEE_DELIVERY_CCA_FAILURE       0x02
+#define ZIGBEE_DELIVERY_NETWORK_ACK_FAILURE 0x21
+#define ZIGBEE_DELIVERY_NOT_JOINED        0x22
+#define ZIGBEE_DELIVERY_ADDRESS_NOT_FOUND 0x24
+#define ZIGBEE_DELIVERY_ROUTE_NOT_FOUND   0x25
+#define ZIGBEE_DELIVERY_RESOURCE_ERROR    0x2C
+
+// not from the radio, no transmit status came back at all
+#define ZIGBEE_DELIVERY_TIMEOUT           0xFF
+
+// Modem status values
+#define ZIGBEE_MODEM_HARDWARE_RESET       0x00
+#define ZIGBEE_MODEM_WATCHDOG_RESET       0x01
+#define ZIGBEE_MODEM_JOINED               0x02
+#define ZIGBEE_MODEM_DISASSOCIATED        0x03
+#define ZIGBEE_MODEM_COORDINATOR_STARTED  0x06
+
+#define ZIGBEE_AT_CMD_AC                  0x4143
+#define ZIGBEE_AT_CMD_AR                  0x4152
 #define ZIGBEE_AT_CMD_SH                  0x5348
 #define ZIGBEE_AT_CMD_SL                  0x534C
 #define ZIGBEE_AT_CMD_ID                  0x4944
 #define ZIGBEE_AT_CMD_MV                  0x4D56
 #define ZIGBEE_AT_CMD_ND                  0x4E44
 #define ZIGBEE_AT_CMD_NI                  0x4E49
+#define ZIGBEE_AT_CMD_NP                  0x4E50
 #define ZIGBEE_AT_CMD_OI                  0x4F49
 
 #define ZIGBEE_MAX_NODE_ID                20
 
+// ZIGBEE_GATEWAY_RESPONSE cmd for a single node that joined or changed,
+// the records are the same as for ND
+#define ZIGBEE_GATEWAY_NODE_UPDATE        0x4E55
+
+// ZIGBEE_GATEWAY_RESPONSE cmd for data the gateway gave up on, each
+// record is a ZIGBEE_DELIVERY_REPORT
+#define ZIGBEE_GATEWAY_DELIVERY_REPORT    0x4452
+
+// multicast record subTypes
+#define ZIGBEE_RECORD_DATA                0
+#define ZIGBEE_RECORD_IO_SAMPLE           1
+
 typedef struct
 {
 	quint16 cmd;
@@ -84,5 +183,32 @@ typedef struct
 	char nodeID[ZIGBEE_MAX_NODE_ID + 1];	
 } ZIGBEE_NODE_DATA;
 
+typedef struct
+{
+	quint64 address;
+	quint8 status;
+	quint8 attempts;
+} ZIGBEE_DELIVERY_REPORT;
+
+// packed size on the wire, no padding
+#define ZIGBEE_DELIVERY_REPORT_SIZE       10
+
+// E2E reply to a sender, each record is a ZIGBEE_TX_NOTICE
+#define ZIGBEE_GATEWAY_TX_NOTICE          0x5458
+
+#define ZIGBEE_TX_NOTICE_CLEAR            0
+#define ZIGBEE_TX_NOTICE_BUSY             1
+
+// busy means the gateway is refusing data for address until a clear
+// notice, dropped is how many queued frames for it were thrown away
+typedef struct
+{
+	quint64 address;
+	quint8 busy;
+	quint16 dropped;
+} ZIGBEE_TX_NOTICE;
+
+#define ZIGBEE_TX_NOTICE_SIZE             11
+
 
 #endif // ZIGBEECOMMON_H
@@ -7,10 +7,40 @@ HEADERS += ZigbeeController.h \
     ZigbeeStats.h \
     ZigbeeCommon.h \
     ZigbeeUtils.h \
+    ZigbeeRxRing.h \
+    ZigbeeFrame.h \
+    ZigbeeFrameHandler.h \
+    ZigbeeTxFrame.h \
+    ZigbeeTxScheduler.h \
+    ZigbeeTxPacer.h \
+    ZigbeeFrameLeases.h \
+    ZigbeeFragment.h \
+    ZigbeeBundle.h \
+    ZigbeeAddressCache.h \
+    ZigbeeSourceRoutes.h \
+    ZigbeeFramePool.h \
+    ZigbeeATBatch.h \
+    ZigbeePerfStats.h \
+    ZigbeeCapture.h \
+    ZigbeeEscape.h \
+    ZigbeeIOSample.h \
     SerialPortDlg.h
 
 SOURCES += ZigbeeController.cpp \
     ZigbeeStats.cpp \
     ZigbeeUtils.cpp \
+    ZigbeeRxRing.cpp \
+    ZigbeeEscape.cpp \
+    ZigbeeIOSample.cpp \
+    ZigbeePerfStats.cpp \
+    ZigbeeCapture.cpp \
+    ZigbeeFrameLeases.cpp \
+    ZigbeeFragment.cpp \
+    ZigbeeAddressCache.cpp \
+    ZigbeeSourceRoutes.cpp \
+    ZigbeeFramePool.cpp \
+    ZigbeeATBatch.cpp \
+    ZigbeeTxScheduler.cpp \
+    ZigbeeTxPacer.cpp \
     SerialPortDlg.cpp
 
@@ -22,11 +22,87 @@
 #include "ZigbeeController.h"
 #include "ZigbeeUtils.h"
 
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#endif
+
+
+// longest the run loop sleeps with nothing queued and no timer due
+#define CONTROLLER_MAX_WAIT 1000
+
+// backoff when the port reports an error
+#define CONTROLLER_ERROR_WAIT 50
+
+// the range the radio's BD takes as a rate rather than a 0-7 index
+#define ZIGBEE_MIN_CUSTOM_SPEED 1200
+#define ZIGBEE_MAX_CUSTOM_SPEED 921600
+
+// batch AT commands queued or waiting on a response at once, well
+// short of the control queue depth
+#define AT_BATCH_WINDOW 8
+
+// msecs between looks at CTS while the radio is holding us off, a few
+// bytes' worth of its buffer at the higher rates
+#define CTS_POLL_INTERVAL 2
+
+// Frames ready at the same time go to the port in one write of up to
+// TX_GATHER_MAX bytes, less whatever is still sitting in the tty's
+// output queue out of TX_TTY_BUFFER. The first frame always goes.
+#define TX_GATHER_MAX 1024
+#define TX_TTY_BUFFER 4096
+
+// msecs to wait for room in a full tty output queue before giving up
+// on the rest of a write
+#define TX_WRITE_WAIT 100
+
+// get smarter about this timing, 6 seconds is the default for the radios
+#define NODE_DISCOVER_WAIT 8000
+
+#define RATES_INTERVAL 1000
+
+// how often to look for frame id leases that were never answered
+#define LEASE_CHECK_INTERVAL 500
+
+// A transmit status can take a few seconds with route discovery and
+// retries, longer than that and the radio has forgotten about it. An
+// ND lease lives as long as we wait for the responses.
+#define LEASE_TIMEOUT 10000
+#define ND_LEASE_TIMEOUT (NODE_DISCOVER_WAIT + 2000)
+
+#define DEFAULT_TX_RETRY_BACKOFF 100
+#define MAX_TX_RETRY_BACKOFF 5000
+#define MAX_TX_RETRIES 8
+
+// how often the address cache is written out if it changed
+#define ADDRESS_CACHE_SAVE_INTERVAL 30000
 
-#define CONTROLLER_BACKGROUND_INTERVAL 50
 #define DEFAULT_NODE_DISCOVER_INTERVAL 60
 #define MIN_NODE_DISCOVER_INTERVAL 30
 
+// how long a partial frame may sit at the head of the rx ring with no
+// new bytes coming in before we decide the length was bad
+#define RX_FRAME_TIMEOUT 100
+
+// nsecs interval to usecs for the histograms
+static quint32 elapsedUsecs(qint64 from, qint64 to)
+{
+	qint64 usecs = (to - from) / 1000;
+
+	if (usecs < 0)
+		return 0;
+
+	if (usecs > 0xffffffffLL)
+		return 0xffffffff;
+
+	return (quint32)usecs;
+}
+
 ZigbeeController::ZigbeeController()
 {
 	m_stop = true;
@@ -35,13 +111,89 @@ ZigbeeController::ZigbeeController()
 	m_localTxCount = 0;
 	m_localRxCount = 0;
 	m_panID = 0;
-	m_nodeDiscoverWait = 0;
 	m_nodeDiscoverSequence = 0;
-	m_nextAutoNodeDiscover = 0;
 	m_autoNodeDiscoverInterval = DEFAULT_NODE_DISCOVER_INTERVAL;
 	m_port = NULL;
-	m_lastFrameID = 0;
-	memset(m_pendingFrames, 0, sizeof(m_pendingFrames));
+	m_apiMode = 1;
+	m_ioThread = false;
+	m_ioPriority = 0;
+	m_ioCpu = -1;
+	m_wakePipe[0] = -1;
+	m_wakePipe[1] = -1;
+	m_wakePending = false;
+	m_txLeaseWait = false;
+	m_txPaceWait = false;
+	m_flowControl = false;
+	m_txCtsWait = false;
+	m_ctsStalls = 0;
+	m_ctsStallStart = 0;
+	m_ctsStallTime = 0;
+	m_txMacRetries = 0;
+	m_txWrites = 0;
+	m_txPartialWrites = 0;
+	m_txWriteMaxFrames = 0;
+	m_txWriteMaxBytes = 0;
+	m_txRetryLimit = 0;
+	m_txRetryBackoff = DEFAULT_TX_RETRY_BACKOFF;
+	m_txRetryCount = 0;
+	m_txFailed = 0;
+	m_maxPayload = ZIGBEE_DEFAULT_MAX_PAYLOAD;
+	m_txFragments = 0;
+	m_addressCacheHits = 0;
+	m_sourceRouting = false;
+	m_manyToOne = -1;
+	m_installedRoute = 0;
+	m_sourceRoutesSent = 0;
+	m_nextATBatchID = 0;
+	m_atInFlight = 0;
+	m_atBatchesDone = 0;
+	m_atCommands = 0;
+	m_atTimeouts = 0;
+	m_bundleWindow = ZIGBEE_DEFAULT_BUNDLE_WINDOW;
+	m_txBundles = 0;
+	m_txBundledMessages = 0;
+
+	for (int i = 0; i < CONTROLLER_TIMERS; i++)
+		m_timers[i] = -1;
+	m_txLeaseTimeouts = 0;
+	m_txLeaseStalls = 0;
+	m_txLateResponses = 0;
+	m_rxPendingSince = -1;
+	m_rxEscapePending = false;
+	m_rxChecksumErrors = 0;
+	m_rxResyncs = 0;
+	m_clock.start();
+
+	memset(m_frameHandlers, 0, sizeof(m_frameHandlers));
+	memset(m_unclaimedFrames, 0, sizeof(m_unclaimedFrames));
+
+	for (int i = 0; i < 256; i++)
+		m_builtinHandlers[i] = NULL;
+
+	m_rxReadAt = 0;
+	m_rxFrames = 0;
+	m_rxBytes = 0;
+	m_txFrames = 0;
+	m_txBytes = 0;
+	m_rateStart = m_clock.elapsed();
+	m_rateRxFrames = 0;
+	m_rateRxBytes = 0;
+	m_rateTxFrames = 0;
+	m_rateTxBytes = 0;
+	m_rxFramesPerSec = 0;
+	m_rxBytesPerSec = 0;
+	m_txFramesPerSec = 0;
+	m_txBytesPerSec = 0;
+
+	m_builtinHandlers[ZIGBEE_FT_AT_COMMAND_RESPONSE] = &ZigbeeController::handleATCommandResponse;
+	m_builtinHandlers[ZIGBEE_FT_TRANSMIT_STATUS] = &ZigbeeController::handleTransmitStatus;
+	m_builtinHandlers[ZIGBEE_FT_RECEIVE_PACKET] = &ZigbeeController::handleReceivePacket;
+	m_builtinHandlers[ZIGBEE_FT_EXPLICIT_RX_IND] = &ZigbeeController::handleExplicitRxPacket;
+	m_builtinHandlers[ZIGBEE_FT_IO_DATA_SAMPLE_RX_IND] = &ZigbeeController::handleIOSample;
+	m_builtinHandlers[ZIGBEE_FT_NODE_ID_IND] = &ZigbeeController::handleNodeIDIndicator;
+	m_builtinHandlers[ZIGBEE_FT_MODEM_STATUS] = &ZigbeeController::handleModemStatus;
+	m_builtinHandlers[ZIGBEE_FT_REMOTE_COMMAND_RESPONSE] = &ZigbeeController::handleRemoteATCommandResponse;
+	m_builtinHandlers[ZIGBEE_FT_ROUTE_RECORD_IND] = &ZigbeeController::handleRouteRecord;
 }
 
 ZigbeeController::~ZigbeeController()
@@ -61,7 +213,8 @@ bool ZigbeeController::isOpen()
 
 bool ZigbeeController::openDevice(QSettings *settings)
 {
-	BaudRateType baud;
+	BaudRateType baud = BAUD115200;
+	bool customSpeed = false;
 
 	if (isRunning())
 		return false;
@@ -102,23 +255,74 @@ bool ZigbeeController::openDevice(QSettings *settings)
 		baud = BAUD115200;
 		break;
 
+#if defined(Q_OS_UNIX) && defined(B230400) && defined(B4000000)
+	case 230400:
+		baud = BAUD230400;
+		break;
+
+	case 460800:
+		baud = BAUD460800;
+		break;
+
+	case 921600:
+		baud = BAUD921600;
+		break;
+#endif
+
 	default:
+#ifdef Q_OS_UNIX
+		// any other rate the radio's BD can take is set as a custom rate
+		if (speed >= ZIGBEE_MIN_CUSTOM_SPEED && speed <= ZIGBEE_MAX_CUSTOM_SPEED) {
+			customSpeed = true;
+			break;
+		}
+#endif
         qDebug("Invalid port baud rate %d", speed);
 		return false;
 	}
 
-	m_port = new QextSerialPort(name, QextSerialPort::EventDriven);
+	// RTS/CTS, the radio needs D6=1 and D7=1 to match
+	m_flowControl = settings->value(ZIGBEE_FLOW_CONTROL, false).toBool();
+
+	// has to match the AP setting of the radio
+	m_apiMode = settings->value(ZIGBEE_API_MODE, 1).toInt();
+
+	if (m_apiMode != 1 && m_apiMode != 2) {
+		qDebug("Invalid API mode %d, using 1", m_apiMode);
+		m_apiMode = 1;
+	}
+
+	// The I/O thread polls the tty itself, so no notifier on the caller's
+	// event loop. Needs poll(), so this is a Unix only option.
+#ifdef Q_OS_UNIX
+	m_ioThread = settings->value(ZIGBEE_IO_THREAD, false).toBool();
+	m_ioPriority = settings->value(ZIGBEE_IO_PRIORITY, 0).toInt();
+	m_ioCpu = settings->value(ZIGBEE_IO_CPU, -1).toInt();
+#else
+	m_ioThread = false;
+#endif
+
+	if (m_ioThread)
+		m_port = new QextSerialPort(name, QextSerialPort::Polling);
+	else
+		m_port = new QextSerialPort(name, QextSerialPort::EventDriven);
 
 	if (!m_port) {
         qDebug("Error creating serial port object");
 		return false;
 	}
 
-	m_port->setBaudRate(baud);
+#ifdef Q_OS_UNIX
+	if (customSpeed)
+		m_port->setCustomBaudRate(speed);
+	else
+#endif
+		m_port->setBaudRate(baud);
+
 	m_port->setDataBits(DATA_8);
 	m_port->setStopBits(STOP_1);
 	m_port->setParity(PAR_NONE);
-	m_port->setFlowControl(FLOW_OFF);
+	m_port->setFlowControl(m_flowControl ? FLOW_HARDWARE : FLOW_OFF);
 
 	if (!m_port->open(QIODevice::ReadWrite)) {
 		delete m_port;
@@ -127,8 +331,92 @@ bool ZigbeeController::openDevice(QSettings *settings)
 		return false;
 	}
 
-	memset(m_pendingFrames, 0, sizeof(m_pendingFrames));
-	m_lastFrameID = 0;
+	if (customSpeed && m_port->lastError() != E_NO_ERROR) {
+		m_port->close();
+		delete m_port;
+		m_port = NULL;
+		qDebug("Serial port %s can't run at %d baud", qPrintable(name), speed);
+		return false;
+	}
+
+	m_txCtsWait = false;
+
+	m_leases.clear();
+	m_txLeaseWait = false;
+	m_txQ.clear();
+	m_txQ.setWindow(settings->value(ZIGBEE_TX_WINDOW, ZIGBEE_DEFAULT_TX_WINDOW).toInt());
+	m_txQ.setWatermarks(settings->value(ZIGBEE_TX_HIGH_WATER, ZIGBEE_DEFAULT_TX_HIGH_WATER).toInt(),
+		settings->value(ZIGBEE_TX_LOW_WATER, ZIGBEE_DEFAULT_TX_LOW_WATER).toInt());
+	m_txRetryQ.clear();
+	m_atBatches.clear();
+	m_atInFlight = 0;
+
+	m_pacer.configure(settings->value(ZIGBEE_TX_RATE_MIN, ZIGBEE_DEFAULT_TX_RATE_MIN).toInt(),
+		settings->value(ZIGBEE_TX_RATE_MAX, ZIGBEE_DEFAULT_TX_RATE_MAX).toInt());
+	m_txPaceWait = false;
+
+	m_txRetryLimit = settings->value(ZIGBEE_TX_RETRIES, 0).toInt();
+	m_txRetryLimit = qBound(0, m_txRetryLimit, MAX_TX_RETRIES);
+	m_txRetryBackoff = settings->value(ZIGBEE_TX_RETRY_BACKOFF, DEFAULT_TX_RETRY_BACKOFF).toInt();
+	m_txRetryBackoff = qBound(1, m_txRetryBackoff, MAX_TX_RETRY_BACKOFF);
+
+	m_sourceRouting = settings->value(ZIGBEE_SOURCE_ROUTING, false).toBool();
+	m_manyToOne = settings->value(ZIGBEE_MANY_TO_ONE, -1).toInt();
+
+	if (m_manyToOne > 0xff) {
+		qDebug("Invalid many-to-one interval %d, leaving AR alone", m_manyToOne);
+		m_manyToOne = -1;
+	}
+
+	m_sourceRoutes.clear();
+	m_installedRoute = 0;
+
+	m_rxRing.clear();
+	m_rxPendingSince = -1;
+	m_rxEscapePending = false;
+
+	m_maxPayload = ZIGBEE_DEFAULT_MAX_PAYLOAD;
+	m_reassembler.clear();
+	m_bundles.clear();
+
+	m_bundleWindow = settings->value(ZIGBEE_BUNDLE_WINDOW, ZIGBEE_DEFAULT_BUNDLE_WINDOW).toInt();
+	m_bundleWindow = qBound(0, m_bundleWindow, ZIGBEE_MAX_BUNDLE_WINDOW);
+
+	// devices whose firmware speaks the fragment header or takes bundles
+	int count = settings->beginReadArray(ZIGBEE_DEVICES);
+
+	for (int i = 0; i < count; i++) {
+		settings->setArrayIndex(i);
+
+		bool ok;
+		quint64 address = settings->value(ZIGBEE_ADDRESS).toString().toULongLong(&ok, 16);
+
+		if (!ok || address == 0)
+			continue;
+
+		if (settings->value(ZIGBEE_FRAGMENT, false).toBool())
+			setFragmentation(address, true);
+
+		if (settings->value(ZIGBEE_BUNDLE, false).toBool())
+			setBundling(address, true);
+	}
+
+	settings->endArray();
+
+	m_statsMutex.lock();
+	m_addressCachePath = settings->value(ZIGBEE_ADDRESS_CACHE).toString();
+
+	if (m_addressCachePath.length() > 0)
+		m_addressCache.load(m_addressCachePath);
+	else
+		m_addressCache.clear();
+
+	m_statsMutex.unlock();
+
+	QString captureFile = settings->value(ZIGBEE_CAPTURE_FILE).toString();
+
+	if (captureFile.length() > 0)
+		m_capture.openWrite(captureFile, m_apiMode);
 
 	if (settings->contains(NODE_DISCOVER_INTERVAL)) {
 		m_autoNodeDiscoverInterval = settings->value(NODE_DISCOVER_INTERVAL).toUInt();
@@ -136,8 +424,6 @@ bool ZigbeeController::openDevice(QSettings *settings)
 		// no faster then every 30 seconds
 		if (m_autoNodeDiscoverInterval > 0 && m_autoNodeDiscoverInterval < MIN_NODE_DISCOVER_INTERVAL)
 			m_autoNodeDiscoverInterval = MIN_NODE_DISCOVER_INTERVAL;
-
-		m_nextAutoNodeDiscover = m_autoNodeDiscoverInterval * (1000 / CONTROLLER_BACKGROUND_INTERVAL);
 	}
 
 	return true;
@@ -147,11 +433,15 @@ void ZigbeeController::closeDevice()
 {
 	stopRunLoop();
 
+	saveAddressCache();
+
 	if (m_port) {
 		m_port->close();
 		delete m_port;
 		m_port = false;
 	}
+
+	m_capture.close();
 }
 
 void ZigbeeController::startRunLoop()
@@ -162,7 +452,25 @@ void ZigbeeController::startRunLoop()
 	if (!m_port)
 		return;
 
-	connect(m_port, SIGNAL(readyRead()), this, SLOT(readyRead()));
+	if (!m_ioThread)
+		connect(m_port, SIGNAL(readyRead()), this, SLOT(readyRead()));
+
+#ifdef Q_OS_UNIX
+	// the I/O thread sleeps in poll(), so writers wake it through a pipe
+	if (m_ioThread) {
+		if (pipe(m_wakePipe) == 0) {
+			fcntl(m_wakePipe[0], F_SETFL, O_NONBLOCK);
+			fcntl(m_wakePipe[1], F_SETFL, O_NONBLOCK);
+		}
+		else {
+			qDebug("Failed to create the I/O thread wakeup pipe");
+			m_wakePipe[0] = -1;
+			m_wakePipe[1] = -1;
+		}
+
+		m_wakePending = false;
+	}
+#endif
 
 	m_stop = false;
 	
@@ -170,6 +478,12 @@ void ZigbeeController::startRunLoop()
 
 	requestNodeDiscover();
 
+	setTimer(CONTROLLER_TIMER_RATES, RATES_INTERVAL);
+	setTimer(CONTROLLER_TIMER_LEASES, LEASE_CHECK_INTERVAL);
+
+	if (m_addressCachePath.length() > 0)
+		setTimer(CONTROLLER_TIMER_ADDRESS_CACHE, ADDRESS_CACHE_SAVE_INTERVAL);
+
 	start();
 }
 
@@ -178,9 +492,13 @@ void ZigbeeController::stopRunLoop()
 	if (!isRunning())
 		return;
 
-	disconnect(m_port, SIGNAL(readyRead()), this, SLOT(readyRead()));
+	if (!m_ioThread)
+		disconnect(m_port, SIGNAL(readyRead()), this, SLOT(readyRead()));
 
+	m_txMutex.lock();
 	m_stop = true;
+	wakeWriter();
+	m_txMutex.unlock();
 
 	for (int i = 0; i < 4; i++) {
 		if (wait(500))
@@ -188,19 +506,35 @@ void ZigbeeController::stopRunLoop()
 
 		qDebug("Waiting for ZigbeeController thread to finish...");
 	}
+
+#ifdef Q_OS_UNIX
+	if (m_wakePipe[0] >= 0) {
+		close(m_wakePipe[0]);
+		close(m_wakePipe[1]);
+		m_wakePipe[0] = -1;
+		m_wakePipe[1] = -1;
+	}
+#endif
 }
 
 void ZigbeeController::requestNodeDiscover()
 {
-	// only one pending at a time
-	if (m_nodeDiscoverWait > 0)
-		return;
+	m_txMutex.lock();
 
-	postATCommand(ZIGBEE_AT_CMD_ND);
+	// only one pending at a time, this can come from a slot or the timer
+	if (m_timers[CONTROLLER_TIMER_ND_RESPONSE] >= 0) {
+		m_txMutex.unlock();
+		return;
+	}
 
-	// get smarter about this timing, 6 seconds is the default for the radios
-	m_nodeDiscoverWait = 8 * (1000 / CONTROLLER_BACKGROUND_INTERVAL);
+	// the auto discover timer restarts when this one finishes
+	m_timers[CONTROLLER_TIMER_AUTO_ND] = -1;
+	m_timers[CONTROLLER_TIMER_ND_RESPONSE] = m_clock.elapsed() + NODE_DISCOVER_WAIT;
 	m_nodeDiscoverSequence++;
+
+	m_txMutex.unlock();
+
+	postATCommand(ZIGBEE_AT_CMD_ND);
 }
 
 void ZigbeeController::requestNodeIDChange(quint64 address, QString nodeID)
@@ -214,306 +548,1768 @@ void ZigbeeController::requestNodeIDChange(quint64 address, QString nodeID)
 
 		postATCommand(ZIGBEE_AT_CMD_NI, nodeID.toAscii());
 		m_newLocalNodeID = nodeID;
+		return;
 	}
-	else if (m_zbStats.contains(address)) {
+
+	QMutexLocker lock(&m_statsMutex);
+
+	if (m_zbStats.contains(address)) {
 		if (m_zbStats[address]->m_nodeID == nodeID)
 			return;
 
-		postRemoteATCommand(address, ZIGBEE_AT_CMD_NI, nodeID.toAscii());
-		m_zbStats[address]->m_newNodeID = nodeID;
-	}
+		postRemoteATCommand(address, ZIGBEE_AT_CMD_NI, nodeID.toAscii());
+		m_zbStats[address]->m_newNodeID = nodeID;
+	}
+}
+
+void ZigbeeController::sendData(quint64 address, QByteArray data)
+{
+	sendData(address, data, ZIGBEE_TX_INTERACTIVE);
+}
+
+// priority is ZIGBEE_TX_INTERACTIVE or ZIGBEE_TX_BULK
+void ZigbeeController::sendData(quint64 address, QByteArray data, int priority)
+{
+	ZigbeeStats *stats;
+	ZigbeeTxTemplate txTemplate;
+	QList<QByteArray> payloads;
+	QList<QByteArray> frames;
+	quint8 messageID;
+
+	if (priority != ZIGBEE_TX_BULK)
+		priority = ZIGBEE_TX_INTERACTIVE;
+
+	m_statsMutex.lock();
+	if (m_zbStats.contains(address)) {
+		stats = m_zbStats.value(address);
+	}
+	else {
+		stats = new ZigbeeStats(address, 0);
+		m_zbStats.insert(address, stats);
+	}
+
+	// skip the address discovery if we knew it last time
+	if (stats->m_netAddress == ZIGBEE_BROADCAST_ADDRESS && m_addressCache.lookup(address, &stats->m_netAddress))
+		m_addressCacheHits++;
+
+	ZigbeeTxTemplate &cached = m_txTemplates[address];
+	cached.set(address, stats->m_netAddress);
+	txTemplate = cached;
+
+	m_statsMutex.unlock();
+
+	if (nextFragmentID(address, &messageID)) {
+		payloads = splitFragments(data, m_maxPayload, messageID);
+
+		if (payloads.isEmpty()) {
+			qDebug("%d bytes is too much to fragment for 0x%016llx", data.length(), address);
+			return;
+		}
+	}
+	else if (isBundling(address)) {
+		// stats is only safe under m_statsMutex, the template has a copy
+		bundleData(address, txTemplate.m_netAddress, data, priority);
+		return;
+	}
+	else {
+		// straight from the caller's bytes into a pool buffer
+		frames.append(m_framePool.encodeTransmitRequest(txTemplate, data.constData(), data.length()));
+	}
+
+	for (int i = 0; i < payloads.count(); i++)
+		frames.append(m_framePool.encodeTransmitRequest(txTemplate, payloads.at(i).constData(), payloads.at(i).length()));
+
+	QList<ZigbeeTxWatermark> events;
+	int dropped = 0;
+	qint64 now = m_clock.nsecsElapsed();
+
+	m_txMutex.lock();
+
+	// more than the queue holds would push out its own first fragments
+	if (frames.count() > m_txQ.depth(priority)) {
+		m_txMutex.unlock();
+		qDebug("%d bytes is too much to queue for 0x%016llx", data.length(), address);
+		return;
+	}
+
+	// all the fragments go in together, the window pipelines them
+	for (int i = 0; i < frames.count(); i++)
+		dropped += m_txQ.enqueue(ZigbeeTxFrame(frames.at(i), now, address, priority));
+
+	if (frames.count() > 1)
+		m_txFragments += frames.count();
+
+	wakeWriter();
+
+	if (m_txQ.hasWatermarkEvents())
+		events = m_txQ.takeWatermarkEvents();
+
+	m_txMutex.unlock();
+
+	if (dropped > 0)
+		emit txDropped(address, dropped);
+
+	emitWatermarkEvents(events);
+}
+
+// Data to and from address goes in fragments with the ZigbeeFragment
+// header. The remote end has to be running firmware that knows it.
+void ZigbeeController::setFragmentation(quint64 address, bool enable)
+{
+	QMutexLocker lock(&m_statsMutex);
+
+	if (!enable)
+		m_fragmentIDs.remove(address);
+	else if (!m_fragmentIDs.contains(address))
+		m_fragmentIDs.insert(address, 0);
+}
+
+// false if address doesn't use fragments
+bool ZigbeeController::nextFragmentID(quint64 address, quint8 *messageID)
+{
+	QMutexLocker lock(&m_statsMutex);
+
+	QHash<quint64, quint8>::iterator it = m_fragmentIDs.find(address);
+
+	if (it == m_fragmentIDs.end())
+		return false;
+
+	*messageID = ++it.value();
+
+	return true;
+}
+
+// Small messages to address are held for the bundle window and sent
+// together, see ZigbeeBundle. Fragmentation wins if both are set.
+void ZigbeeController::setBundling(quint64 address, bool enable)
+{
+	QMutexLocker lock(&m_statsMutex);
+
+	if (enable)
+		m_bundleDestinations.insert(address);
+	else
+		m_bundleDestinations.remove(address);
+}
+
+bool ZigbeeController::isBundling(quint64 address)
+{
+	QMutexLocker lock(&m_statsMutex);
+
+	return m_bundleDestinations.contains(address);
+}
+
+// Adds data to the destination's open bundle. A bundle goes out when the
+// window closes, when the next message won't fit or when one comes along
+// at a different priority.
+void ZigbeeController::bundleData(quint64 address, quint16 netAddress, const QByteArray &data, int priority)
+{
+	QList<ZigbeeTxWatermark> events;
+	int dropped = 0;
+
+	if (data.length() > 0xff || 1 + data.length() > m_maxPayload) {
+		qDebug("%d bytes is too much to bundle for 0x%016llx", data.length(), address);
+		return;
+	}
+
+	m_txMutex.lock();
+
+	QHash<quint64, ZigbeeBundle>::iterator it = m_bundles.find(address);
+
+	if (it != m_bundles.end() && (it.value().m_priority != priority || !it.value().append(data, m_maxPayload))) {
+		dropped += flushBundle(address, it.value());
+		m_bundles.erase(it);
+		it = m_bundles.end();
+	}
+
+	if (it == m_bundles.end()) {
+		ZigbeeBundle bundle;
+
+		bundle.m_priority = priority;
+		bundle.m_due = m_clock.elapsed() + m_bundleWindow;
+		bundle.append(data, m_maxPayload);
+
+		it = m_bundles.insert(address, bundle);
+
+		if (m_timers[CONTROLLER_TIMER_BUNDLE] < 0 || bundle.m_due < m_timers[CONTROLLER_TIMER_BUNDLE]) {
+			m_timers[CONTROLLER_TIMER_BUNDLE] = bundle.m_due;
+			wakeWriter();
+		}
+	}
+
+	it.value().m_netAddress = netAddress;
+
+	// no room left for even a one byte message, don't wait for the window
+	if (it.value().m_data.length() + 2 > m_maxPayload) {
+		dropped += flushBundle(address, it.value());
+		m_bundles.erase(it);
+	}
+
+	if (m_txQ.hasWatermarkEvents())
+		events = m_txQ.takeWatermarkEvents();
+
+	m_txMutex.unlock();
+
+	if (dropped > 0)
+		emit txDropped(address, dropped);
+
+	emitWatermarkEvents(events);
+}
+
+// call with m_txMutex held, returns what the queue dropped to take it
+int ZigbeeController::flushBundle(quint64 address, const ZigbeeBundle &bundle)
+{
+	ZigbeeTxTemplate txTemplate;
+
+	txTemplate.set(address, bundle.m_netAddress);
+
+	QByteArray packet = m_framePool.encodeTransmitRequest(txTemplate, bundle.m_data.constData(), bundle.m_data.length());
+
+	m_txBundles++;
+	m_txBundledMessages += bundle.m_count;
+
+	int dropped = m_txQ.enqueue(ZigbeeTxFrame(packet, m_clock.nsecsElapsed(), address, bundle.m_priority));
+	wakeWriter();
+
+	return dropped;
+}
+
+// from the bundle timer, sends the bundles whose window has closed
+void ZigbeeController::runBundles()
+{
+	QList<QPair<quint64, int> > drops;
+	QList<ZigbeeTxWatermark> events;
+
+	m_txMutex.lock();
+
+	qint64 now = m_clock.elapsed();
+	qint64 next = -1;
+
+	QHash<quint64, ZigbeeBundle>::iterator it = m_bundles.begin();
+
+	while (it != m_bundles.end()) {
+		if (it.value().m_due <= now) {
+			int dropped = flushBundle(it.key(), it.value());
+
+			if (dropped > 0)
+				drops.append(QPair<quint64, int>(it.key(), dropped));
+
+			it = m_bundles.erase(it);
+			continue;
+		}
+
+		if (next < 0 || it.value().m_due < next)
+			next = it.value().m_due;
+
+		++it;
+	}
+
+	m_timers[CONTROLLER_TIMER_BUNDLE] = next;
+
+	if (m_txQ.hasWatermarkEvents())
+		events = m_txQ.takeWatermarkEvents();
+
+	m_txMutex.unlock();
+
+	for (int i = 0; i < drops.count(); i++)
+		emit txDropped(drops.at(i).first, drops.at(i).second);
+
+	emitWatermarkEvents(events);
+}
+
+// the largest transmit request payload, from ATNP once the radio answers
+int ZigbeeController::maxPayload()
+{
+	return m_maxPayload;
+}
+
+// outside m_txMutex, listeners may call back in
+void ZigbeeController::emitWatermarkEvents(const QList<ZigbeeTxWatermark> &events)
+{
+	for (int i = 0; i < events.count(); i++)
+		emit txCongestion(events.at(i).first, events.at(i).second);
+}
+
+// data frames waiting to go to one destination
+int ZigbeeController::txQueued(quint64 address)
+{
+	QMutexLocker lock(&m_txMutex);
+
+	return m_txQ.queued(address);
+}
+
+void ZigbeeController::queueTxFrame(const QByteArray &packet, quint64 address)
+{
+	ZigbeeTxFrame txFrame(packet, m_clock.nsecsElapsed(), address);
+
+	m_txMutex.lock();
+	m_txQ.enqueue(txFrame);
+
+	// the pacer only holds up data, this goes ahead of it
+	if (txFrame.frameType() != ZIGBEE_FT_TRANSMIT_REQUEST)
+		m_txPaceWait = false;
+
+	wakeWriter();
+	m_txMutex.unlock();
+}
+
+// Call with m_txMutex held. The run loop only sleeps until the next timer
+// is due, anything queued or a new timer gets it going straight away.
+void ZigbeeController::wakeWriter()
+{
+	if (!m_ioThread) {
+		m_txWait.wakeAll();
+		return;
+	}
+
+#ifdef Q_OS_UNIX
+	// one byte in the pipe is enough to get out of poll()
+	if (!m_wakePending && m_wakePipe[1] >= 0) {
+		char c = 0;
+
+		if (write(m_wakePipe[1], &c, 1) == 1)
+			m_wakePending = true;
+	}
+#endif
+}
+
+void ZigbeeController::run()
+{
+	if (m_ioThread) {
+		runIOThread();
+		return;
+	}
+
+	while (!m_stop) {
+		doWrites();
+		runTimers();
+
+		m_txMutex.lock();
+
+		if ((m_txQ.isEmpty() || m_txLeaseWait || m_txPaceWait || m_txCtsWait) && !m_stop)
+			m_txWait.wait(&m_txMutex, waitTime());
+
+		m_txMutex.unlock();
+	}
+}
+
+// Timers are deadlines on m_clock in msecs, -1 when not set. They are
+// run from the controller thread.
+void ZigbeeController::setTimer(int timer, qint64 msecs)
+{
+	QMutexLocker lock(&m_txMutex);
+
+	m_timers[timer] = m_clock.elapsed() + msecs;
+	wakeWriter();
+}
+
+// msecs until the next timer is due, call with m_txMutex held
+int ZigbeeController::waitTime()
+{
+	qint64 now = m_clock.elapsed();
+	qint64 wait = CONTROLLER_MAX_WAIT;
+
+	for (int i = 0; i < CONTROLLER_TIMERS; i++) {
+		if (m_timers[i] >= 0 && m_timers[i] - now < wait)
+			wait = m_timers[i] - now;
+	}
+
+	return wait < 0 ? 0 : (int)wait;
+}
+
+void ZigbeeController::runTimers()
+{
+	for (int i = 0; i < CONTROLLER_TIMERS; i++) {
+		m_txMutex.lock();
+
+		bool due = m_timers[i] >= 0 && m_timers[i] <= m_clock.elapsed();
+
+		if (due)
+			m_timers[i] = -1;
+
+		m_txMutex.unlock();
+
+		if (!due)
+			continue;
+
+		switch (i) {
+		case CONTROLLER_TIMER_ND_RESPONSE:
+			doNodeDiscoverResponse();
+			break;
+
+		case CONTROLLER_TIMER_AUTO_ND:
+			requestNodeDiscover();
+			break;
+
+		case CONTROLLER_TIMER_RATES:
+			updateRates();
+			setTimer(CONTROLLER_TIMER_RATES, RATES_INTERVAL);
+			break;
+
+		case CONTROLLER_TIMER_LEASES:
+			expireLeases();
+			setTimer(CONTROLLER_TIMER_LEASES, LEASE_CHECK_INTERVAL);
+			break;
+
+		case CONTROLLER_TIMER_RETRY:
+			runRetries();
+			break;
+
+		case CONTROLLER_TIMER_BUNDLE:
+			runBundles();
+			break;
+
+		case CONTROLLER_TIMER_PACE:
+			m_txMutex.lock();
+			m_txPaceWait = false;
+			m_txMutex.unlock();
+			break;
+
+		case CONTROLLER_TIMER_ADDRESS_CACHE:
+			saveAddressCache();
+			setTimer(CONTROLLER_TIMER_ADDRESS_CACHE, ADDRESS_CACHE_SAVE_INTERVAL);
+			break;
+
+		case CONTROLLER_TIMER_CTS:
+			// nothing to do, the next doWrites() looks at CTS again
+			break;
+
+		case CONTROLLER_TIMER_RX_FRAME:
+			expireRxFrame();
+			break;
+		}
+	}
+}
+
+// All serial reads and writes happen here, so rx latency no longer
+// depends on how busy the owner's event loop is. Received frames are
+// parsed and their signals emitted from this thread.
+void ZigbeeController::runIOThread()
+{
+#ifdef Q_OS_UNIX
+	struct pollfd pfd[2];
+	bool portError = false;
+	char drain[16];
+
+	setIOThreadScheduling();
+
+	pfd[0].fd = m_port->handle();
+	pfd[0].events = POLLIN;
+	pfd[1].fd = m_wakePipe[0];
+	pfd[1].events = POLLIN;
+
+	while (!m_stop) {
+		doWrites();
+		runTimers();
+
+		m_txMutex.lock();
+		int timeout = (m_txQ.isEmpty() || m_txLeaseWait || m_txPaceWait || m_txCtsWait) ? waitTime() : 0;
+		m_txMutex.unlock();
+
+		pfd[0].revents = 0;
+		pfd[1].revents = 0;
+
+		int ret = poll(pfd, m_wakePipe[0] >= 0 ? 2 : 1, timeout);
+
+		if (ret < 0)
+			continue;
+
+		if (pfd[1].revents & POLLIN) {
+			m_txMutex.lock();
+
+			while (read(m_wakePipe[0], drain, sizeof(drain)) > 0)
+				;
+
+			m_wakePending = false;
+			m_txMutex.unlock();
+		}
+
+		if (pfd[0].revents & POLLIN)
+			readyRead();
+
+		if (pfd[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			if (!portError) {
+				qDebug("Serial port error, revents 0x%04x", pfd[0].revents);
+				portError = true;
+			}
+
+			// don't spin on a dead port
+			msleep(CONTROLLER_ERROR_WAIT);
+		}
+	}
+#endif
+}
+
+void ZigbeeController::setIOThreadScheduling()
+{
+#ifdef Q_OS_LINUX
+	if (m_ioCpu >= 0) {
+		cpu_set_t cpus;
+
+		CPU_ZERO(&cpus);
+		CPU_SET(m_ioCpu, &cpus);
+
+		if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus))
+			qDebug("Failed to set serial I/O thread affinity to cpu %d", m_ioCpu);
+	}
+#endif
+
+#ifdef Q_OS_UNIX
+	if (m_ioPriority > 0) {
+		struct sched_param param;
+
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = m_ioPriority;
+
+		// needs root or CAP_SYS_NICE, otherwise we just run at normal priority
+		if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))
+			qDebug("Failed to set serial I/O thread real-time priority %d", m_ioPriority);
+	}
+#endif
+}
+
+// Drain the queue, the lock is only held to take each frame off. Every
+// frame gets its frame id here, so ids aren't tied up while frames sit
+// in the queue. With all of them in flight the head frame stays put
+// until a status comes back or a lease expires.
+//
+// Everything that can go now is gathered into m_txGather and written
+// with one call, so back to back frames cost one syscall and leave no
+// gaps on the UART. The budget check uses the unescaped length, with
+// AP=2 or a create source route in front a write can run a little over.
+void ZigbeeController::doWrites()
+{
+	ZigbeeTxFrame txFrame;
+	ZigbeeSourceRoute route;
+	QByteArray routeFrame;
+	QList<ZigbeeTxWatermark> events;
+	bool multiResponse;
+	bool paced;
+	qint64 timeout;
+	int gathered = 0;
+	int frames = 0;
+	int budget;
+
+	if (!checkCTS())
+		return;
+
+	budget = txSpace();
+
+	while (true) {
+		m_txMutex.lock();
+
+		if (m_txQ.isEmpty() || m_txLeaseWait || m_txPaceWait || m_txCtsWait) {
+			m_txMutex.unlock();
+			break;
+		}
+
+		// the lease keeps a copy in case it has to go again
+		txFrame = m_txQ.head();
+
+		if (frames > 0 && gathered + txFrame.m_data.length() > budget) {
+			m_txMutex.unlock();
+			break;
+		}
+
+		// Only data is paced. Control frames always come out of the
+		// scheduler first, so a data frame at the head holds up nothing.
+		paced = txFrame.frameType() == ZIGBEE_FT_TRANSMIT_REQUEST;
+
+		if (paced) {
+			if (!m_pacer.canSend(m_clock.nsecsElapsed())) {
+				m_txPaceWait = true;
+				m_pacer.m_stalls++;
+				m_timers[CONTROLLER_TIMER_PACE] = m_pacer.nextSend() / 1000000 + 1;
+				m_txMutex.unlock();
+				break;
+			}
+
+			// the radio holds one source route, load this one if it isn't there
+			if (m_sourceRouting && m_sourceRoutes.lookup(txFrame.m_address, &route)) {
+				txFrame.setNetAddress(route.m_netAddress);
+
+				if (txFrame.m_address != m_installedRoute)
+					routeFrame = ZigbeeSourceRoutes::buildCreateSourceRoute(txFrame.m_address, route);
+			}
+		}
+
+		txFrame.m_attempts++;
+		timeout = leaseTimeout(txFrame, &multiResponse);
+
+		qint64 now = m_clock.nsecsElapsed();
+		quint8 frameID = m_leases.allocate(txFrame, now, timeout, multiResponse);
+
+		if (frameID == 0) {
+			m_txLeaseWait = true;
+			m_txLeaseStalls++;
+			m_txMutex.unlock();
+			break;
+		}
+
+		// only counts once it is really going out
+		if (paced)
+			m_pacer.sent(now);
+
+		m_txQ.dequeue();
+
+		if (routeFrame.length() > 0) {
+			m_installedRoute = txFrame.m_address;
+			m_sourceRoutesSent++;
+		}
+
+		if (m_txQ.hasWatermarkEvents())
+			events = m_txQ.takeWatermarkEvents();
+
+		m_txMutex.unlock();
+
+		if (routeFrame.length() > 0) {
+			gathered = gatherFrame(ZigbeeTxFrame(routeFrame, txFrame.m_queued, txFrame.m_address), 0, gathered);
+			frames++;
+			routeFrame.clear();
+		}
+
+		gathered = gatherFrame(txFrame, frameID, gathered);
+		frames++;
+
+		if (!events.isEmpty()) {
+			emitWatermarkEvents(events);
+			events.clear();
+		}
+	}
+
+	if (frames > 0)
+		writeGathered(gathered, frames);
+}
+
+// With RTS/CTS the radio drops CTS when its serial buffer fills up.
+// The tty stops sending by itself, but anything we write just sits in
+// its output queue where it can't be reordered or dropped. So while CTS
+// is down the frames stay in the scheduler and we look again every
+// CTS_POLL_INTERVAL. Returns true if writes can go ahead.
+bool ZigbeeController::checkCTS()
+{
+	if (!m_flowControl)
+		return true;
+
+	QMutexLocker lock(&m_txMutex);
+
+	if (m_txQ.isEmpty() && !m_txCtsWait)
+		return true;
+
+	bool cts = (m_port->lineStatus() & LS_CTS) != 0;
+	qint64 now = m_clock.elapsed();
+
+	if (cts) {
+		if (m_txCtsWait) {
+			m_ctsStallTime += now - m_ctsStallStart;
+			m_txCtsWait = false;
+		}
+
+		return true;
+	}
+
+	if (!m_txCtsWait) {
+		m_txCtsWait = true;
+		m_ctsStalls++;
+		m_ctsStallStart = now;
+	}
+
+	m_timers[CONTROLLER_TIMER_CTS] = now + CTS_POLL_INTERVAL;
+
+	return false;
+}
+
+// room in the tty's output queue, as much as we will gather if the
+// platform can't tell us
+int ZigbeeController::txSpace()
+{
+#if defined(Q_OS_UNIX) && defined(TIOCOUTQ)
+	int queued;
+
+	if (ioctl(m_port->handle(), TIOCOUTQ, &queued) == 0)
+		return qBound(0, TX_TTY_BUFFER - queued, TX_GATHER_MAX);
+#endif
+
+	return TX_GATHER_MAX;
+}
+
+qint64 ZigbeeController::leaseTimeout(const ZigbeeTxFrame &txFrame, bool *multiResponse)
+{
+	const QByteArray &data = txFrame.m_data;
+
+	*multiResponse = false;
+
+	if (txFrame.m_batchID != 0) {
+		QMap<quint32, ZigbeeATBatch>::const_iterator it = m_atBatches.find(txFrame.m_batchID);
+
+		if (it != m_atBatches.end())
+			return it.value().m_timeout;
+	}
+
+	if (txFrame.frameType() == ZIGBEE_FT_AT_COMMAND && data.length() > 6) {
+		quint16 cmd = ((0xff & data.at(5)) << 8) + (0xff & data.at(6));
+
+		if (cmd == ZIGBEE_AT_CMD_ND) {
+			*multiResponse = true;
+			return ND_LEASE_TIMEOUT;
+		}
+	}
+
+	return LEASE_TIMEOUT;
+}
+
+// Appends the frame as it goes on the wire to m_txGather at offset,
+// returns the new length. The buffer only ever grows. The frame id goes
+// into the wire copy with the checksum moved to match, the queued bytes
+// are never written to.
+int ZigbeeController::gatherFrame(const ZigbeeTxFrame &txFrame, quint8 frameID, int offset)
+{
+	const QByteArray &data = txFrame.m_data;
+	int len = data.length();
+
+	// delim, length, type and frame id at least
+	if (len < 6 || len > 0xffff)
+		return offset;
+
+	const char *src = data.constData();
+	char head[5];
+
+	memcpy(head, src, 4);
+	head[4] = frameID;
+
+	char chksum = (char)((0xff & src[len - 1]) - (frameID - (0xff & src[4])));
+
+	if (m_debugDump) {
+		QByteArray wire(data);
+
+		wire[4] = head[4];
+		wire[len - 1] = chksum;
+		debugDump("TX Request", wire);
+	}
+
+	m_txDwell[txFrame.frameType()].record(elapsedUsecs(txFrame.m_queued, m_clock.nsecsElapsed()));
+
+	// worst case every byte after the delimiter gets escaped
+	int needed = offset + 2 * len;
+
+	if (m_txGather.size() < needed)
+		m_txGather.resize(qMax(needed, 2 * TX_GATHER_MAX));
+
+	char *p = m_txGather.data() + offset;
+
+	// escaping is byte by byte, so it can be done in pieces
+	if (m_apiMode == 2) {
+		p[0] = head[0];
+		offset += 1 + zigbeeEscape(head + 1, 4, p + 1);
+		offset += zigbeeEscape(src + 5, len - 6, m_txGather.data() + offset);
+		offset += zigbeeEscape(&chksum, 1, m_txGather.data() + offset);
+	}
+	else {
+		memcpy(p, head, 5);
+		memcpy(p + 5, src + 5, len - 6);
+		p[len - 1] = chksum;
+		offset += len;
+	}
+
+	m_txFrames++;
+	m_localTxCount++;
+
+	return offset;
+}
+
+// One write for everything gathered. The port is non-blocking, so a full
+// tty queue can take part of it, then we wait for room and carry on
+// rather than leave half a frame on the wire. Any other error gives up,
+// an unplugged USB adapter fails every write but still polls writable.
+void ZigbeeController::writeGathered(int len, int frames)
+{
+	const char *p = m_txGather.constData();
+	int written = 0;
+
+	while (written < len) {
+		qint64 ret = m_port->write(p + written, len - written);
+
+		if (ret > 0) {
+			written += (int)ret;
+
+			if (written < len)
+				m_txPartialWrites++;
+
+			continue;
+		}
+
+#ifdef Q_OS_UNIX
+		if (ret < 0 && errno != EAGAIN && errno != EINTR) {
+			qDebug("Serial write failed with errno %d, %d of %d bytes written", errno, written, len);
+			break;
+		}
+#endif
+
+		if (!waitWritable()) {
+			qDebug("Serial write failed with %d of %d bytes written", written, len);
+			break;
+		}
+	}
+
+	if (m_capture.isOpen() && written > 0)
+		m_capture.write(ZIGBEE_CAPTURE_TX, p, written);
+
+	m_txBytes += written;
+	m_txWrites++;
+
+	if ((quint32)frames > m_txWriteMaxFrames)
+		m_txWriteMaxFrames = frames;
+
+	if ((quint32)written > m_txWriteMaxBytes)
+		m_txWriteMaxBytes = written;
+}
+
+// false if the port still has no room after TX_WRITE_WAIT, or has an
+// error or hangup pending
+bool ZigbeeController::waitWritable()
+{
+#ifdef Q_OS_UNIX
+	struct pollfd pfd;
+
+	pfd.fd = m_port->handle();
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+
+	if (poll(&pfd, 1, TX_WRITE_WAIT) <= 0)
+		return false;
+
+	if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+		return false;
+
+	return (pfd.revents & POLLOUT) != 0;
+#else
+	return false;
+#endif
+}
+
+void ZigbeeController::debugDump(const char *prompt, const QByteArray &data)
+{
+	debugDump(prompt, data.constData(), data.length());
+}
+
+void ZigbeeController::debugDump(const char *prompt, const ZigbeeFrame &frame)
+{
+	debugDump(prompt, frame.data(), frame.length());
+}
+
+void ZigbeeController::debugDump(const char *prompt, const char *data, int len)
+{
+	char buff[512];
+	char temp[8];
+
+	memset(buff, 0, sizeof(buff));
+	memset(temp, 0, sizeof(temp));
+
+	// three chars per byte, a max length frame won't fit
+	len = qMin(len, (int)(sizeof(buff) - 1) / 3);
+
+	for (int i = 0; i < len; i++) {
+		sprintf(temp, "%02X ", 0xff & data[i]);
+		strcat(buff, temp);
+	}
+
+	if (prompt && *prompt)
+		qDebug("DEBUG - %s: %s", prompt, buff);
+	else
+		qDebug("DEBUG - : %s", buff);
+}
+
+void ZigbeeController::readyRead()
+{
+	QMutexLocker lock(&m_rxMutex);
+	int len;
+
+	// read straight into the ring, parsing as we go if it fills up
+	while (m_port->bytesAvailable() > 0) {
+		char *p = m_rxRing.writePtr(&len);
+
+		if (len == 0) {
+			parseRxFrames();
+
+			p = m_rxRing.writePtr(&len);
+
+			// nothing parseable in a full ring, start over
+			if (len == 0) {
+				m_rxRing.clear();
+				m_rxPendingSince = -1;
+				m_rxResyncs++;
+				continue;
+			}
+		}
+
+		len = (int)qMin((qint64)len, m_port->bytesAvailable());
+
+		if (m_apiMode == 2) {
+			len = qMin(len, RX_RAW_CHUNK);
+
+			qint64 count = m_port->read(m_rxRaw, len);
+
+			if (count <= 0)
+				break;
+
+			m_rxReadAt = m_clock.nsecsElapsed();
+
+			// the partial frame is still coming in
+			if (m_rxPendingSince >= 0)
+				m_rxPendingSince = m_clock.elapsed();
+
+			if (m_capture.isOpen())
+				m_capture.write(ZIGBEE_CAPTURE_RX, m_rxRaw, count);
+
+			unescapeIntoRing(m_rxRaw, count);
+		}
+		else {
+			qint64 count = m_port->read(p, len);
+
+			if (count <= 0)
+				break;
+
+			m_rxReadAt = m_clock.nsecsElapsed();
+
+			if (m_rxPendingSince >= 0)
+				m_rxPendingSince = m_clock.elapsed();
+
+			if (m_capture.isOpen())
+				m_capture.write(ZIGBEE_CAPTURE_RX, p, count);
+
+			m_rxRing.commitWrite(count);
+		}
+	}
+
+	parseRxFrames();
+}
+
+// A raw 0x7E is always a frame start in AP=2, so mark it in the ring
+// for parseRxFrames() to resync on.
+void ZigbeeController::unescapeIntoRing(const char *data, int len)
+{
+	int space, used, written;
+
+	while (len > 0) {
+		char *p = m_rxRing.writePtr(&space);
+
+		if (space == 0) {
+			parseRxFrames();
+
+			p = m_rxRing.writePtr(&space);
+
+			if (space == 0) {
+				m_rxRing.clear();
+				m_rxPendingSince = -1;
+				m_rxResyncs++;
+				continue;
+			}
+		}
+
+		if ((0xff & *data) == ZIGBEE_START_DELIM) {
+			m_rxRing.markFrameStart();
+			*p = *data;
+			m_rxRing.commitWrite(1);
+			m_rxEscapePending = false;
+			used = 1;
+		}
+		else {
+			// output is never longer than the input
+			used = zigbeeUnescape(data, qMin(len, space), p, &written, &m_rxEscapePending);
+			m_rxRing.commitWrite(written);
+		}
+
+		data += used;
+		len -= used;
+	}
+}
+
+// A partial frame that got no new bytes for RX_FRAME_TIMEOUT had a bad
+// length, drop its delimiter and parse whatever is behind it.
+void ZigbeeController::expireRxFrame()
+{
+	QMutexLocker lock(&m_rxMutex);
+
+	if (m_rxPendingSince < 0)
+		return;
+
+	qint64 wait = m_rxPendingSince + RX_FRAME_TIMEOUT - m_clock.elapsed();
+
+	if (wait > 0) {
+		setTimer(CONTROLLER_TIMER_RX_FRAME, wait);
+		return;
+	}
+
+	m_rxRing.skip(1);
+	m_rxPendingSince = -1;
+	m_rxResyncs++;
+	parseRxFrames();
+}
+
+// Handle every complete frame in the ring. A bad length or checksum
+// only costs us the start delimiter, we rescan from the next byte.
+void ZigbeeController::parseRxFrames()
+{
+	while (m_rxRing.count() > 0) {
+		int start;
+
+		if (m_apiMode == 2)
+			start = m_rxRing.nextFrameStart(0);
+		else
+			start = m_rxRing.indexOf(ZIGBEE_START_DELIM);
+
+		if (start < 0) {
+			// all garbage, we missed the start delim
+			m_rxRing.skip(m_rxRing.count());
+			m_rxPendingSince = -1;
+			break;
+		}
+
+		if (start > 0) {
+			m_rxRing.skip(start);
+			m_rxPendingSince = -1;
+		}
+
+		// not even enough to check the frame length field
+		if (m_rxRing.count() < 3)
+			break;
+
+		int frameLen = (m_rxRing.at(1) << 8) + m_rxRing.at(2);
+
+		if (frameLen == 0 || frameLen > MAX_RX_FRAME_LEN) {
+			m_rxRing.skip(1);
+			m_rxPendingSince = -1;
+			m_rxResyncs++;
+			continue;
+		}
+
+		// a raw delimiter inside the frame means it was cut short
+		if (m_apiMode == 2) {
+			int next = m_rxRing.nextFrameStart(1);
+
+			if (next > 0 && next < frameLen + 4) {
+				m_rxRing.skip(next);
+				m_rxPendingSince = -1;
+				m_rxResyncs++;
+				continue;
+			}
+		}
+
+		// not enough yet, expireRxFrame() gives up on a corrupt length
+		// once the bytes stop coming
+		if (m_rxRing.count() < frameLen + 4) {
+			if (m_rxPendingSince < 0) {
+				m_rxPendingSince = m_clock.elapsed();
+				setTimer(CONTROLLER_TIMER_RX_FRAME, RX_FRAME_TIMEOUT);
+			}
+
+			break;
+		}
+
+		m_rxPendingSince = -1;
+		m_localRxCount++;
+
+		const char *frame = m_rxRing.linear(frameLen + 4, m_rxScratch);
+
+		if (checksum(frame, frameLen) != (0xff & frame[3 + frameLen])) {
+			qDebug("Bad checksum");
+			m_rxChecksumErrors++;
+			m_rxRing.skip(1);
+			continue;
+		}
+
+		// the handlers are done with the frame before we move on
+		dispatchFrame(ZigbeeFrame(frame, frameLen + 4));
+
+		m_rxLatency[0xff & frame[3]].record(elapsedUsecs(m_rxReadAt, m_clock.nsecsElapsed()));
+		m_rxFrames++;
+		m_rxBytes += frameLen + 4;
+
+		m_rxRing.skip(frameLen + 4);
+	}
+}
+
+// One table lookup per frame. An application handler for a type takes
+// precedence over the controller's own.
+void ZigbeeController::dispatchFrame(const ZigbeeFrame &frame)
+{
+	quint8 frameType = frame.frameType();
+
+	if (m_frameHandlers[frameType]) {
+		m_frameHandlers[frameType]->handleFrame(frame);
+
+		// the builtin handlers complete their own leases
+		switch (frameType) {
+		case ZIGBEE_FT_AT_COMMAND_RESPONSE:
+		case ZIGBEE_FT_REMOTE_COMMAND_RESPONSE:
+			completeATResponse(frame);
+			break;
+
+		case ZIGBEE_FT_TRANSMIT_STATUS:
+			if (frame.length() > 5) {
+				ZigbeeFrameLease lease;
+
+				if (completeLease(frame.at(4), &lease))
+					releaseTxWindow(lease.m_address, false);
+			}
+
+			break;
+		}
+	}
+	else if (m_builtinHandlers[frameType]) {
+		(this->*m_builtinHandlers[frameType])(frame);
+	}
+	else {
+		m_unclaimedFrames[frameType]++;
+
+		if (m_debugDump)
+			debugDump("Unclaimed", frame);
+	}
+}
+
+// Call before startRunLoop(), the table is read without a lock. A NULL
+// handler puts back the controller's own handling for that type.
+// Returns the application handler that was replaced, if any.
+ZigbeeFrameHandler* ZigbeeController::registerFrameHandler(quint8 frameType, ZigbeeFrameHandler *handler)
+{
+	ZigbeeFrameHandler *old = m_frameHandlers[frameType];
+
+	m_frameHandlers[frameType] = handler;
+
+	return old;
+}
+
+// frames nobody handled, for one frame type or all of them
+quint32 ZigbeeController::unclaimedFrames(int frameType)
+{
+	quint32 count = 0;
+
+	if (frameType >= 0 && frameType < 256)
+		return m_unclaimedFrames[frameType];
+
+	for (int i = 0; i < 256; i++)
+		count += m_unclaimedFrames[i];
+
+	return count;
+}
+
+// A status or response arrived, free the frame id and record the time
+// from the request going out to now. False if the id wasn't leased, the
+// lease already timed out and the id may have been handed out again.
+bool ZigbeeController::completeLease(quint8 frameID, ZigbeeFrameLease *lease)
+{
+	ZigbeeFrameLease completed;
+	qint64 roundTrip;
+
+	if (!m_leases.complete(frameID, m_clock.nsecsElapsed(), &completed, &roundTrip)) {
+		m_txLateResponses++;
+		return false;
+	}
+
+	if (roundTrip >= 0)
+		m_txResponse[completed.m_frameType].record(elapsedUsecs(0, roundTrip));
+
+	if (lease)
+		*lease = completed;
+
+	// the writer may be waiting on a frame id
+	m_txMutex.lock();
+
+	if (m_txLeaseWait) {
+		m_txLeaseWait = false;
+		wakeWriter();
+	}
+
+	m_txMutex.unlock();
+
+	return true;
+}
+
+// A transmit request is finished with, the destination can send another.
+// Failures are counted here since the status and the lease timer come in
+// on different threads.
+void ZigbeeController::releaseTxWindow(quint64 address, bool failed)
+{
+	m_txMutex.lock();
+
+	if (failed)
+		m_txFailed++;
+
+	m_txQ.complete(address);
+	wakeWriter();
+	m_txMutex.unlock();
+}
+
+// Transmit status feedback for the AIMD pacing and the destination's
+// window, before its window slot is given back.
+void ZigbeeController::updatePacing(quint64 address, bool congested)
+{
+	QMutexLocker lock(&m_txMutex);
+
+	m_txQ.adjustWindow(address, congested);
+
+	if (congested)
+		m_pacer.congestion(m_clock.nsecsElapsed());
+	else
+		m_pacer.success();
+}
+
+// from the lease timer
+void ZigbeeController::expireLeases()
+{
+	QList<ZigbeeFrameLease> expired;
+
+	m_txLeaseTimeouts += m_leases.expire(m_clock.nsecsElapsed(), &expired);
+
+	// a transmit request that never got a status gives its window slot
+	// back, the radio has forgotten about it so it isn't retried
+	for (int i = 0; i < expired.count(); i++) {
+		const ZigbeeFrameLease &lease = expired.at(i);
+
+		if (lease.m_txFrame.m_batchID != 0) {
+			finishATCommand(lease.m_txFrame.m_batchID, lease.m_txFrame.m_batchIndex,
+				ZIGBEE_AT_STATUS_TIMEOUT, QByteArray());
+			continue;
+		}
+
+		if (lease.m_frameType != ZIGBEE_FT_TRANSMIT_REQUEST)
+			continue;
+
+		updatePacing(lease.m_address, true);
+		releaseTxWindow(lease.m_address, true);
+		emit deliveryReport(lease.m_address, ZIGBEE_DELIVERY_TIMEOUT, lease.m_txFrame.m_attempts);
+	}
+
+	m_txMutex.lock();
+
+	if (m_txLeaseWait && m_leases.live() < ZIGBEE_FRAME_IDS - 1)
+		m_txLeaseWait = false;
+
+	m_txMutex.unlock();
+}
+
+// called from the rates timer, rolls the per second counts over
+void ZigbeeController::updateRates()
+{
+	qint64 now = m_clock.elapsed();
+	qint64 interval = now - m_rateStart;
+
+	if (interval < 1000)
+		return;
+
+	quint64 rxFrames = m_rxFrames;
+	quint64 rxBytes = m_rxBytes;
+	quint64 txFrames = m_txFrames;
+	quint64 txBytes = m_txBytes;
+
+	m_rxFramesPerSec = (quint32)(((rxFrames - m_rateRxFrames) * 1000) / interval);
+	m_rxBytesPerSec = (quint32)(((rxBytes - m_rateRxBytes) * 1000) / interval);
+	m_txFramesPerSec = (quint32)(((txFrames - m_rateTxFrames) * 1000) / interval);
+	m_txBytesPerSec = (quint32)(((txBytes - m_rateTxBytes) * 1000) / interval);
+
+	m_rateRxFrames = rxFrames;
+	m_rateRxBytes = rxBytes;
+	m_rateTxFrames = txFrames;
+	m_rateTxBytes = txBytes;
+	m_rateStart = now;
+}
+
+// A copy of the counters, nothing is locked so the numbers can be a
+// sample or two apart from each other.
+ZigbeePerfStats ZigbeeController::perfStats()
+{
+	ZigbeePerfStats perf;
+
+	for (int i = 0; i < 256; i++) {
+		if (m_rxLatency[i].m_count > 0)
+			perf.m_rxLatency.insert(i, m_rxLatency[i]);
+
+		if (m_txDwell[i].m_count > 0)
+			perf.m_txDwell.insert(i, m_txDwell[i]);
+
+		if (m_txResponse[i].m_count > 0)
+			perf.m_txResponse.insert(i, m_txResponse[i]);
+	}
+
+	perf.m_rxFrames = m_rxFrames;
+	perf.m_rxBytes = m_rxBytes;
+	perf.m_txFrames = m_txFrames;
+	perf.m_txBytes = m_txBytes;
+	perf.m_txWrites = m_txWrites;
+	perf.m_txPartialWrites = m_txPartialWrites;
+	perf.m_txWriteMaxFrames = m_txWriteMaxFrames;
+	perf.m_txWriteMaxBytes = m_txWriteMaxBytes;
+	perf.m_rxChecksumErrors = m_rxChecksumErrors;
+	perf.m_rxResyncs = m_rxResyncs;
+	perf.m_txLeasesLive = m_leases.live();
+	perf.m_txLeaseTimeouts = m_txLeaseTimeouts;
+	perf.m_txLeaseStalls = m_txLeaseStalls;
+	perf.m_txLateResponses = m_txLateResponses;
+
+	m_txMutex.lock();
+	perf.m_txQueued = m_txQ.queued();
+	perf.m_txBlocked = m_txQ.blocked();
+	perf.m_txCongested = m_txQ.congested();
+	perf.m_txDropped = 0;
+
+	for (int i = 0; i < ZIGBEE_TX_CLASSES; i++) {
+		perf.m_txClassQueued[i] = m_txQ.queued(i);
+		perf.m_txClassDropped[i] = m_txQ.dropped(i);
+		perf.m_txDropped += m_txQ.dropped(i);
+	}
+	perf.m_txRetries = m_txRetryCount;
+	perf.m_txFailed = m_txFailed;
+	perf.m_txFragments = m_txFragments;
+	perf.m_txRate = m_pacer.enabled() ? m_pacer.rate() : 0;
+	perf.m_txRateIncreases = m_pacer.m_increases;
+	perf.m_txRateDecreases = m_pacer.m_decreases;
+	perf.m_txPaceStalls = m_pacer.m_stalls;
+	perf.m_flowControl = m_flowControl;
+	perf.m_ctsStalls = m_ctsStalls;
+	perf.m_ctsStallTime = m_ctsStallTime + (m_txCtsWait ? m_clock.elapsed() - m_ctsStallStart : 0);
+	perf.m_txWindowCuts = m_txQ.windowCuts();
+	perf.m_txBundles = m_txBundles;
+	perf.m_txBundledMessages = m_txBundledMessages;
+	perf.m_sourceRoutes = m_sourceRoutes.count();
+	perf.m_routeRecords = m_sourceRoutes.m_records;
+	perf.m_routeChanges = m_sourceRoutes.m_changes;
+	perf.m_sourceRoutesSent = m_sourceRoutesSent;
+	perf.m_sourceRoutesExpired = m_sourceRoutes.m_expired;
+	perf.m_atBatchesPending = m_atBatches.count();
+	perf.m_atBatchesDone = m_atBatchesDone;
+	perf.m_atCommands = m_atCommands;
+	perf.m_atTimeouts = m_atTimeouts;
+	m_txMutex.unlock();
+	perf.m_txMacRetries = m_txMacRetries;
+	perf.m_maxPayload = m_maxPayload;
+	perf.m_framePoolHits = m_framePool.m_hits;
+	perf.m_framePoolMisses = m_framePool.m_misses;
+
+	m_statsMutex.lock();
+	perf.m_addressCacheEntries = m_addressCache.count();
+	perf.m_addressCacheHits = m_addressCacheHits;
+	m_statsMutex.unlock();
+
+	perf.m_rxReassembled = m_reassembler.m_completed;
+	perf.m_rxReassemblyTimeouts = m_reassembler.m_timeouts;
+	perf.m_rxReassemblyOverflows = m_reassembler.m_overflows;
+	perf.m_rxBadFragments = m_reassembler.m_malformed;
+	perf.m_rxFramesPerSec = m_rxFramesPerSec;
+	perf.m_rxBytesPerSec = m_rxBytesPerSec;
+	perf.m_txFramesPerSec = m_txFramesPerSec;
+	perf.m_txBytesPerSec = m_txBytesPerSec;
+
+	return perf;
+}
+
+// We want the 16-bit address for future use. A failed delivery may be
+// sent again, otherwise the outcome goes out in a deliveryReport().
+void ZigbeeController::handleTransmitStatus(const ZigbeeFrame &frame)
+{
+	ZigbeeFrameLease lease;
+
+	if (m_debugDump)
+		debugDump("TX Status", frame);
+
+	if (frame.length() < 11) {
+		debugDump("Transmit status too short", frame);
+		return;
+	}
+
+	quint8 frameId = frame.at(4);
+	quint8 retries = frame.at(7);
+	quint8 status = frame.at(8);
+	quint8 discovery = frame.at(9);
+	bool routeFailed = false;
+	bool congested = retries >= ZIGBEE_TX_CONGESTED_RETRIES;
+
+	// late, the lease timed out
+	if (!completeLease(frameId, &lease))
+		return;
+
+	switch (status) {
+	case ZIGBEE_DELIVERY_NETWORK_ACK_FAILURE:
+		congested = true;
+		routeFailed = true;
+		break;
+
+	case ZIGBEE_DELIVERY_ADDRESS_NOT_FOUND:
+	case ZIGBEE_DELIVERY_ROUTE_NOT_FOUND:
+		routeFailed = true;
+		break;
+
+	case ZIGBEE_DELIVERY_MAC_ACK_FAILURE:
+	case ZIGBEE_DELIVERY_CCA_FAILURE:
+	case ZIGBEE_DELIVERY_RESOURCE_ERROR:
+		congested = true;
+		break;
+	}
+
+	m_txMacRetries += retries;
+
+	m_statsMutex.lock();
+
+	if (m_zbStats.contains(lease.m_address)) {
+		ZigbeeStats *stats = m_zbStats.value(lease.m_address);
+
+		quint16 netAddress = frame.getU16(5);
+
+		// the node may have a new 16-bit address, let the radio look it up
+		if (routeFailed) {
+			stats->m_netAddress = ZIGBEE_BROADCAST_ADDRESS;
+			m_addressCache.invalidate(lease.m_address);
+		}
+		// confirms or corrects what we had, from the cache or not
+		else if (status == ZIGBEE_DELIVERY_SUCCESS && netAddress != ZIGBEE_BROADCAST_ADDRESS) {
+			stats->m_netAddress = netAddress;
+			m_addressCache.update(lease.m_address, netAddress);
+		}
+		else if (!stats->m_netAddress || stats->m_netAddress == ZIGBEE_BROADCAST_ADDRESS) {
+			stats->m_netAddress = netAddress;
+		}
+
+		stats->m_lastFrameID = frameId;
+		stats->m_lastDeliveryStatus = status;
+		stats->m_lastDiscoveryStatus = discovery;
+		stats->m_txMacRetries += retries;
+
+		// successful transmissions
+		if (status == ZIGBEE_DELIVERY_SUCCESS)
+			stats->m_txCount++;
+		else
+			stats->m_txFailures++;
+	}
+
+	m_statsMutex.unlock();
+
+	// a missing route says nothing about how busy the air is
+	if (congested || status == ZIGBEE_DELIVERY_SUCCESS)
+		updatePacing(lease.m_address, congested);
+
+	if (status != ZIGBEE_DELIVERY_SUCCESS)
+		expireSourceRoute(lease.m_address);
+
+	if (status != ZIGBEE_DELIVERY_SUCCESS && scheduleRetry(lease, status))
+		return;
+
+	releaseTxWindow(lease.m_address, status != ZIGBEE_DELIVERY_SUCCESS);
+
+	emit deliveryReport(lease.m_address, status, lease.m_txFrame.m_attempts);
 }
 
-void ZigbeeController::sendData(quint64 address, QByteArray data)
+// Queue a failed transmit request to go again after a backoff that
+// doubles with each attempt. The destination keeps its window slot in
+// the meantime so nothing overtakes it. False if it shouldn't be retried.
+bool ZigbeeController::scheduleRetry(const ZigbeeFrameLease &lease, quint8 status)
 {
-	ZigbeeStats *stats;
+	ZigbeeTxFrame txFrame = lease.m_txFrame;
 
-	quint8 nextFrameID = getNextFrameID();
+	if (txFrame.m_attempts > m_txRetryLimit)
+		return false;
 
-	m_statsMutex.lock();
-	if (m_zbStats.contains(address)) {
-		stats = m_zbStats.value(address);
-		stats->m_lastFrameID = nextFrameID;
-	}
-	else {
-		stats = new ZigbeeStats(address, nextFrameID);
-		m_zbStats.insert(address, stats);
-	}
-	m_statsMutex.unlock();
+	switch (status) {
+	case ZIGBEE_DELIVERY_MAC_ACK_FAILURE:
+	case ZIGBEE_DELIVERY_CCA_FAILURE:
+	case ZIGBEE_DELIVERY_RESOURCE_ERROR:
+		break;
 
-	QByteArray packet;
-	int len = 14 + data.length();
+	case ZIGBEE_DELIVERY_NETWORK_ACK_FAILURE:
+	case ZIGBEE_DELIVERY_ADDRESS_NOT_FOUND:
+	case ZIGBEE_DELIVERY_ROUTE_NOT_FOUND:
+		txFrame.setNetAddress(ZIGBEE_BROADCAST_ADDRESS);
+		break;
 
-	packet.append(ZIGBEE_START_DELIM);
-	putU16(&packet, len);
-	packet.append(ZIGBEE_FT_TRANSMIT_REQUEST);
-	packet.append(nextFrameID);
-	putU64(&packet, address);
-	putU16(&packet, stats->m_netAddress);
-	packet.append((char)0x00);
-	packet.append((char)0x00);
-	packet.append(data);
+	default:
+		return false;
+	}
 
-	quint8 chksum = checksum(packet, packet.length() - 3);
-	packet.append(chksum);
+	qint64 backoff = (qint64)m_txRetryBackoff << (txFrame.m_attempts - 1);
 
-	m_pendingFrames[nextFrameID] = address;
-	m_lastFrameID = nextFrameID;
+	txFrame.m_due = m_clock.elapsed() + qMin(backoff, (qint64)MAX_TX_RETRY_BACKOFF);
 
-	m_txMutex.lock();
+	QMutexLocker lock(&m_txMutex);
 
-	if (m_txQ.count() > 50)
-		m_txQ.dequeue();
+	m_txRetryQ.append(txFrame);
+	m_txRetryCount++;
 
-	m_txQ.enqueue(packet);
+	if (m_timers[CONTROLLER_TIMER_RETRY] < 0 || txFrame.m_due < m_timers[CONTROLLER_TIMER_RETRY]) {
+		m_timers[CONTROLLER_TIMER_RETRY] = txFrame.m_due;
+		wakeWriter();
+	}
 
-	m_txMutex.unlock();
+	return true;
 }
 
-void ZigbeeController::run()
+// from the retry timer, puts the frames whose backoff is up back in line
+void ZigbeeController::runRetries()
 {
-	while (!m_stop) {
-		doWrites();
+	QMutexLocker lock(&m_txMutex);
 
-		if (m_nodeDiscoverWait > 0) {
-			m_nodeDiscoverWait--;
+	qint64 now = m_clock.elapsed();
+	qint64 next = -1;
 
-			if (m_nodeDiscoverWait == 0)
-				doNodeDiscoverResponse();
-		}
-		else if (m_autoNodeDiscoverInterval > 0) {
-			m_nextAutoNodeDiscover--;
+	for (int i = 0; i < m_txRetryQ.count(); ) {
+		ZigbeeTxFrame &txFrame = m_txRetryQ[i];
 
-			if (m_nextAutoNodeDiscover <= 0)
-				requestNodeDiscover();
+		if (txFrame.m_due <= now) {
+			txFrame.m_queued = m_clock.nsecsElapsed();
+			m_txQ.requeue(txFrame);
+			m_txRetryQ.removeAt(i);
+			continue;
 		}
 
-		msleep(CONTROLLER_BACKGROUND_INTERVAL);
+		if (next < 0 || txFrame.m_due < next)
+			next = txFrame.m_due;
+
+		i++;
 	}
+
+	m_timers[CONTROLLER_TIMER_RETRY] = next;
 }
 
-void ZigbeeController::doWrites()
+// Query the local radio with one AT batch, the responses still go
+// through handleATCommandResponse() as they come in.
+void ZigbeeController::queryLocalRadio()
 {
-	QByteArray data;
-
-	m_txMutex.lock();
+	ZigbeeATBatch batch;
 
-	if (m_txQ.count() > 0)
-		data = m_txQ.dequeue();
-
-	m_txMutex.unlock();
-
-	if (data.length() == 0 || data.length() > 0xffff)
-		return;
+	m_localAddress = 0;
+	m_panID = 0;
+	m_localNodeID.clear();
 
-	if (m_debugDump)
-		debugDump("TX Request", data);
+	batch.read(0, ZIGBEE_AT_CMD_SH);
+	batch.read(0, ZIGBEE_AT_CMD_SL);
+	batch.read(0, ZIGBEE_AT_CMD_ID);
+	batch.read(0, ZIGBEE_AT_CMD_NI);
+	batch.read(0, ZIGBEE_AT_CMD_NP);
 
-	m_port->write(data);
+	// route records only come in while we are a concentrator
+	if (m_manyToOne >= 0)
+		batch.write(0, ZIGBEE_AT_CMD_AR, QByteArray(1, (char)m_manyToOne));
 
-	m_localTxCount++;
+	submitATBatch(batch);
 }
 
-void ZigbeeController::debugDump(const char *prompt, QByteArray data)
+void ZigbeeController::postATCommand(quint16 atcmd)
 {
-	char buff[512];
-	char temp[8];
-
-	memset(buff, 0, sizeof(buff));
-	memset(temp, 0, sizeof(temp));
-
-	for (int i = 0; i < data.length(); i++) {
-		quint8 c = data.at(i);
-		sprintf(temp, "%02X ", 0xff & c);
-		strcat(buff, temp);
-	}
+	queueTxFrame(ZigbeeATBatch::buildATCommand(ZIGBEE_FT_AT_COMMAND, atcmd, QByteArray()));
+}
 
-	if (prompt && *prompt)
-		qDebug("DEBUG - %s: %s", prompt, buff);
-	else
-		qDebug("DEBUG - : %s", buff);
+void ZigbeeController::postATCommand(quint16 atcmd, QByteArray data)
+{
+	queueTxFrame(ZigbeeATBatch::buildATCommand(ZIGBEE_FT_AT_COMMAND, atcmd, data));
 }
 
-void ZigbeeController::readyRead()
+// Queues the batch and returns the id it comes back with in
+// atBatchComplete(), 0 if it is empty or too big. A remote command goes
+// to the 16-bit address we have for the node, or the radio looks it up.
+// Safe to call from any thread.
+quint32 ZigbeeController::submitATBatch(const ZigbeeATBatch &batch)
 {
-	QMutexLocker lock(&m_rxMutex);
-	int i;
+	ZigbeeATBatch queued = batch;
+	QList<quint64> written;
+
+	for (int i = 0; i < queued.m_commands.count(); i++) {
+		ZigbeeATCommand &atCommand = queued.m_commands[i];
+		bool hold = queued.m_apply && atCommand.m_write;
+
+		if (atCommand.m_address == m_localAddress)
+			atCommand.m_address = 0;
+
+		atCommand.m_applyChanges = false;
+		atCommand.m_status = ZIGBEE_AT_STATUS_PENDING;
+		atCommand.m_value.clear();
+		atCommand.m_sent = false;
+
+		if (atCommand.m_address == 0)
+			atCommand.m_frame = ZigbeeATBatch::buildATCommand(hold ? ZIGBEE_FT_AT_COMMAND_QUEUED : ZIGBEE_FT_AT_COMMAND,
+				atCommand.m_command, atCommand.m_param);
+		else
+			atCommand.m_frame = ZigbeeATBatch::buildRemoteATCommand(atCommand.m_address,
+				remoteNetAddress(atCommand.m_address), hold ? 0x00 : 0x02, atCommand.m_command, atCommand.m_param);
+
+		if (hold && !written.contains(atCommand.m_address))
+			written.append(atCommand.m_address);
+	}
 
-	QByteArray rawData = m_port->readAll();
+	// one AC for each radio that has writes waiting
+	for (int i = 0; i < written.count(); i++) {
+		ZigbeeATCommand apply;
 
-	if (rawData.length() == 0)
-		return;
+		apply.m_address = written.at(i);
+		apply.m_command = ZIGBEE_AT_CMD_AC;
+		apply.m_applyChanges = true;
 
-	m_rxBuffer.append(rawData);
+		if (apply.m_address == 0)
+			apply.m_frame = ZigbeeATBatch::buildATCommand(ZIGBEE_FT_AT_COMMAND, ZIGBEE_AT_CMD_AC, QByteArray());
+		else
+			apply.m_frame = ZigbeeATBatch::buildRemoteATCommand(apply.m_address,
+				remoteNetAddress(apply.m_address), 0x02, ZIGBEE_AT_CMD_AC, QByteArray());
 
-	for (i = 0; i < m_rxBuffer.length(); i++) {
-		if (m_rxBuffer.at(i) == ZIGBEE_START_DELIM)
-			break;
+		queued.m_commands.append(apply);
 	}
 
-	if (i == m_rxBuffer.length()) {
-		// all garbage, we missed the start delim
-		m_rxBuffer.clear();
-		return;
+	if (queued.count() == 0 || queued.count() > ZIGBEE_MAX_AT_BATCH) {
+		qDebug("Invalid AT batch of %d commands", queued.count());
+		return 0;
 	}
 
-	// align for simplicity, not too efficient ;-)
-	if (i > 0)
-		m_rxBuffer.remove(0, i);
+	if (queued.m_timeout <= 0)
+		queued.m_timeout = ZIGBEE_DEFAULT_AT_BATCH_TIMEOUT;
 
-	// not even enough to check the frame length field
-	if (m_rxBuffer.length() < 3)
-		return;
+	queued.m_pending = queued.count();
 
-	quint16 frameLen = getU16(m_rxBuffer, 1);
+	QMutexLocker lock(&m_txMutex);
 
-	// not enough yet
-	if (m_rxBuffer.length() < frameLen + 4)
-		return;
+	if (++m_nextATBatchID == 0)
+		m_nextATBatchID = 1;
 
-	m_localRxCount++;
+	queued.m_id = m_nextATBatchID;
+	m_atBatches.insert(queued.m_id, queued);
+	feedATBatches();
 
-	quint8 cksum = checksum(m_rxBuffer, frameLen);
+	return queued.m_id;
+}
 
-	quint8 packetCksum = 0xff & m_rxBuffer.at(3 + frameLen);
+quint16 ZigbeeController::remoteNetAddress(quint64 address)
+{
+	QMutexLocker lock(&m_statsMutex);
+	quint16 netAddress;
 
-	if (cksum != packetCksum) {
-		qDebug("Bad checksum");
-		m_rxBuffer.remove(0, frameLen + 4);
-		return;
-	}
+	if (m_zbStats.contains(address))
+		return m_zbStats[address]->m_netAddress;
 
-	quint8 frameType = 0xff & m_rxBuffer.at(3);
+	if (m_addressCache.lookup(address, &netAddress))
+		return netAddress;
 
-	switch (frameType) {
-	case ZIGBEE_FT_AT_COMMAND_RESPONSE:
-		handleATCommandResponse(m_rxBuffer, frameLen + 4);
-		break;
+	return ZIGBEE_BROADCAST_ADDRESS;
+}
 
-	case ZIGBEE_FT_TRANSMIT_STATUS:
-		handleTransmitStatus(m_rxBuffer);
-		break;
+// Put batch commands on the txQ, oldest batch first, until AT_BATCH_WINDOW
+// are out. A batch's AC frames wait for every other command in it to be
+// answered. Call with m_txMutex held.
+void ZigbeeController::feedATBatches()
+{
+	QMap<quint32, ZigbeeATBatch>::iterator it;
+	bool queued = false;
 
-	case ZIGBEE_FT_RECEIVE_PACKET:
-		handleReceivePacket(m_rxBuffer, frameLen + 4);
-		break;
+	for (it = m_atBatches.begin(); it != m_atBatches.end() && m_atInFlight < AT_BATCH_WINDOW; ++it) {
+		ZigbeeATBatch &batch = it.value();
+		bool holdChanges = batch.waitingOnChanges();
 
-	case ZIGBEE_FT_EXPLICIT_RX_IND:
-		handleExplicitRxPacket(m_rxBuffer, frameLen + 4);
-		break;
+		for (int i = 0; i < batch.m_commands.count() && m_atInFlight < AT_BATCH_WINDOW; i++) {
+			ZigbeeATCommand &atCommand = batch.m_commands[i];
 
-	case ZIGBEE_FT_REMOTE_COMMAND_RESPONSE:
-		handleRemoteATCommandResponse(m_rxBuffer, frameLen + 4);
-		break;
+			if (atCommand.m_sent || (atCommand.m_applyChanges && holdChanges))
+				continue;
 
-	default:
-		qDebug("Unhandled frameType 0x%02X", frameType);
-		debugDump("RX", m_rxBuffer);
-		break;
+			ZigbeeTxFrame txFrame(atCommand.m_frame, m_clock.nsecsElapsed(), atCommand.m_address);
+
+			txFrame.m_batchID = batch.m_id;
+			txFrame.m_batchIndex = i;
+			m_txQ.enqueue(txFrame);
+
+			atCommand.m_sent = true;
+			m_atInFlight++;
+			queued = true;
+		}
 	}
 
-	m_rxBuffer.remove(0, frameLen + 4);
+	if (queued) {
+		m_txPaceWait = false;
+		wakeWriter();
+	}
 }
 
-// We want the 16-bit address for future use
-void ZigbeeController::handleTransmitStatus(QByteArray packet)
+// Frees the frame id of an AT or remote AT response. If the request was
+// part of a batch its status and data go in there.
+void ZigbeeController::completeATResponse(const ZigbeeFrame &frame)
 {
-	QMutexLocker lock(&m_statsMutex);
+	ZigbeeFrameLease lease;
+	int statusPos = frame.frameType() == ZIGBEE_FT_REMOTE_COMMAND_RESPONSE ? 17 : 7;
 
-	if (m_debugDump)
-		debugDump("TX Status", packet);
-
-	quint8 frameId = 0xff & packet.at(4);
-
-	// should never happen
-	if (m_pendingFrames[frameId] == 0)
+	if (frame.length() < 6 || !completeLease(frame.at(4), &lease))
 		return;
 
-	// should never happen
-	if (!m_zbStats.contains(m_pendingFrames[frameId]))
+	if (lease.m_txFrame.m_batchID == 0)
 		return;
 
-	ZigbeeStats *stats = m_zbStats.value(m_pendingFrames[frameId]);
-
-	if (!stats->m_netAddress || stats->m_netAddress == ZIGBEE_BROADCAST_ADDRESS)
-		stats->m_netAddress = getU16(packet, 5);
-
-	// successful transmissions
-	stats->m_txCount++;
+	// too short to have a status, call it an error
+	if (frame.length() < statusPos + 2) {
+		finishATCommand(lease.m_txFrame.m_batchID, lease.m_txFrame.m_batchIndex, 1, QByteArray());
+		return;
+	}
 
-	// free the pendingFrames slot
-	m_pendingFrames[frameId] = 0;
+	finishATCommand(lease.m_txFrame.m_batchID, lease.m_txFrame.m_batchIndex, frame.at(statusPos),
+		frame.copy(statusPos + 1, frame.length() - statusPos - 2));
 }
 
-// Issue a few AT commands to the local radio by putting
-// the requests on the txQ.
-void ZigbeeController::queryLocalRadio()
+// From a response or the lease timer. The batch goes out in one signal
+// once the last of its commands is finished with.
+void ZigbeeController::finishATCommand(quint32 batchID, int index, int status, const QByteArray &value)
 {
-	m_localAddress = 0;
-	m_panID = 0;
-	m_localNodeID.clear();
+	ZigbeeATBatch finished;
 
-	postATCommand(ZIGBEE_AT_CMD_SH);
-	postATCommand(ZIGBEE_AT_CMD_SL);
-	postATCommand(ZIGBEE_AT_CMD_ID);
-	postATCommand(ZIGBEE_AT_CMD_NI);
-}
+	m_txMutex.lock();
 
-void ZigbeeController::postATCommand(quint16 atcmd)
-{
-	QByteArray packet;
+	QMap<quint32, ZigbeeATBatch>::iterator it = m_atBatches.find(batchID);
 
-	packet.append(ZIGBEE_START_DELIM);
-	putU16(&packet, 4);
-	packet.append(ZIGBEE_FT_AT_COMMAND);
-	packet.append((char)getNextFrameID());
-	putU16(&packet, atcmd);
-	quint8 chksum = checksum(packet, packet.length() - 3);
-	packet.append(chksum);
+	if (it == m_atBatches.end() || index < 0 || index >= it.value().m_commands.count()) {
+		m_txMutex.unlock();
+		return;
+	}
 
-	m_txMutex.lock();
-	m_txQ.enqueue(packet);
-	m_txMutex.unlock();
-}
+	ZigbeeATBatch &batch = it.value();
+	ZigbeeATCommand &atCommand = batch.m_commands[index];
 
-void ZigbeeController::postATCommand(quint16 atcmd, QByteArray data)
-{
-	QByteArray packet;
+	if (atCommand.m_status == ZIGBEE_AT_STATUS_PENDING) {
+		atCommand.m_status = status;
+		atCommand.m_value = value;
+		batch.m_pending--;
+		m_atInFlight--;
+		m_atCommands++;
 
-	int len = 4 + data.length();
+		if (status == ZIGBEE_AT_STATUS_TIMEOUT)
+			m_atTimeouts++;
+	}
 
-	packet.append(ZIGBEE_START_DELIM);
-	putU16(&packet, len);
-	packet.append(ZIGBEE_FT_AT_COMMAND);
-	packet.append((char)getNextFrameID());
-	putU16(&packet, atcmd);
-	packet.append(data);
-	quint8 chksum = checksum(packet, packet.length() - 3);
-	packet.append(chksum);
+	if (batch.m_pending == 0) {
+		finished = batch;
+		m_atBatches.erase(it);
+		m_atBatchesDone++;
+	}
 
-	m_txMutex.lock();
-	m_txQ.enqueue(packet);
+	feedATBatches();
 	m_txMutex.unlock();
+
+	if (finished.m_id != 0)
+		emit atBatchComplete(finished);
 }
 
 #define ADDRESS_LOW  0x00000000FFFFFFFFULL
 #define ADDRESS_HIGH 0xFFFFFFFF00000000ULL
 
-void ZigbeeController::handleATCommandResponse(QByteArray packet, int packetLen)
+void ZigbeeController::handleATCommandResponse(const ZigbeeFrame &frame)
 {
-	quint8 status = 0xff & packet.at(7);
+	completeATResponse(frame);
+
+	if (frame.length() < 9) {
+		debugDump("AT cmd response too short", frame);
+		return;
+	}
+
+	quint8 status = frame.at(7);
 
 	if (status != 0) {
-		debugDump("AT cmd response bad status", packet);
+		debugDump("AT cmd response bad status", frame);
 		return;
 	}
 
-	quint16 cmd = getU16(packet, 5);
+	quint16 cmd = frame.getU16(5);
 
 	switch (cmd) {
 	case ZIGBEE_AT_CMD_SH:
-		if (packetLen == 13) {
-			m_localAddress = (m_localAddress & ADDRESS_LOW) + ((quint64)getU32(packet, 8) << 32);
+		if (frame.length() == 13) {
+			m_localAddress = (m_localAddress & ADDRESS_LOW) + ((quint64)frame.getU32(8) << 32);
 
 			if ((m_localAddress & ADDRESS_LOW) && (m_localAddress & ADDRESS_HIGH))
 				emit localRadioAddress(m_localAddress);
@@ -522,8 +2318,8 @@ void ZigbeeController::handleATCommandResponse(QByteArray packet, int packetLen)
 		break;
 
 	case ZIGBEE_AT_CMD_SL:
-		if (packetLen == 13) {
-			m_localAddress = (m_localAddress & ADDRESS_HIGH) + getU32(packet, 8);
+		if (frame.length() == 13) {
+			m_localAddress = (m_localAddress & ADDRESS_HIGH) + frame.getU32(8);
 
 			if ((m_localAddress & ADDRESS_LOW) && (m_localAddress & ADDRESS_HIGH))
 				emit localRadioAddress(m_localAddress);
@@ -532,28 +2328,39 @@ void ZigbeeController::handleATCommandResponse(QByteArray packet, int packetLen)
 		break;
 
 	case ZIGBEE_AT_CMD_ID:
-		if (packetLen == 17)
-			m_panID = getU64(packet, 8);
+		if (frame.length() == 17) {
+			m_panID = frame.getU64(8);
+
+			m_statsMutex.lock();
+			m_addressCache.setPanID(m_panID);
+			m_statsMutex.unlock();
+		}
 
 		break;
 
 	case ZIGBEE_AT_CMD_ND:
-		handleNDResponsePacket(packet, packetLen);
+		handleNDResponsePacket(frame);
 		break;
 
 	case ZIGBEE_AT_CMD_NI:
-		parseLocalNIResponse(packet, packetLen);
+		parseLocalNIResponse(frame);
+		break;
+
+	case ZIGBEE_AT_CMD_NP:
+		if (frame.length() == 11 && frame.getU16(8) > ZIGBEE_FRAG_HEADER_LEN)
+			m_maxPayload = frame.getU16(8);
+
 		break;
 	}
 }
 
-void ZigbeeController::parseLocalNIResponse(QByteArray packet, int packetLen)
+void ZigbeeController::parseLocalNIResponse(const ZigbeeFrame &frame)
 {
 	if (m_debugDump)
-		debugDump("AT NI", packet);
+		debugDump("AT NI", frame);
 
 	// if this is a write response packet there is no data
-	if (packetLen == 9) {
+	if (frame.length() == 9) {
 		m_localNodeID = m_newLocalNodeID;
 	}
 	// else this was a read
@@ -562,118 +2369,113 @@ void ZigbeeController::parseLocalNIResponse(QByteArray packet, int packetLen)
 
 		memset(nodeID, 0, sizeof(nodeID));
 
-		for (int i = 8, j = 0; i < packetLen - 1 && j < 20; i++, j++)
-			nodeID[j] = packet.at(i);
+		for (int i = 8, j = 0; i < frame.length() - 1 && j < 20; i++, j++)
+			nodeID[j] = frame.at(i);
 
 		if (strlen(nodeID) > 0 && strcmp(nodeID, " "))
 			m_localNodeID = nodeID;
 	}
 }
 
+// call with m_statsMutex held
 void ZigbeeController::postRemoteATCommand(quint64 address, quint16 atcmd, QByteArray data)
 {
-	QByteArray packet;
-
 	quint16 netAddress = m_zbStats[address]->m_netAddress;
 
-	int len = 15 + data.length();
-
-	packet.append(ZIGBEE_START_DELIM);
-	putU16(&packet, len);
-
-	packet.append(ZIGBEE_FT_REMOTE_AT_COMMAND);
-	packet.append((char)getNextFrameID());
-	putU64(&packet, address);
-	putU16(&packet, netAddress);
-	packet.append(0x02); // remote cmd options, apply and ACK
-	putU16(&packet, atcmd);
-
-	if (data.length() > 0)
-		packet.append(data);
-
-	quint8 chksum = checksum(packet, packet.length() - 3);
-	packet.append(chksum);
-
-	m_txMutex.lock();
-	m_txQ.enqueue(packet);
-	m_txMutex.unlock();
+	queueTxFrame(ZigbeeATBatch::buildRemoteATCommand(address, netAddress, 0x02, atcmd, data), address);
 }
 
-void ZigbeeController::handleRemoteATCommandResponse(QByteArray packet, int packetLen)
+void ZigbeeController::handleRemoteATCommandResponse(const ZigbeeFrame &frame)
 {
-	if (packetLen < 19) {
-		debugDump("Remote AT cmd response too short", packet);
+	completeATResponse(frame);
+
+	if (frame.length() < 19) {
+		debugDump("Remote AT cmd response too short", frame);
 		return;
 	}
 
-	quint8 status = 0xff & packet.at(17);
+	quint8 status = frame.at(17);
 
 	if (status != 0) {
-		debugDump("Remote AT cmd response bad status", packet);
+		debugDump("Remote AT cmd response bad status", frame);
 		return;
 	}
 
-	quint64 address = getU64(packet, 5);
-	quint16 netAddress = getU16(packet, 13);
-	quint16 cmd = getU16(packet, 15);
+	quint64 address = frame.getU64(5);
+	quint16 netAddress = frame.getU16(13);
+	quint16 cmd = frame.getU16(15);
+
+	QMutexLocker lock(&m_statsMutex);
 
 	switch (cmd) {
 	case ZIGBEE_AT_CMD_NI:
 		if (m_debugDump)
-			debugDump("Remote AT NI", packet);
+			debugDump("Remote AT NI", frame);
 
 		// this should always be the case
 		if (m_zbStats.contains(address)) {
 			m_zbStats[address]->m_netAddress = netAddress;
 			m_zbStats[address]->m_nodeID = m_zbStats[address]->m_newNodeID;
+			m_addressCache.update(address, netAddress);
 		}
 
 		break;
 
 	default:
-		debugDump("Unhandled remote AT cmd response", packet);
+		debugDump("Unhandled remote AT cmd response", frame);
 		break;
 	}
 }
 
-void ZigbeeController::handleNDResponsePacket(QByteArray packet, int packetLen)
+void ZigbeeController::handleNDResponsePacket(const ZigbeeFrame &frame)
 {
 	if (m_debugDump)
-		debugDump("ND Response", packet);
+		debugDump("ND Response", frame);
 
-	ZigbeeStats *newZB = parseNDResponse(packet, packetLen);
+	ZigbeeStats *newZB = parseNDResponse(frame);
 
 	if (!newZB) {
-		debugDump("Bad AT ND response", packet);
+		debugDump("Bad AT ND response", frame);
 		return;
 	}
 
+	QMutexLocker lock(&m_statsMutex);
+
 	if (m_zbStats.contains(newZB->m_address)) {
 		ZigbeeStats *zb = m_zbStats.value(newZB->m_address);
 
         if (m_debugDump) {
             if (newZB->m_netAddress != zb->m_netAddress) {
-                debugDump("New netAddress", packet);
+                debugDump("New netAddress", frame);
             }
 
             if (newZB->m_nodeID != zb->m_nodeID) {
-                debugDump("New nodeID", packet);
+                debugDump("New nodeID", frame);
             }
         }
 
 		zb->updateFromNodeDiscovery(newZB);
+		m_addressCache.update(zb->m_address, zb->m_netAddress);
 		delete newZB;
 	}
 	else {
+		m_addressCache.update(newZB->m_address, newZB->m_netAddress);
 		m_zbStats.insert(newZB->m_address, newZB);
 	}
 }
 
-ZigbeeStats* ZigbeeController::parseNDResponse(QByteArray packet, int packetLen)
+ZigbeeStats* ZigbeeController::parseNDResponse(const ZigbeeFrame &frame)
+{
+	return parseNodeRecord(frame, 8);
+}
+
+// The node record an ND response and a Node Identification Indicator
+// have in common, starting with MY at start.
+ZigbeeStats* ZigbeeController::parseNodeRecord(const ZigbeeFrame &frame, int start)
 {
 	int pos;
 
-	if (packetLen < 29)
+	if (frame.length() < start + 21)
 		return NULL;
 
 	ZigbeeStats *zb = new ZigbeeStats();
@@ -681,11 +2483,11 @@ ZigbeeStats* ZigbeeController::parseNDResponse(QByteArray packet, int packetLen)
 	if (!zb)
 		return NULL;
 
-	zb->m_netAddress = getU16(packet, 8); // MY
-	zb->m_address = getU64(packet, 10); // SH-SL
+	zb->m_netAddress = frame.getU16(start); // MY
+	zb->m_address = frame.getU64(start + 2); // SH-SL
 	
-	for (pos = 18; pos < packetLen; pos++) {
-		unsigned char c = 0xff & packet.at(pos);
+	for (pos = start + 10; pos < frame.length(); pos++) {
+		unsigned char c = frame.at(pos);
 
 		if (c == 0)
 			break;
@@ -697,108 +2499,169 @@ ZigbeeStats* ZigbeeController::parseNDResponse(QByteArray packet, int packetLen)
 		zb->m_nodeID.clear();
 
 	// need at least 9 more bytes, 8 + chksum
-	if (packetLen - pos < 9) {
+	if (frame.length() - pos < 9) {
 		delete zb;
 		return NULL;
 	}
 	
 	pos++;
 	
-	zb->m_parentNetAddress = getU16(packet, pos);
+	zb->m_parentNetAddress = frame.getU16(pos);
 	pos += 2;
 
-	zb->m_deviceType = 0xff & packet.at(pos);
+	zb->m_deviceType = frame.at(pos);
 	
-	// skip the status field
+	// skip the status field, the source event for a 0x95
 	pos += 2;
 
-	zb->m_profileID = getU16(packet, pos);
+	zb->m_profileID = frame.getU16(pos);
 	pos += 2;
 
-	zb->m_mfgID = getU16(packet, pos);
+	zb->m_mfgID = frame.getU16(pos);
 
 	zb->m_nodeDiscoverSequence = m_nodeDiscoverSequence;
 
 	return zb;
 }
 
-void ZigbeeController::handleReceivePacket(QByteArray packet, int packetLen)
+void ZigbeeController::handleReceivePacket(const ZigbeeFrame &frame)
 {
 	if (m_debugDump)
-		debugDump("RX", packet);
+		debugDump("RX", frame);
 
-	quint64 address = getU64(packet, 4);
+	if (frame.length() < 16) {
+		debugDump("RX packet too short", frame);
+		return;
+	}
 
-	m_statsMutex.lock();
+	quint64 address = frame.getU64(4);
 
-	if (m_zbStats.contains(address)) {
-		ZigbeeStats *stats = m_zbStats.value(address);
-		stats->m_lastReceiveOptions = 0xff & packet.at(14);
-		stats->m_rxCount++;
-	}
-	else {
-		quint16 netAddress = getU16(packet, 12);
-		ZigbeeStats *stats = new ZigbeeStats(address, 0, netAddress, m_nodeDiscoverSequence);
-		stats->m_lastReceiveOptions = 0xff & packet.at(14);
-		stats->m_rxCount = 1;
-		m_zbStats.insert(address, stats);
+	updateRxStats(address, frame.getU16(12), frame.at(14));
+
+	deliverData(address, frame.copy(15, frame.length() - 16));
+}
+
+// Not doing anything with the extra RX Explicit fields for now
+void ZigbeeController::handleExplicitRxPacket(const ZigbeeFrame &frame)
+{
+	if (m_debugDump)
+		debugDump("RX", frame);
+
+	if (frame.length() < 22) {
+		debugDump("RX explicit packet too short", frame);
+		return;
 	}
 
+	quint64 address = frame.getU64(4);
+
+	updateRxStats(address, frame.getU16(12), frame.at(20));
+
+	deliverData(address, frame.copy(21, frame.length() - 22));
+}
+
+// data from a device that sends fragments only goes up once it is whole
+void ZigbeeController::deliverData(quint64 address, const QByteArray &data)
+{
+	QByteArray message;
+
+	m_statsMutex.lock();
+	bool fragmented = m_fragmentIDs.contains(address);
 	m_statsMutex.unlock();
 
-	QByteArray data = packet.mid(15, packetLen - 16);
+	if (!fragmented) {
+		emit receiveData(address, data);
+		return;
+	}
 
-	emit receiveData(address, data);
+	if (m_reassembler.add(address, data, m_clock.elapsed(), &message))
+		emit receiveData(address, message);
 }
 
-// Not doing anything with the extra RX Explicit fields for now
-void ZigbeeController::handleExplicitRxPacket(QByteArray packet, int packetLen)
+// Samples from a radio configured with IR, there is no micro behind it
+void ZigbeeController::handleIOSample(const ZigbeeFrame &frame)
 {
+	ZigbeeIOSample sample;
+
 	if (m_debugDump)
-		debugDump("RX", packet);
+		debugDump("IO Sample", frame);
 
-	quint64 address = getU64(packet, 4);
+	// header, sample count, the two masks and the checksum
+	if (frame.length() < 20) {
+		debugDump("IO sample too short", frame);
+		return;
+	}
 
-	m_statsMutex.lock();
+	sample.m_address = frame.getU64(4);
+	sample.m_netAddress = frame.getU16(12);
+	sample.m_receiveOptions = frame.at(14);
+
+	// byte 15 is the number of sample sets, the radio always sends 1
+	if (!sample.parseSamples(frame.data() + 16, frame.length() - 17)) {
+		debugDump("Bad IO sample", frame);
+		return;
+	}
+
+	updateRxStats(sample.m_address, sample.m_netAddress, sample.m_receiveOptions);
+
+	emit receiveIOSample(sample);
+}
+
+void ZigbeeController::updateRxStats(quint64 address, quint16 netAddress, quint8 receiveOptions)
+{
+	QMutexLocker lock(&m_statsMutex);
 
 	if (m_zbStats.contains(address)) {
 		ZigbeeStats *stats = m_zbStats.value(address);
-		stats->m_lastReceiveOptions = 0xff & packet.at(20);
+		stats->m_lastReceiveOptions = receiveOptions;
 		stats->m_rxCount++;
+
+		// whatever the node just sent from is good
+		if (netAddress != ZIGBEE_BROADCAST_ADDRESS)
+			stats->m_netAddress = netAddress;
 	}
 	else {
-		quint16 netAddress = getU16(packet, 12);
 		ZigbeeStats *stats = new ZigbeeStats(address, 0, netAddress, m_nodeDiscoverSequence);
-		stats->m_lastReceiveOptions = 0xff & packet.at(20);
+		stats->m_lastReceiveOptions = receiveOptions;
 		stats->m_rxCount = 1;
 		m_zbStats.insert(address, stats);
 	}
 
-	m_statsMutex.unlock();
-
-	QByteArray data = packet.mid(21, packetLen - 22);
-
-	emit receiveData(address, data);
+	if (netAddress != ZIGBEE_BROADCAST_ADDRESS)
+		m_addressCache.update(address, netAddress);
 }
 
-quint8 ZigbeeController::getNextFrameID()
+// Writes the address cache out if it changed. The file is written from
+// a copy so the rx path isn't held up behind the disk.
+void ZigbeeController::saveAddressCache()
 {
-	m_lastFrameID++;
+	m_statsMutex.lock();
+
+	if (m_addressCachePath.length() == 0 || !m_addressCache.isDirty()) {
+		m_statsMutex.unlock();
+		return;
+	}
+
+	ZigbeeAddressCache cache = m_addressCache;
+	QString path = m_addressCachePath;
 
-	if (m_lastFrameID == 0)
-		m_lastFrameID = 1;
+	m_addressCache.setDirty(false);
+	m_statsMutex.unlock();
 
-	return m_lastFrameID;
+	if (!cache.save(path)) {
+		m_statsMutex.lock();
+		m_addressCache.setDirty(true);
+		m_statsMutex.unlock();
+	}
 }
 
 // sum of frameLen bytes mod 0xff subtracted from 0xff
 // frame data starts at byte 3, after start delim and length fields
-quint8 ZigbeeController::checksum(QByteArray data, int frameLen)
+quint8 ZigbeeController::checksum(const char *data, int frameLen)
 {
 	quint8 checksum = 0;
 
 	for (int i = 0; i < frameLen; i++)
-		checksum += 0xff & data.at(i + 3);
+		checksum += 0xff & data[i + 3];
 
 	return 0xff - checksum;
 }
@@ -843,7 +2706,8 @@ void ZigbeeController::doNodeDiscoverResponse()
 
 	emit nodeDiscoverResponse(list);
 
-	m_nextAutoNodeDiscover = m_autoNodeDiscoverInterval * (1000 / CONTROLLER_BACKGROUND_INTERVAL);
+	if (m_autoNodeDiscoverInterval > 0)
+		setTimer(CONTROLLER_TIMER_AUTO_ND, 1000 * (qint64)m_autoNodeDiscoverInterval);
 }
 
 ZigbeeStats ZigbeeController::localRadio()
@@ -863,3 +2727,129 @@ ZigbeeStats ZigbeeController::localRadio()
 
 	return zb;
 }
+
+// A remote node joined or had its commissioning button pressed. Only
+// that node is updated, nothing else on the network is disturbed.
+void ZigbeeController::handleNodeIDIndicator(const ZigbeeFrame &frame)
+{
+	if (m_debugDump)
+		debugDump("Node ID", frame);
+
+	// the sender fields come first, then the same record as ND
+	ZigbeeStats *newZB = parseNodeRecord(frame, 15);
+
+	if (!newZB) {
+		debugDump("Bad node identification indicator", frame);
+		return;
+	}
+
+	QMutexLocker lock(&m_statsMutex);
+
+	newZB->m_nodeDiscoverSequence = m_nodeDiscoverSequence;
+
+	if (m_zbStats.contains(newZB->m_address)) {
+		ZigbeeStats *zb = m_zbStats.value(newZB->m_address);
+		zb->updateFromNodeDiscovery(newZB);
+		delete newZB;
+		newZB = zb;
+	}
+	else {
+		m_zbStats.insert(newZB->m_address, newZB);
+	}
+
+	m_addressCache.update(newZB->m_address, newZB->m_netAddress);
+
+	// a copy, listeners may want to call stats()
+	ZigbeeStats zb = *newZB;
+
+	lock.unlock();
+
+	emit nodeUpdate(zb);
+}
+
+void ZigbeeController::handleModemStatus(const ZigbeeFrame &frame)
+{
+	if (frame.length() < 6) {
+		debugDump("Modem status too short", frame);
+		return;
+	}
+
+	quint8 status = frame.at(4);
+
+	switch (status) {
+	case ZIGBEE_MODEM_HARDWARE_RESET:
+	case ZIGBEE_MODEM_WATCHDOG_RESET:
+	case ZIGBEE_MODEM_JOINED:
+	case ZIGBEE_MODEM_COORDINATOR_STARTED:
+		// the PAN or our own settings may have changed under us
+		qDebug("Modem status 0x%02X, requerying local radio", status);
+		queryLocalRadio();
+
+		// and the radio has forgotten any source route we gave it
+		m_txMutex.lock();
+		m_installedRoute = 0;
+		m_txMutex.unlock();
+		break;
+
+	case ZIGBEE_MODEM_DISASSOCIATED:
+		qDebug("Local radio disassociated");
+		break;
+
+	default:
+		if (m_debugDump)
+			debugDump("Modem status", frame);
+
+		break;
+	}
+}
+
+// A remote node's path to us, sent ahead of its data once the local radio
+// is a many-to-one concentrator. Frame type, 64-bit and 16-bit source,
+// receive options, hop count and then the hops.
+void ZigbeeController::handleRouteRecord(const ZigbeeFrame &frame)
+{
+	QVector<quint16> hops;
+
+	if (m_debugDump)
+		debugDump("Route record", frame);
+
+	if (!m_sourceRouting)
+		return;
+
+	if (frame.length() < 17) {
+		debugDump("Route record too short", frame);
+		return;
+	}
+
+	quint64 address = frame.getU64(4);
+	quint16 netAddress = frame.getU16(12);
+	int count = frame.at(15);
+
+	if (frame.length() < 17 + 2 * count) {
+		debugDump("Route record hops missing", frame);
+		return;
+	}
+
+	hops.reserve(count);
+
+	for (int i = 0; i < count; i++)
+		hops.append(frame.getU16(16 + 2 * i));
+
+	QMutexLocker lock(&m_txMutex);
+
+	// the radio's copy is stale if it has this destination loaded
+	if (m_sourceRoutes.update(address, netAddress, hops, m_clock.elapsed()) && address == m_installedRoute)
+		m_installedRoute = 0;
+}
+
+// a delivery failed, let the radio find its own way until a new record
+void ZigbeeController::expireSourceRoute(quint64 address)
+{
+	QMutexLocker lock(&m_txMutex);
+
+	if (!m_sourceRoutes.invalidate(address))
+		return;
+
+	if (address == m_installedRoute)
+		m_installedRoute = 0;
+}
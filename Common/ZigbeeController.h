@@ -23,17 +23,53 @@
 #include <qthread.h>
 #include <qbytearray.h>
 #include <qmutex.h>
+#include <qwaitcondition.h>
 #include <qqueue.h>
 #include <qsettings.h>
 #include <qhash.h>
+#include <qset.h>
 #include <qstringlist.h>
+#include <qelapsedtimer.h>
 
 #include "qextserialport.h"
 #include "ZigbeeStats.h"
 #include "ZigbeeCommon.h"
+#include "ZigbeeRxRing.h"
+#include "ZigbeeFrame.h"
+#include "ZigbeeFrameHandler.h"
+#include "ZigbeeEscape.h"
+#include "ZigbeeIOSample.h"
+#include "ZigbeePerfStats.h"
+#include "ZigbeeTxFrame.h"
+#include "ZigbeeTxScheduler.h"
+#include "ZigbeeTxPacer.h"
+#include "ZigbeeCapture.h"
+#include "ZigbeeFrameLeases.h"
+#include "ZigbeeFragment.h"
+#include "ZigbeeBundle.h"
+#include "ZigbeeAddressCache.h"
+#include "ZigbeeSourceRoutes.h"
+#include "ZigbeeFramePool.h"
+#include "ZigbeeATBatch.h"
 
-// limited by the one-byte frame id field
-#define MAX_PENDING_FRAMES 256
+// largest frame length field we believe, anything bigger is line noise
+#define MAX_RX_FRAME_LEN 512
+
+// AP=2 input is read here first and unescaped into the rx ring
+#define RX_RAW_CHUNK 512
+
+// run loop timers
+#define CONTROLLER_TIMER_ND_RESPONSE  0
+#define CONTROLLER_TIMER_AUTO_ND      1
+#define CONTROLLER_TIMER_RATES        2
+#define CONTROLLER_TIMER_LEASES       3
+#define CONTROLLER_TIMER_RETRY        4
+#define CONTROLLER_TIMER_BUNDLE       5
+#define CONTROLLER_TIMER_PACE         6
+#define CONTROLLER_TIMER_ADDRESS_CACHE 7
+#define CONTROLLER_TIMER_CTS          8
+#define CONTROLLER_TIMER_RX_FRAME     9
+#define CONTROLLER_TIMERS             10
 
 
 class ZigbeeController : public QThread {
@@ -51,38 +87,98 @@ public:
 	QList<ZigbeeStats> stats();
 	ZigbeeStats localRadio();
 
+	ZigbeeFrameHandler *registerFrameHandler(quint8 frameType, ZigbeeFrameHandler *handler);
+	quint32 unclaimedFrames(int frameType = -1);
+	ZigbeePerfStats perfStats();
+	int txQueued(quint64 address);
+	void setFragmentation(quint64 address, bool enable);
+	void setBundling(quint64 address, bool enable);
+	int maxPayload();
+	quint32 submitATBatch(const ZigbeeATBatch &batch);
+
 public slots:
 	void readyRead();
 	void sendData(quint64 address, QByteArray data);
+	void sendData(quint64 address, QByteArray data, int priority);
 	void requestNodeDiscover();
 	void requestNodeIDChange(quint64 address, QString nodeID);
 
 signals:
-	void receiveData(quint64 address, QByteArray data);
+	void receiveData(quint64 address, const QByteArray &data);
+	void receiveIOSample(const ZigbeeIOSample &sample);
 	void localRadioAddress(quint64 address);
 	void nodeDiscoverResponse(QList<ZigbeeStats>);
+	void nodeUpdate(ZigbeeStats);
+	void deliveryReport(quint64 address, int status, int attempts);
+	void txCongestion(quint64 address, bool congested);
+	void txDropped(quint64 address, int count);
+	void atBatchComplete(const ZigbeeATBatch &batch);
 
 protected:
 	void run();
 
 private:
 	void doWrites();
-	quint8 checksum(QByteArray data, int frameLen);
-	quint8 getNextFrameID();
-	void handleATCommandResponse(QByteArray packet, int packetLen);
-	void parseLocalNIResponse(QByteArray packet, int packetLen);
-	void handleTransmitStatus(QByteArray packet);
-	void handleReceivePacket(QByteArray packet, int packetLen);
-	void handleExplicitRxPacket(QByteArray packet, int packetLen);
+	bool checkCTS();
+	int txSpace();
+	int gatherFrame(const ZigbeeTxFrame &txFrame, quint8 frameID, int offset);
+	void writeGathered(int len, int frames);
+	bool waitWritable();
+	void queueTxFrame(const QByteArray &packet, quint64 address = 0);
+	bool nextFragmentID(quint64 address, quint8 *messageID);
+	bool isBundling(quint64 address);
+	void bundleData(quint64 address, quint16 netAddress, const QByteArray &data, int priority);
+	int flushBundle(quint64 address, const ZigbeeBundle &bundle);
+	void runBundles();
+	void emitWatermarkEvents(const QList<ZigbeeTxWatermark> &events);
+	void wakeWriter();
+	void setTimer(int timer, qint64 msecs);
+	int waitTime();
+	void runTimers();
+	void runIOThread();
+	void setIOThreadScheduling();
+	void unescapeIntoRing(const char *data, int len);
+	void parseRxFrames();
+	void expireRxFrame();
+	void dispatchFrame(const ZigbeeFrame &frame);
+	bool completeLease(quint8 frameID, ZigbeeFrameLease *lease);
+	void expireLeases();
+	void releaseTxWindow(quint64 address, bool failed);
+	void updatePacing(quint64 address, bool congested);
+	bool scheduleRetry(const ZigbeeFrameLease &lease, quint8 status);
+	void runRetries();
+	qint64 leaseTimeout(const ZigbeeTxFrame &txFrame, bool *multiResponse);
+	void updateRates();
+	quint8 checksum(const char *data, int frameLen);
+	void handleATCommandResponse(const ZigbeeFrame &frame);
+	void parseLocalNIResponse(const ZigbeeFrame &frame);
+	void handleTransmitStatus(const ZigbeeFrame &frame);
+	void handleReceivePacket(const ZigbeeFrame &frame);
+	void handleExplicitRxPacket(const ZigbeeFrame &frame);
+	void handleIOSample(const ZigbeeFrame &frame);
+	void deliverData(quint64 address, const QByteArray &data);
+	void updateRxStats(quint64 address, quint16 netAddress, quint8 receiveOptions);
+	void saveAddressCache();
 	void queryLocalRadio();
 	void postATCommand(quint16 atcmd);
 	void postATCommand(quint16 atcmd, QByteArray data);
 	void postRemoteATCommand(quint64 address, quint16 atcmd, QByteArray data);
-	void handleRemoteATCommandResponse(QByteArray packet, int packetLen);
-	void handleNDResponsePacket(QByteArray packet, int packetLen);
-	ZigbeeStats *parseNDResponse(QByteArray packet, int packetLen);
+	quint16 remoteNetAddress(quint64 address);
+	void feedATBatches();
+	void completeATResponse(const ZigbeeFrame &frame);
+	void finishATCommand(quint32 batchID, int index, int status, const QByteArray &value);
+	void handleRemoteATCommandResponse(const ZigbeeFrame &frame);
+	void handleNDResponsePacket(const ZigbeeFrame &frame);
+	ZigbeeStats *parseNDResponse(const ZigbeeFrame &frame);
+	ZigbeeStats *parseNodeRecord(const ZigbeeFrame &frame, int start);
+	void handleNodeIDIndicator(const ZigbeeFrame &frame);
+	void handleModemStatus(const ZigbeeFrame &frame);
+	void handleRouteRecord(const ZigbeeFrame &frame);
+	void expireSourceRoute(quint64 address);
 	void doNodeDiscoverResponse();
-	void debugDump(const char *prompt, QByteArray data);
+	void debugDump(const char *prompt, const QByteArray &data);
+	void debugDump(const char *prompt, const ZigbeeFrame &frame);
+	void debugDump(const char *prompt, const char *data, int len);
 
 	volatile bool m_stop;
 	bool m_debugDump;
@@ -92,24 +188,130 @@ private:
 	quint32 m_localTxCount;
 	quint32 m_localRxCount;
 	quint64 m_panID;
-	quint32 m_nodeDiscoverWait;
 	quint32 m_nodeDiscoverSequence;
-	quint32 m_nextAutoNodeDiscover;
 	quint32 m_autoNodeDiscoverInterval;
 
+	// m_txMutex also covers the timers and the wakeup state
 	QMutex m_txMutex;
-	QQueue<QByteArray> m_txQ;
+	QWaitCondition m_txWait;
+	ZigbeeTxScheduler m_txQ;
+	QList<ZigbeeTxFrame> m_txRetryQ;
+	int m_txRetryLimit;
+	int m_txRetryBackoff;
+	quint32 m_txRetryCount;
+	quint32 m_txFailed;
+	qint64 m_timers[CONTROLLER_TIMERS];
+	int m_wakePipe[2];
+	bool m_wakePending;
+	bool m_txLeaseWait;
+	ZigbeeTxPacer m_pacer;
+	bool m_txPaceWait;
+	quint32 m_txMacRetries;
+
+	// RTS/CTS and writes held while the radio has CTS down, the hold
+	// counts and msecs under m_txMutex
+	bool m_flowControl;
+	bool m_txCtsWait;
+	quint32 m_ctsStalls;
+	qint64 m_ctsStallStart;
+	qint64 m_ctsStallTime;
+	QByteArray m_txGather;
+	ZigbeeFramePool m_framePool;
+
+	// routes from route record indicators and the destination whose
+	// route the radio is holding, 0 for none
+	bool m_sourceRouting;
+	int m_manyToOne;
+	ZigbeeSourceRoutes m_sourceRoutes;
+	quint64 m_installedRoute;
+	quint32 m_sourceRoutesSent;
+
+	// AT batches by id, oldest first, and how many of their commands
+	// are queued or waiting on a response
+	QMap<quint32, ZigbeeATBatch> m_atBatches;
+	quint32 m_nextATBatchID;
+	int m_atInFlight;
+	quint32 m_atBatchesDone;
+	quint32 m_atCommands;
+	quint32 m_atTimeouts;
 
 	QextSerialPort *m_port;
+	ZigbeeCapture m_capture;
+	int m_apiMode;
+	bool m_ioThread;
+	int m_ioPriority;
+	int m_ioCpu;
 
 	QMutex m_statsMutex;
 	QMap<quint64, ZigbeeStats *> m_zbStats;
 
-	quint64 m_pendingFrames[MAX_PENDING_FRAMES];
-	quint8 m_lastFrameID;
+	// also under m_statsMutex
+	QHash<quint64, ZigbeeTxTemplate> m_txTemplates;
+	ZigbeeAddressCache m_addressCache;
+	QString m_addressCachePath;
+	quint32 m_addressCacheHits;
+
+	// destinations that talk in fragments and the last message id each
+	// was sent, under m_statsMutex
+	QHash<quint64, quint8> m_fragmentIDs;
+	int m_maxPayload;
+	quint32 m_txFragments;
+	ZigbeeReassembler m_reassembler;
+
+	// destinations that take bundles under m_statsMutex, the bundles
+	// being filled under m_txMutex
+	QSet<quint64> m_bundleDestinations;
+	QHash<quint64, ZigbeeBundle> m_bundles;
+	int m_bundleWindow;
+	quint32 m_txBundles;
+	quint32 m_txBundledMessages;
+
+	ZigbeeFrameLeases m_leases;
+	quint32 m_txLeaseTimeouts;
+	quint32 m_txLeaseStalls;
+	quint32 m_txLateResponses;
 
 	QMutex m_rxMutex;
-	QByteArray m_rxBuffer;
+	ZigbeeRxRing m_rxRing;
+	char m_rxScratch[MAX_RX_FRAME_LEN + 4];
+	char m_rxRaw[RX_RAW_CHUNK];
+	bool m_rxEscapePending;
+	qint64 m_rxPendingSince;
+	quint32 m_rxChecksumErrors;
+	quint32 m_rxResyncs;
+
+	QElapsedTimer m_clock;
+
+	typedef void (ZigbeeController::*BuiltinHandler)(const ZigbeeFrame &frame);
+
+	BuiltinHandler m_builtinHandlers[256];
+	ZigbeeFrameHandler *m_frameHandlers[256];
+	quint32 m_unclaimedFrames[256];
+
+	// rx side written only by the thread that reads the port, tx side
+	// only by the one that runs doWrites()
+	ZigbeeHistogram m_rxLatency[256];
+	ZigbeeHistogram m_txDwell[256];
+	ZigbeeHistogram m_txResponse[256];
+	qint64 m_rxReadAt;
+	quint64 m_rxFrames;
+	quint64 m_rxBytes;
+	quint64 m_txFrames;
+	quint64 m_txBytes;
+	quint64 m_txWrites;
+	quint32 m_txPartialWrites;
+	quint32 m_txWriteMaxFrames;
+	quint32 m_txWriteMaxBytes;
+
+	qint64 m_rateStart;
+	quint64 m_rateRxFrames;
+	quint64 m_rateRxBytes;
+	quint64 m_rateTxFrames;
+	quint64 m_rateTxBytes;
+	quint32 m_rxFramesPerSec;
+	quint32 m_rxBytesPerSec;
+	quint32 m_txFramesPerSec;
+	quint32 m_txBytesPerSec;
 };
 
 #endif // ZIGBEE_CONTROLLER
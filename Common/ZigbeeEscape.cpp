@@ -0,0 +1,302 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <string.h>
+
+#include "ZigbeeEscape.h"
+#include "ZigbeeCommon.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ESCAPE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ESCAPE_NEON
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// The special bytes are rare in real traffic, so the work is finding
+// them. Both scanners return the index of the first byte in p that
+// needs attention, or len if there isn't one. A 16 byte block is
+// checked at once with SSE2 or NEON, otherwise 8 bytes at a time in a
+// 64-bit word. Whatever is left over goes a byte at a time.
+
+static inline bool isEscapeByte(quint8 c)
+{
+	return c == ZIGBEE_START_DELIM || c == ZIGBEE_ESCAPE_CHAR
+		|| c == ZIGBEE_XON || c == ZIGBEE_XOFF;
+}
+
+static inline bool isUnescapeByte(quint8 c)
+{
+	return c == ZIGBEE_START_DELIM || c == ZIGBEE_ESCAPE_CHAR;
+}
+
+#ifdef ESCAPE_SSE2
+
+static inline int firstSetBit(int bits)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, bits);
+	return (int)index;
+#else
+	return __builtin_ctz(bits);
+#endif
+}
+
+static int scanEscape(const quint8 *p, int len)
+{
+	const __m128i delim = _mm_set1_epi8(ZIGBEE_START_DELIM);
+	const __m128i esc = _mm_set1_epi8(ZIGBEE_ESCAPE_CHAR);
+	const __m128i xon = _mm_set1_epi8(ZIGBEE_XON);
+	const __m128i xoff = _mm_set1_epi8(ZIGBEE_XOFF);
+	int i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+
+		__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, delim), _mm_cmpeq_epi8(v, esc)),
+								 _mm_or_si128(_mm_cmpeq_epi8(v, xon), _mm_cmpeq_epi8(v, xoff)));
+
+		int bits = _mm_movemask_epi8(m);
+
+		if (bits)
+			return i + firstSetBit(bits);
+	}
+
+	for (; i < len; i++) {
+		if (isEscapeByte(p[i]))
+			break;
+	}
+
+	return i;
+}
+
+static int scanUnescape(const quint8 *p, int len)
+{
+	const __m128i delim = _mm_set1_epi8(ZIGBEE_START_DELIM);
+	const __m128i esc = _mm_set1_epi8(ZIGBEE_ESCAPE_CHAR);
+	int i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+
+		int bits = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, delim), _mm_cmpeq_epi8(v, esc)));
+
+		if (bits)
+			return i + firstSetBit(bits);
+	}
+
+	for (; i < len; i++) {
+		if (isUnescapeByte(p[i]))
+			break;
+	}
+
+	return i;
+}
+
+#elif defined(ESCAPE_NEON)
+
+static inline bool anySet(uint8x16_t m)
+{
+	uint8x8_t x = vorr_u8(vget_low_u8(m), vget_high_u8(m));
+
+	return vget_lane_u64(vreinterpret_u64_u8(x), 0) != 0;
+}
+
+static int scanEscape(const quint8 *p, int len)
+{
+	const uint8x16_t delim = vdupq_n_u8(ZIGBEE_START_DELIM);
+	const uint8x16_t esc = vdupq_n_u8(ZIGBEE_ESCAPE_CHAR);
+	const uint8x16_t xon = vdupq_n_u8(ZIGBEE_XON);
+	const uint8x16_t xoff = vdupq_n_u8(ZIGBEE_XOFF);
+	int i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		uint8x16_t v = vld1q_u8(p + i);
+
+		uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, delim), vceqq_u8(v, esc)),
+								vorrq_u8(vceqq_u8(v, xon), vceqq_u8(v, xoff)));
+
+		// the scalar loop below finds which byte it was
+		if (anySet(m))
+			break;
+	}
+
+	for (; i < len; i++) {
+		if (isEscapeByte(p[i]))
+			break;
+	}
+
+	return i;
+}
+
+static int scanUnescape(const quint8 *p, int len)
+{
+	const uint8x16_t delim = vdupq_n_u8(ZIGBEE_START_DELIM);
+	const uint8x16_t esc = vdupq_n_u8(ZIGBEE_ESCAPE_CHAR);
+	int i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		uint8x16_t v = vld1q_u8(p + i);
+
+		if (anySet(vorrq_u8(vceqq_u8(v, delim), vceqq_u8(v, esc))))
+			break;
+	}
+
+	for (; i < len; i++) {
+		if (isUnescapeByte(p[i]))
+			break;
+	}
+
+	return i;
+}
+
+#else
+
+#define SWAR_ONES  0x0101010101010101ULL
+#define SWAR_HIGHS 0x8080808080808080ULL
+
+// non-zero if any byte of v is zero
+#define SWAR_HASZERO(v) (((v) - SWAR_ONES) & ~(v) & SWAR_HIGHS)
+
+// non-zero if any byte of v equals c
+#define SWAR_HASBYTE(v, c) SWAR_HASZERO((v) ^ (SWAR_ONES * (c)))
+
+static int scanEscape(const quint8 *p, int len)
+{
+	quint64 v;
+	int i;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		memcpy(&v, p + i, 8);
+
+		if (SWAR_HASBYTE(v, ZIGBEE_START_DELIM) | SWAR_HASBYTE(v, ZIGBEE_ESCAPE_CHAR)
+				| SWAR_HASBYTE(v, ZIGBEE_XON) | SWAR_HASBYTE(v, ZIGBEE_XOFF))
+			break;
+	}
+
+	for (; i < len; i++) {
+		if (isEscapeByte(p[i]))
+			break;
+	}
+
+	return i;
+}
+
+static int scanUnescape(const quint8 *p, int len)
+{
+	quint64 v;
+	int i;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		memcpy(&v, p + i, 8);
+
+		if (SWAR_HASBYTE(v, ZIGBEE_START_DELIM) | SWAR_HASBYTE(v, ZIGBEE_ESCAPE_CHAR))
+			break;
+	}
+
+	for (; i < len; i++) {
+		if (isUnescapeByte(p[i]))
+			break;
+	}
+
+	return i;
+}
+
+#endif
+
+int zigbeeEscape(const char *src, int len, char *dst)
+{
+	const quint8 *s = (const quint8 *)src;
+	char *d = dst;
+	int i = 0;
+
+	while (i < len) {
+		int run = scanEscape(s + i, len - i);
+
+		if (run > 0) {
+			memcpy(d, s + i, run);
+			d += run;
+			i += run;
+
+			if (i == len)
+				break;
+		}
+
+		*d++ = ZIGBEE_ESCAPE_CHAR;
+		*d++ = s[i++] ^ ZIGBEE_ESCAPE_XOR;
+	}
+
+	return (int)(d - dst);
+}
+
+int zigbeeUnescape(const char *src, int len, char *dst, int *dstLen, bool *escapePending)
+{
+	const quint8 *s = (const quint8 *)src;
+	int i = 0;
+	int n = 0;
+
+	// a 0x7D was the last byte of the previous chunk
+	if (*escapePending && len > 0) {
+		*escapePending = false;
+
+		if (s[0] != ZIGBEE_START_DELIM) {
+			dst[n++] = s[0] ^ ZIGBEE_ESCAPE_XOR;
+			i = 1;
+		}
+	}
+
+	while (i < len) {
+		int run = scanUnescape(s + i, len - i);
+
+		if (run > 0) {
+			memcpy(dst + n, s + i, run);
+			n += run;
+			i += run;
+
+			if (i == len)
+				break;
+		}
+
+		if (s[i] == ZIGBEE_START_DELIM)
+			break;
+
+		// the escape char, the byte it covers may be in the next chunk
+		if (++i == len) {
+			*escapePending = true;
+			break;
+		}
+
+		// an escape followed by a raw delimiter is a broken frame,
+		// let the delimiter win
+		if (s[i] == ZIGBEE_START_DELIM)
+			break;
+
+		dst[n++] = s[i++] ^ ZIGBEE_ESCAPE_XOR;
+	}
+
+	*dstLen = n;
+
+	return i;
+}
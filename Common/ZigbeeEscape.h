@@ -0,0 +1,39 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef ZIGBEE_ESCAPE
+#define ZIGBEE_ESCAPE
+
+#include <qglobal.h>
+
+// API mode 2 (AP=2) byte stuffing. Any byte after the start delimiter
+// that is 0x7E, 0x7D, 0x11 or 0x13 goes on the wire as 0x7D followed by
+// the byte xor 0x20, so a raw 0x7E always starts a frame.
+
+// dst must have room for 2 * len bytes, returns the escaped length
+int zigbeeEscape(const char *src, int len, char *dst);
+
+// Unescape up to len bytes into dst, which needs room for len bytes.
+// Stops in front of a raw start delimiter so the caller can treat it
+// as a frame boundary. escapePending carries a trailing 0x7D over to
+// the next call. Returns the number of src bytes consumed, the number
+// written to dst goes in dstLen.
+int zigbeeUnescape(const char *src, int len, char *dst, int *dstLen, bool *escapePending);
+
+#endif // ZIGBEE_ESCAPE
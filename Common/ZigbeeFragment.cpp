@@ -0,0 +1,180 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "ZigbeeFragment.h"
+
+
+QList<QByteArray> splitFragments(const QByteArray &data, int maxPayload, quint8 messageID)
+{
+	QList<QByteArray> fragments;
+	int chunk = maxPayload - ZIGBEE_FRAG_HEADER_LEN;
+
+	if (chunk < 1)
+		return fragments;
+
+	int count = (data.length() + chunk - 1) / chunk;
+
+	if (count == 0)
+		count = 1;
+
+	if (count > ZIGBEE_FRAG_MAX_COUNT)
+		return fragments;
+
+	for (int i = 0; i < count; i++) {
+		QByteArray fragment;
+
+		fragment.reserve(ZIGBEE_FRAG_HEADER_LEN + chunk);
+		fragment.append((char)messageID);
+		fragment.append((char)i);
+		fragment.append((char)count);
+		fragment.append(data.mid(i * chunk, chunk));
+
+		fragments.append(fragment);
+	}
+
+	return fragments;
+}
+
+ZigbeeReassembler::ZigbeeReassembler()
+{
+	m_completed = 0;
+	m_timeouts = 0;
+	m_overflows = 0;
+	m_malformed = 0;
+	m_bytes = 0;
+}
+
+void ZigbeeReassembler::clear()
+{
+	m_partial.clear();
+	m_bytes = 0;
+}
+
+// True with the whole message in *message once the last of its fragments
+// comes in. Repeats of a fragment we already have are ignored.
+bool ZigbeeReassembler::add(quint64 address, const QByteArray &fragment, qint64 now, QByteArray *message)
+{
+	expire(now);
+
+	if (fragment.length() < ZIGBEE_FRAG_HEADER_LEN) {
+		m_malformed++;
+		return false;
+	}
+
+	quint8 messageID = fragment.at(0);
+	int index = 0xff & fragment.at(1);
+	int count = 0xff & fragment.at(2);
+
+	if (count == 0 || index >= count) {
+		m_malformed++;
+		return false;
+	}
+
+	if (count == 1) {
+		*message = fragment.mid(ZIGBEE_FRAG_HEADER_LEN);
+		m_completed++;
+		return true;
+	}
+
+	int i;
+
+	for (i = 0; i < m_partial.count(); i++) {
+		if (m_partial.at(i).m_address == address && m_partial.at(i).m_messageID == messageID)
+			break;
+	}
+
+	if (i == m_partial.count()) {
+		ZigbeePartialMessage partial;
+
+		partial.m_address = address;
+		partial.m_messageID = messageID;
+		partial.m_received = 0;
+		partial.m_bytes = 0;
+		partial.m_started = now;
+		partial.m_fragments.resize(count);
+		partial.m_have.fill(false, count);
+
+		m_partial.append(partial);
+	}
+
+	ZigbeePartialMessage &partial = m_partial[i];
+
+	// a sender reusing the id for a different message
+	if (partial.m_fragments.count() != count) {
+		m_malformed++;
+		m_bytes -= partial.m_bytes;
+		m_partial.removeAt(i);
+		return false;
+	}
+
+	if (partial.m_have.at(index))
+		return false;
+
+	QByteArray data = fragment.mid(ZIGBEE_FRAG_HEADER_LEN);
+
+	partial.m_fragments[index] = data;
+	partial.m_have[index] = true;
+	partial.m_received++;
+	partial.m_bytes += data.length();
+	m_bytes += data.length();
+
+	if (partial.m_received == count) {
+		message->clear();
+		message->reserve(partial.m_bytes);
+
+		for (int j = 0; j < count; j++)
+			message->append(partial.m_fragments.at(j));
+
+		m_bytes -= partial.m_bytes;
+		m_partial.removeAt(i);
+		m_completed++;
+		return true;
+	}
+
+	while (m_partial.count() > ZIGBEE_REASSEMBLY_MAX_MESSAGES || m_bytes > ZIGBEE_REASSEMBLY_MAX_BYTES)
+		dropOldest();
+
+	return false;
+}
+
+// throws away partial messages that have waited too long, returns how many
+int ZigbeeReassembler::expire(qint64 now)
+{
+	int expired = 0;
+
+	while (!m_partial.isEmpty() && now - m_partial.first().m_started >= ZIGBEE_REASSEMBLY_TIMEOUT) {
+		m_bytes -= m_partial.first().m_bytes;
+		m_partial.removeFirst();
+		expired++;
+	}
+
+	m_timeouts += expired;
+
+	return expired;
+}
+
+void ZigbeeReassembler::dropOldest()
+{
+	if (m_partial.isEmpty())
+		return;
+
+	m_bytes -= m_partial.first().m_bytes;
+	m_partial.removeFirst();
+	m_overflows++;
+}
@@ -0,0 +1,84 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef ZIGBEE_FRAGMENT_H
+#define ZIGBEE_FRAGMENT_H
+
+#include <qbytearray.h>
+#include <qlist.h>
+#include <qvector.h>
+
+// Each fragment of a message to or from a device with fragment=true
+// starts with a message id, the fragment index and the fragment count.
+// A message that fits in one frame still gets the header, count 1.
+#define ZIGBEE_FRAG_HEADER_LEN 3
+#define ZIGBEE_FRAG_MAX_COUNT 255
+
+// what we assume fits in a frame until the radio answers ATNP
+#define ZIGBEE_DEFAULT_MAX_PAYLOAD 72
+
+// msecs a partial message is kept waiting for the rest of its fragments
+#define ZIGBEE_REASSEMBLY_TIMEOUT 5000
+
+// the oldest partial message is thrown away to stay under these
+#define ZIGBEE_REASSEMBLY_MAX_MESSAGES 16
+#define ZIGBEE_REASSEMBLY_MAX_BYTES 65536
+
+// the payloads for data split into maxPayload sized frames, empty if
+// it would take more than ZIGBEE_FRAG_MAX_COUNT of them
+QList<QByteArray> splitFragments(const QByteArray &data, int maxPayload, quint8 messageID);
+
+class ZigbeePartialMessage
+{
+public:
+	quint64 m_address;
+	quint8 m_messageID;
+	int m_received;
+	int m_bytes;
+	qint64 m_started;
+	QVector<QByteArray> m_fragments;
+	QVector<bool> m_have;
+};
+
+// Puts messages back together from their fragments, in whatever order
+// the fragments show up. Only the thread that handles received frames
+// uses it. Times are msecs on the controller's clock.
+class ZigbeeReassembler
+{
+public:
+	ZigbeeReassembler();
+
+	void clear();
+	bool add(quint64 address, const QByteArray &fragment, qint64 now, QByteArray *message);
+	int expire(qint64 now);
+
+	quint32 m_completed;
+	quint32 m_timeouts;
+	quint32 m_overflows;
+	quint32 m_malformed;
+
+private:
+	void dropOldest();
+
+	// oldest first
+	QList<ZigbeePartialMessage> m_partial;
+	int m_bytes;
+};
+
+#endif // ZIGBEE_FRAGMENT_H
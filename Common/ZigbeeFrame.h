@@ -0,0 +1,65 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef ZIGBEE_FRAME
+#define ZIGBEE_FRAME
+
+#include <qbytearray.h>
+
+#include "ZigbeeUtils.h"
+
+// A view of one received API frame, start delim through checksum. It
+// does not own the bytes, they are still sitting in the rx ring, so a
+// frame is only good until the handler it was passed to returns. Use
+// copy() for anything that has to live longer.
+//
+// Handlers check the length before they read fixed offsets. As a last
+// line, reads past the end of the frame come back as zero and copy()
+// clamps like QByteArray::mid(), rather than wander into the ring.
+class ZigbeeFrame
+{
+public:
+	ZigbeeFrame(const char *data, int len) : m_data(data), m_len(len) {}
+
+	const char *data() const { return m_data; }
+	int length() const { return m_len; }
+	quint8 frameType() const { return 0xff & m_data[3]; }
+
+	quint8 at(int pos) const { return inFrame(pos, 1) ? 0xff & m_data[pos] : 0; }
+	quint16 getU16(int pos) const { return inFrame(pos, 2) ? ::getU16(m_data + pos) : 0; }
+	quint32 getU32(int pos) const { return inFrame(pos, 4) ? ::getU32(m_data + pos) : 0; }
+	quint64 getU64(int pos) const { return inFrame(pos, 8) ? ::getU64(m_data + pos) : 0; }
+
+	// a single allocation for the bytes that leave the controller
+	QByteArray copy(int pos, int len) const
+	{
+		if (pos < 0 || pos >= m_len || len <= 0)
+			return QByteArray();
+
+		return QByteArray(m_data + pos, qMin(len, m_len - pos));
+	}
+
+private:
+	bool inFrame(int pos, int len) const { return pos >= 0 && pos + len <= m_len; }
+
+	const char *m_data;
+	int m_len;
+};
+
+#endif // ZIGBEE_FRAME
@@ -0,0 +1,38 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef ZIGBEE_FRAME_HANDLER
+#define ZIGBEE_FRAME_HANDLER
+
+#include "ZigbeeFrame.h"
+
+// Implement this to see received frames of a given type without touching
+// the controller, see ZigbeeController::registerFrameHandler(). Handlers
+// run on whatever thread reads the serial port, so keep them short and
+// copy anything that has to outlive the call.
+class ZigbeeFrameHandler
+{
+public:
+	virtual ~ZigbeeFrameHandler() {}
+
+	virtual void handleFrame(const ZigbeeFrame &frame) = 0;
+};
+
+#endif // ZIGBEE_FRAME_HANDLER
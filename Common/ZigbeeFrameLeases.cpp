@@ -0,0 +1,152 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "ZigbeeFrameLeases.h"
+
+
+void ZigbeeFrameLease::clear()
+{
+	m_live = false;
+	m_frameType = 0;
+	m_address = 0;
+	m_allocated = 0;
+	m_expires = 0;
+	m_txFrame = ZigbeeTxFrame();
+	m_multiResponse = false;
+	m_responded = false;
+}
+
+ZigbeeFrameLeases::ZigbeeFrameLeases()
+{
+	m_lastFrameID = 0;
+	m_live = 0;
+}
+
+void ZigbeeFrameLeases::clear()
+{
+	QMutexLocker lock(&m_mutex);
+
+	for (int i = 0; i < ZIGBEE_FRAME_IDS; i++)
+		m_leases[i].clear();
+
+	m_lastFrameID = 0;
+	m_live = 0;
+}
+
+// Round robin from the last id handed out, skipping anything still live,
+// so an id is not reused any sooner than it has to be.
+quint8 ZigbeeFrameLeases::allocate(const ZigbeeTxFrame &txFrame, qint64 now, qint64 timeoutMsecs, bool multiResponse)
+{
+	QMutexLocker lock(&m_mutex);
+
+	if (m_live >= ZIGBEE_FRAME_IDS - 1)
+		return 0;
+
+	quint8 frameID = m_lastFrameID;
+
+	while (true) {
+		frameID++;
+
+		if (frameID == 0)
+			frameID = 1;
+
+		if (!m_leases[frameID].m_live)
+			break;
+	}
+
+	ZigbeeFrameLease *lease = m_leases + frameID;
+
+	lease->m_live = true;
+	lease->m_frameType = txFrame.frameType();
+	lease->m_address = txFrame.m_address;
+	lease->m_txFrame = txFrame;
+	lease->m_allocated = now;
+	lease->m_expires = now + (timeoutMsecs * 1000000);
+	lease->m_multiResponse = multiResponse;
+	lease->m_responded = false;
+
+	m_lastFrameID = frameID;
+	m_live++;
+
+	return frameID;
+}
+
+// A status or response came back for frameID. Returns false if there is
+// no live lease for it, a late answer to one that already timed out.
+// roundTrip is -1 for the second and later responses of a multi
+// response lease, those stay live until they expire.
+bool ZigbeeFrameLeases::complete(quint8 frameID, qint64 now, ZigbeeFrameLease *lease, qint64 *roundTrip)
+{
+	QMutexLocker lock(&m_mutex);
+
+	ZigbeeFrameLease *p = m_leases + frameID;
+
+	if (frameID == 0 || !p->m_live)
+		return false;
+
+	if (lease)
+		*lease = *p;
+
+	if (roundTrip)
+		*roundTrip = p->m_responded ? -1 : now - p->m_allocated;
+
+	if (p->m_multiResponse) {
+		p->m_responded = true;
+	}
+	else {
+		p->clear();
+		m_live--;
+	}
+
+	return true;
+}
+
+// Reclaim leases past their deadline, returns how many of them never
+// got any answer at all. Those are also appended to expired.
+int ZigbeeFrameLeases::expire(qint64 now, QList<ZigbeeFrameLease> *expired)
+{
+	QMutexLocker lock(&m_mutex);
+	int timedOut = 0;
+
+	for (int i = 1; i < ZIGBEE_FRAME_IDS && m_live > 0; i++) {
+		ZigbeeFrameLease *p = m_leases + i;
+
+		if (!p->m_live || p->m_expires > now)
+			continue;
+
+		if (!p->m_responded) {
+			timedOut++;
+
+			if (expired)
+				expired->append(*p);
+		}
+
+		p->clear();
+		m_live--;
+	}
+
+	return timedOut;
+}
+
+int ZigbeeFrameLeases::live()
+{
+	QMutexLocker lock(&m_mutex);
+
+	return m_live;
+}
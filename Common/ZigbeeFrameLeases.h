@@ -0,0 +1,74 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef ZIGBEE_FRAME_LEASES
+#define ZIGBEE_FRAME_LEASES
+
+#include <qmutex.h>
+#include <qlist.h>
+
+#include "ZigbeeTxFrame.h"
+
+// one byte frame id field, 0 means no response wanted
+#define ZIGBEE_FRAME_IDS 256
+
+// Who has a frame id and since when. Times are nsecs on the controller's
+// clock. The frame is kept so it can be sent again.
+class ZigbeeFrameLease
+{
+public:
+	ZigbeeFrameLease() { clear(); }
+
+	void clear();
+
+	bool m_live;
+	quint8 m_frameType;
+	quint64 m_address;
+	qint64 m_allocated;
+	qint64 m_expires;
+	ZigbeeTxFrame m_txFrame;
+
+	// an ND gets a response from every node under the one frame id
+	bool m_multiResponse;
+	bool m_responded;
+};
+
+// Hands out the 255 usable frame ids. An id stays leased until its status
+// or response comes back or the lease times out, it is never handed out
+// again while live. When all of them are live allocate() returns 0 and
+// the caller has to wait. Safe to call from any thread.
+class ZigbeeFrameLeases
+{
+public:
+	ZigbeeFrameLeases();
+
+	void clear();
+	quint8 allocate(const ZigbeeTxFrame &txFrame, qint64 now, qint64 timeoutMsecs, bool multiResponse);
+	bool complete(quint8 frameID, qint64 now, ZigbeeFrameLease *lease, qint64 *roundTrip);
+	int expire(qint64 now, QList<ZigbeeFrameLease> *expired);
+	int live();
+
+private:
+	QMutex m_mutex;
+	ZigbeeFrameLease m_leases[ZIGBEE_FRAME_IDS];
+	quint8 m_lastFrameID;
+	int m_live;
+};
+
+#endif // ZIGBEE_FRAME_LEASES
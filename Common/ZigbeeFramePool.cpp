@@ -0,0 +1,140 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <string.h>
+
+#include "ZigbeeFramePool.h"
+#include "ZigbeeCommon.h"
+
+
+ZigbeeTxTemplate::ZigbeeTxTemplate()
+{
+	memset(m_header, 0, sizeof(m_header));
+	m_header[0] = ZIGBEE_START_DELIM;
+	m_header[3] = ZIGBEE_FT_TRANSMIT_REQUEST;
+
+	m_address = 1;
+	set(0, ZIGBEE_BROADCAST_ADDRESS);
+}
+
+// the frame length bytes are per message, the checksum doesn't cover them
+void ZigbeeTxTemplate::set(quint64 address, quint16 netAddress)
+{
+	if (address == m_address && netAddress == m_netAddress)
+		return;
+
+	m_address = address;
+	m_netAddress = netAddress;
+
+	for (int i = 0; i < 8; i++)
+		m_header[5 + i] = 0xff & (address >> (56 - 8 * i));
+
+	m_header[13] = 0xff & (netAddress >> 8);
+	m_header[14] = 0xff & netAddress;
+
+	m_sum = 0;
+
+	for (int i = 3; i < ZIGBEE_TX_HEADER_LEN; i++)
+		m_sum += 0xff & m_header[i];
+}
+
+ZigbeeFramePool::ZigbeeFramePool()
+{
+	m_hits = 0;
+	m_misses = 0;
+
+	for (int c = 0; c < ZIGBEE_FRAME_POOL_CLASSES; c++) {
+		m_buffers[c].resize(ZIGBEE_FRAME_POOL_BUFFERS);
+
+		for (int i = 0; i < ZIGBEE_FRAME_POOL_BUFFERS; i++)
+			m_buffers[c][i].reserve(ZIGBEE_FRAME_POOL_MIN_SIZE << c);
+
+		m_next[c] = 0;
+	}
+}
+
+// The whole frame in one pass, the header from the template and the data
+// copied straight in behind it while the checksum is summed.
+QByteArray ZigbeeFramePool::encodeTransmitRequest(const ZigbeeTxTemplate &tmpl, const char *data, int len)
+{
+	QByteArray spare;
+	int frameLen = ZIGBEE_TX_HEADER_LEN + len + 1;
+
+	QMutexLocker lock(&m_mutex);
+
+	QByteArray *frame = take(frameLen);
+
+	if (frame) {
+		m_hits++;
+	}
+	else {
+		spare.resize(frameLen);
+		frame = &spare;
+		m_misses++;
+	}
+
+	// only the pool has a reference, so this doesn't detach
+	char *p = frame->data();
+
+	memcpy(p, tmpl.m_header, ZIGBEE_TX_HEADER_LEN);
+	p[1] = 0xff & ((frameLen - 4) >> 8);
+	p[2] = 0xff & (frameLen - 4);
+
+	quint8 sum = tmpl.m_sum;
+	char *dst = p + ZIGBEE_TX_HEADER_LEN;
+
+	for (int i = 0; i < len; i++) {
+		dst[i] = data[i];
+		sum += 0xff & data[i];
+	}
+
+	dst[len] = 0xff - sum;
+
+	return *frame;
+}
+
+// A free buffer of the smallest class that fits, resized to len, NULL if
+// there isn't one. Call with m_mutex held.
+QByteArray *ZigbeeFramePool::take(int len)
+{
+	int c = 0;
+
+	while (c < ZIGBEE_FRAME_POOL_CLASSES && (ZIGBEE_FRAME_POOL_MIN_SIZE << c) < len)
+		c++;
+
+	if (c == ZIGBEE_FRAME_POOL_CLASSES)
+		return NULL;
+
+	QVector<QByteArray> &buffers = m_buffers[c];
+
+	// round robin, the next one is almost always free
+	for (int n = 0; n < ZIGBEE_FRAME_POOL_BUFFERS; n++) {
+		int i = m_next[c];
+
+		m_next[c] = (i + 1) % ZIGBEE_FRAME_POOL_BUFFERS;
+
+		if (buffers[i].isDetached()) {
+			buffers[i].resize(len);
+			return &buffers[i];
+		}
+	}
+
+	return NULL;
+}
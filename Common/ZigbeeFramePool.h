@@ -0,0 +1,83 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef ZIGBEE_FRAME_POOL_H
+#define ZIGBEE_FRAME_POOL_H
+
+#include <qbytearray.h>
+#include <qmutex.h>
+#include <qvector.h>
+
+// start delim through the options byte of a transmit request
+#define ZIGBEE_TX_HEADER_LEN 17
+
+// buffer sizes are powers of 2 from the smallest up
+#define ZIGBEE_FRAME_POOL_MIN_SIZE 32
+#define ZIGBEE_FRAME_POOL_CLASSES 4
+
+// buffers allocated up front in each size class
+#define ZIGBEE_FRAME_POOL_BUFFERS 64
+
+// The transmit request header for one destination, built once and copied
+// in front of each message with the checksum of its bytes already summed.
+// The frame id is left 0, the writer fills it in on the wire copy.
+class ZigbeeTxTemplate
+{
+public:
+	ZigbeeTxTemplate();
+
+	void set(quint64 address, quint16 netAddress);
+
+	quint64 m_address;
+	quint16 m_netAddress;
+	char m_header[ZIGBEE_TX_HEADER_LEN];
+	quint8 m_sum;
+};
+
+// Transmit request buffers that are used over and over instead of
+// allocated per message. A buffer is free again once the queue and the
+// frame lease have let go of their references to it, which implicit
+// sharing already tracks, so nothing has to hand buffers back.
+//
+// Frames go in the smallest class that holds them. A class is never
+// more than twice the frame, so resizing within it doesn't make
+// QByteArray give the space back. Anything bigger than the largest
+// class, or a class with every buffer in use, gets an ordinary one.
+//
+// Safe to call from any thread.
+class ZigbeeFramePool
+{
+public:
+	ZigbeeFramePool();
+
+	QByteArray encodeTransmitRequest(const ZigbeeTxTemplate &tmpl, const char *data, int len);
+
+	quint32 m_hits;
+	quint32 m_misses;
+
+private:
+	QByteArray *take(int len);
+
+	QMutex m_mutex;
+	QVector<QByteArray> m_buffers[ZIGBEE_FRAME_POOL_CLASSES];
+	int m_next[ZIGBEE_FRAME_POOL_CLASSES];
+};
+
+#endif // ZIGBEE_FRAME_POOL_H
@@ -0,0 +1,148 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <string.h>
+
+#include "ZigbeeIOSample.h"
+#include "ZigbeeUtils.h"
+
+ZigbeeIOSample::ZigbeeIOSample()
+{
+	clear();
+}
+
+void ZigbeeIOSample::clear()
+{
+	m_address = 0;
+	m_netAddress = 0;
+	m_receiveOptions = 0;
+	m_digitalMask = 0;
+	m_analogMask = 0;
+	m_digitalSamples = 0;
+	memset(m_analogSamples, 0, sizeof(m_analogSamples));
+}
+
+bool ZigbeeIOSample::hasDigital(int channel) const
+{
+	if (channel < 0 || channel >= 16)
+		return false;
+
+	return (m_digitalMask >> channel) & 0x01;
+}
+
+bool ZigbeeIOSample::digital(int channel) const
+{
+	if (!hasDigital(channel))
+		return false;
+
+	return (m_digitalSamples >> channel) & 0x01;
+}
+
+bool ZigbeeIOSample::hasAnalog(int channel) const
+{
+	if (channel < 0 || channel >= ZIGBEE_IO_ANALOG_CHANNELS)
+		return false;
+
+	return (m_analogMask >> channel) & 0x01;
+}
+
+quint16 ZigbeeIOSample::analog(int channel) const
+{
+	if (!hasAnalog(channel))
+		return 0;
+
+	return m_analogSamples[channel];
+}
+
+// The radio's sample block, the digital mask, the analog mask, then the
+// digital samples if any digital channels are enabled, then one sample
+// for each enabled analog channel in channel order.
+bool ZigbeeIOSample::parseSamples(const char *data, int len)
+{
+	if (len < 3)
+		return false;
+
+	m_digitalMask = getU16(data);
+	m_analogMask = 0xff & data[2];
+
+	int pos = 3;
+
+	if (m_digitalMask) {
+		if (len < pos + 2)
+			return false;
+
+		m_digitalSamples = getU16(data + pos);
+		pos += 2;
+	}
+	else {
+		m_digitalSamples = 0;
+	}
+
+	for (int i = 0; i < ZIGBEE_IO_ANALOG_CHANNELS; i++) {
+		if (!hasAnalog(i)) {
+			m_analogSamples[i] = 0;
+			continue;
+		}
+
+		if (len < pos + 2)
+			return false;
+
+		m_analogSamples[i] = getU16(data + pos);
+		pos += 2;
+	}
+
+	return true;
+}
+
+// The multicast record, the network address and receive options
+// followed by the sample block in the same compact form the radio
+// uses. The gateway puts the 64-bit address in front like every record.
+QByteArray ZigbeeIOSample::pack() const
+{
+	QByteArray data;
+
+	putU16(&data, m_netAddress);
+	data.append((char)m_receiveOptions);
+	putU16(&data, m_digitalMask);
+	data.append((char)m_analogMask);
+
+	if (m_digitalMask)
+		putU16(&data, m_digitalSamples);
+
+	for (int i = 0; i < ZIGBEE_IO_ANALOG_CHANNELS; i++) {
+		if (hasAnalog(i))
+			putU16(&data, m_analogSamples[i]);
+	}
+
+	return data;
+}
+
+bool ZigbeeIOSample::unpack(quint64 address, const QByteArray &data)
+{
+	clear();
+
+	if (data.length() < 3)
+		return false;
+
+	m_address = address;
+	m_netAddress = getU16(data, 0);
+	m_receiveOptions = 0xff & data.at(2);
+
+	return parseSamples(data.constData() + 3, data.length() - 3);
+}
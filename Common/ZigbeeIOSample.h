@@ -0,0 +1,58 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef ZIGBEE_IO_SAMPLE
+#define ZIGBEE_IO_SAMPLE
+
+#include <qbytearray.h>
+
+// analog mask bits 0-3 are AD0-AD3, bit 7 is the supply voltage
+#define ZIGBEE_IO_ANALOG_CHANNELS         8
+#define ZIGBEE_IO_SUPPLY_VOLTAGE          7
+
+// One set of IO samples taken by a radio running with IR set, from an
+// IO Data Sample Rx Indicator (0x92) frame. Only the channels that are
+// set in the masks have valid samples.
+class ZigbeeIOSample
+{
+public:
+	ZigbeeIOSample();
+
+	void clear();
+
+	bool hasDigital(int channel) const;
+	bool digital(int channel) const;
+	bool hasAnalog(int channel) const;
+	quint16 analog(int channel) const;
+
+	bool parseSamples(const char *data, int len);
+
+	QByteArray pack() const;
+	bool unpack(quint64 address, const QByteArray &data);
+
+	quint64 m_address;
+	quint16 m_netAddress;
+	quint8 m_receiveOptions;
+	quint16 m_digitalMask;
+	quint8 m_analogMask;
+	quint16 m_digitalSamples;
+	quint16 m_analogSamples[ZIGBEE_IO_ANALOG_CHANNELS];
+};
+
+#endif // ZIGBEE_IO_SAMPLE
@@ -0,0 +1,158 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <string.h>
+
+#include "ZigbeePerfStats.h"
+
+
+ZigbeeHistogram::ZigbeeHistogram()
+{
+	clear();
+}
+
+void ZigbeeHistogram::clear()
+{
+	memset(m_buckets, 0, sizeof(m_buckets));
+	m_count = 0;
+	m_total = 0;
+	m_max = 0;
+}
+
+void ZigbeeHistogram::record(quint32 usecs)
+{
+	int bucket = 0;
+
+#if defined(__GNUC__)
+	if (usecs)
+		bucket = 32 - __builtin_clz(usecs);
+#else
+	for (quint32 v = usecs; v; v >>= 1)
+		bucket++;
+#endif
+
+	if (bucket >= ZIGBEE_HISTOGRAM_BUCKETS)
+		bucket = ZIGBEE_HISTOGRAM_BUCKETS - 1;
+
+	m_buckets[bucket]++;
+	m_count++;
+	m_total += usecs;
+
+	if (usecs > m_max)
+		m_max = usecs;
+}
+
+quint32 ZigbeeHistogram::mean() const
+{
+	if (m_count == 0)
+		return 0;
+
+	return (quint32)(m_total / m_count);
+}
+
+// the upper bound of the bucket the percentile falls in, capped at
+// the largest value actually seen
+quint32 ZigbeeHistogram::percentile(int pct) const
+{
+	quint64 target = ((quint64)m_count * pct + 99) / 100;
+	quint64 sum = 0;
+
+	if (m_count == 0)
+		return 0;
+
+	for (int i = 0; i < ZIGBEE_HISTOGRAM_BUCKETS; i++) {
+		sum += m_buckets[i];
+
+		if (sum >= target) {
+			if (i == 0)
+				return 0;
+
+			quint32 bound = (1U << i) - 1;
+
+			return qMin(bound, m_max);
+		}
+	}
+
+	return m_max;
+}
+
+ZigbeePerfStats::ZigbeePerfStats()
+{
+	m_rxFrames = 0;
+	m_rxBytes = 0;
+	m_txFrames = 0;
+	m_txBytes = 0;
+	m_txWrites = 0;
+	m_txPartialWrites = 0;
+	m_txWriteMaxFrames = 0;
+	m_txWriteMaxBytes = 0;
+	m_rxChecksumErrors = 0;
+	m_rxResyncs = 0;
+	m_txLeasesLive = 0;
+	m_txLeaseTimeouts = 0;
+	m_txLeaseStalls = 0;
+	m_txLateResponses = 0;
+	m_txQueued = 0;
+	m_txBlocked = 0;
+	m_txCongested = 0;
+	m_txDropped = 0;
+
+	for (int i = 0; i < ZIGBEE_TX_CLASSES; i++) {
+		m_txClassQueued[i] = 0;
+		m_txClassDropped[i] = 0;
+	}
+
+	m_txRetries = 0;
+	m_txFailed = 0;
+	m_maxPayload = 0;
+	m_txFragments = 0;
+	m_rxReassembled = 0;
+	m_rxReassemblyTimeouts = 0;
+	m_rxReassemblyOverflows = 0;
+	m_rxBadFragments = 0;
+	m_txMacRetries = 0;
+	m_txRate = 0;
+	m_txRateIncreases = 0;
+	m_txRateDecreases = 0;
+	m_txPaceStalls = 0;
+	m_txWindowCuts = 0;
+	m_flowControl = false;
+	m_ctsStalls = 0;
+	m_ctsStallTime = 0;
+	m_addressCacheEntries = 0;
+	m_addressCacheHits = 0;
+	m_sourceRoutes = 0;
+	m_routeRecords = 0;
+	m_routeChanges = 0;
+	m_sourceRoutesSent = 0;
+	m_sourceRoutesExpired = 0;
+	m_atBatchesPending = 0;
+	m_atBatchesDone = 0;
+	m_atCommands = 0;
+	m_atTimeouts = 0;
+	m_framePoolHits = 0;
+	m_framePoolMisses = 0;
+	m_txBundles = 0;
+	m_txBundledMessages = 0;
+	m_rxFramesPerSec = 0;
+	m_rxBytesPerSec = 0;
+	m_txFramesPerSec = 0;
+	m_txBytesPerSec = 0;
+}
@@ -0,0 +1,168 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef ZIGBEE_PERF_STATS
+#define ZIGBEE_PERF_STATS
+
+#include <qglobal.h>
+#include <qmap.h>
+
+#include "ZigbeeCommon.h"
+
+// bucket 0 is 0 usecs, bucket n is [2^(n-1), 2^n) usecs, the last bucket
+// takes everything from about 4 seconds up
+#define ZIGBEE_HISTOGRAM_BUCKETS 24
+
+// A log2 latency histogram in microseconds. record() is a handful of
+// integer ops with no locking, each histogram has exactly one writing
+// thread and readers take a copy that may be off by a sample.
+class ZigbeeHistogram
+{
+public:
+	ZigbeeHistogram();
+
+	void clear();
+	void record(quint32 usecs);
+
+	quint32 mean() const;
+	quint32 percentile(int pct) const;
+
+	quint32 m_buckets[ZIGBEE_HISTOGRAM_BUCKETS];
+	quint32 m_count;
+	quint64 m_total;
+	quint32 m_max;
+};
+
+// A snapshot from ZigbeeController::perfStats(). The histograms are keyed
+// by frame type and only types that have been seen are present.
+class ZigbeePerfStats
+{
+public:
+	ZigbeePerfStats();
+
+	// bytes read to the handler returning, by received frame type
+	QMap<int, ZigbeeHistogram> m_rxLatency;
+
+	// queued to written to the port, by transmitted frame type
+	QMap<int, ZigbeeHistogram> m_txDwell;
+
+	// frame id leased to the matching status or response frame, by transmitted frame type
+	QMap<int, ZigbeeHistogram> m_txResponse;
+
+	quint64 m_rxFrames;
+	quint64 m_rxBytes;
+	quint64 m_txFrames;
+	quint64 m_txBytes;
+
+	// gathered writes to the port, ones the tty only took part of and the
+	// most frames and bytes that went in one
+	quint64 m_txWrites;
+	quint32 m_txPartialWrites;
+	quint32 m_txWriteMaxFrames;
+	quint32 m_txWriteMaxBytes;
+	quint32 m_rxChecksumErrors;
+	quint32 m_rxResyncs;
+
+	// frame ids in flight, leases that expired unanswered, times the
+	// writer had to wait for a free id and answers that came after
+	// their lease expired
+	int m_txLeasesLive;
+	quint32 m_txLeaseTimeouts;
+	quint32 m_txLeaseStalls;
+	quint32 m_txLateResponses;
+
+	// frames waiting to go out, destinations held up by a full window,
+	// destinations over the high watermark and the oldest frames dropped
+	// when a queue was full, in total and by ZIGBEE_TX_ priority class
+	int m_txQueued;
+	int m_txBlocked;
+	int m_txCongested;
+	quint32 m_txDropped;
+	int m_txClassQueued[ZIGBEE_TX_CLASSES];
+	quint32 m_txClassDropped[ZIGBEE_TX_CLASSES];
+
+	// transmit requests sent again and ones given up on
+	quint32 m_txRetries;
+	quint32 m_txFailed;
+
+	// the radio's NP, fragments sent, messages put back together and
+	// partial ones given up on for taking too long or not fitting
+	int m_maxPayload;
+	quint32 m_txFragments;
+	quint32 m_rxReassembled;
+	quint32 m_rxReassemblyTimeouts;
+	quint32 m_rxReassemblyOverflows;
+	quint32 m_rxBadFragments;
+
+	// MAC retries reported in transmit status frames, the current AIMD
+	// rate in frames/sec (0 when pacing is off), how often it went up or
+	// was cut, times the writer had to wait for it and destination
+	// windows cut for congestion
+	quint32 m_txMacRetries;
+	int m_txRate;
+	quint32 m_txRateIncreases;
+	quint32 m_txRateDecreases;
+	quint32 m_txPaceStalls;
+	quint32 m_txWindowCuts;
+
+	// RTS/CTS on, times the radio held writes off with CTS and the msecs
+	// it held them for
+	bool m_flowControl;
+	quint32 m_ctsStalls;
+	qint64 m_ctsStallTime;
+
+	// 16-bit addresses in the address cache and sends that used one
+	// instead of a network address discovery
+	int m_addressCacheEntries;
+	quint32 m_addressCacheHits;
+
+	// destinations with a source route, route record indicators seen and
+	// how many gave us a new or changed route, create source route frames
+	// sent and routes dropped after a delivery failure
+	int m_sourceRoutes;
+	quint32 m_routeRecords;
+	quint32 m_routeChanges;
+	quint32 m_sourceRoutesSent;
+	quint32 m_sourceRoutesExpired;
+
+	// AT batches still waiting on responses, batches finished, batch
+	// commands answered or timed out and the ones that timed out
+	int m_atBatchesPending;
+	quint32 m_atBatchesDone;
+	quint32 m_atCommands;
+	quint32 m_atTimeouts;
+
+	// transmit requests encoded into a reused pool buffer and ones that
+	// needed a new allocation
+	quint32 m_framePoolHits;
+	quint32 m_framePoolMisses;
+
+	// transmit requests sent as bundles and the messages that went in them
+	quint32 m_txBundles;
+	quint32 m_txBundledMessages;
+
+	// over the last full second
+	quint32 m_rxFramesPerSec;
+	quint32 m_rxBytesPerSec;
+	quint32 m_txFramesPerSec;
+	quint32 m_txBytesPerSec;
+};
+
+#endif // ZIGBEE_PERF_STATS
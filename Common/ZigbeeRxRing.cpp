@@ -0,0 +1,170 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <string.h>
+
+#include "ZigbeeRxRing.h"
+
+#define RING_MASK (ZIGBEE_RX_RING_SIZE - 1)
+
+
+ZigbeeRxRing::ZigbeeRxRing()
+{
+	m_buff = new char[ZIGBEE_RX_RING_SIZE];
+	m_readPos = 0;
+	m_writePos = 0;
+
+	// at most one mark per byte in the ring
+	m_marks = new quint32[ZIGBEE_RX_RING_SIZE];
+	m_markHead = 0;
+	m_markTail = 0;
+}
+
+ZigbeeRxRing::~ZigbeeRxRing()
+{
+	delete [] m_buff;
+	delete [] m_marks;
+}
+
+void ZigbeeRxRing::clear()
+{
+	m_readPos = 0;
+	m_writePos = 0;
+	m_markHead = 0;
+	m_markTail = 0;
+}
+
+// the cursors are free running, unsigned math handles the wrap
+int ZigbeeRxRing::count() const
+{
+	return (int)(m_writePos - m_readPos);
+}
+
+int ZigbeeRxRing::space() const
+{
+	return ZIGBEE_RX_RING_SIZE - count();
+}
+
+// returns where the next bytes go and how many fit before the
+// end of the buffer, call commitWrite() with what was really used
+char *ZigbeeRxRing::writePtr(int *len)
+{
+	quint32 pos = m_writePos & RING_MASK;
+	int contiguous = ZIGBEE_RX_RING_SIZE - pos;
+
+	*len = qMin(contiguous, space());
+
+	return m_buff + pos;
+}
+
+void ZigbeeRxRing::commitWrite(int len)
+{
+	m_writePos += qMin(len, space());
+}
+
+int ZigbeeRxRing::write(const char *data, int len)
+{
+	int chunk, total;
+
+	for (total = 0; total < len; total += chunk) {
+		char *p = writePtr(&chunk);
+
+		if (chunk == 0)
+			break;
+
+		chunk = qMin(chunk, len - total);
+		memcpy(p, data + total, chunk);
+		commitWrite(chunk);
+	}
+
+	return total;
+}
+
+quint8 ZigbeeRxRing::at(int offset) const
+{
+	return 0xff & m_buff[(m_readPos + offset) & RING_MASK];
+}
+
+int ZigbeeRxRing::indexOf(quint8 c, int from) const
+{
+	int len = count();
+
+	while (from < len) {
+		quint32 pos = (m_readPos + from) & RING_MASK;
+		int chunk = qMin(len - from, (int)(ZIGBEE_RX_RING_SIZE - pos));
+
+		const char *found = (const char *)memchr(m_buff + pos, c, chunk);
+
+		if (found)
+			return from + (int)(found - (m_buff + pos));
+
+		from += chunk;
+	}
+
+	return -1;
+}
+
+void ZigbeeRxRing::skip(int len)
+{
+	m_readPos += qMin(len, count());
+
+	// drop the marks we just skipped over
+	while (m_markHead != m_markTail && (qint32)(m_marks[m_markHead & RING_MASK] - m_readPos) < 0)
+		m_markHead++;
+}
+
+// A pointer to len bytes starting at the read cursor. Only a frame that
+// straddles the end of the buffer gets copied, into the caller's scratch.
+const char *ZigbeeRxRing::linear(int len, char *scratch) const
+{
+	quint32 pos = m_readPos & RING_MASK;
+	int contiguous = ZIGBEE_RX_RING_SIZE - pos;
+
+	if (len <= contiguous)
+		return m_buff + pos;
+
+	memcpy(scratch, m_buff + pos, contiguous);
+	memcpy(scratch + contiguous, m_buff, len - contiguous);
+
+	return scratch;
+}
+
+// call before writing the delimiter byte itself
+void ZigbeeRxRing::markFrameStart()
+{
+	if (space() == 0)
+		return;
+
+	m_marks[m_markTail & RING_MASK] = m_writePos;
+	m_markTail++;
+}
+
+// offset from the read cursor of the first marked frame start at or
+// after from, -1 if there isn't one
+int ZigbeeRxRing::nextFrameStart(int from) const
+{
+	for (quint32 i = m_markHead; i != m_markTail; i++) {
+		int offset = (int)(m_marks[i & RING_MASK] - m_readPos);
+
+		if (offset >= from)
+			return offset;
+	}
+
+	return -1;
+}
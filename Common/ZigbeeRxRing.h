@@ -0,0 +1,68 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef ZIGBEE_RX_RING
+#define ZIGBEE_RX_RING
+
+#include <qglobal.h>
+
+// must be a power of 2
+#define ZIGBEE_RX_RING_SIZE 4096
+
+// The serial receive buffer. The read and write cursors only ever move
+// forward and are masked into the buffer, so consuming a frame is just
+// a cursor update and nothing ever gets moved around.
+//
+// With escaped framing a 0x7E can show up in unescaped frame data, so
+// the places where a raw delimiter arrived are marked as they are
+// written and resync uses those instead of searching for 0x7E.
+class ZigbeeRxRing
+{
+public:
+	ZigbeeRxRing();
+	~ZigbeeRxRing();
+
+	void clear();
+	int count() const;
+	int space() const;
+
+	char *writePtr(int *len);
+	void commitWrite(int len);
+	int write(const char *data, int len);
+
+	quint8 at(int offset) const;
+	int indexOf(quint8 c, int from = 0) const;
+	void skip(int len);
+	const char *linear(int len, char *scratch) const;
+
+	void markFrameStart();
+	int nextFrameStart(int from) const;
+
+private:
+	char *m_buff;
+	quint32 m_readPos;
+	quint32 m_writePos;
+
+	// write positions of known frame starts, oldest first
+	quint32 *m_marks;
+	quint32 m_markHead;
+	quint32 m_markTail;
+};
+
+#endif // ZIGBEE_RX_RING
@@ -0,0 +1,147 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "ZigbeeSourceRoutes.h"
+#include "ZigbeeCommon.h"
+#include "ZigbeeUtils.h"
+
+
+ZigbeeSourceRoutes::ZigbeeSourceRoutes()
+{
+	clear();
+}
+
+void ZigbeeSourceRoutes::clear()
+{
+	m_routes.clear();
+	m_records = 0;
+	m_changes = 0;
+	m_expired = 0;
+}
+
+// From a route record indicator. Returns true if the route is new or
+// different from the one we had, the radio's copy is stale then. A node
+// that is our neighbor needs no source route, so an empty hop list just
+// drops whatever we had.
+bool ZigbeeSourceRoutes::update(quint64 address, quint16 netAddress, const QVector<quint16> &hops, qint64 now)
+{
+	m_records++;
+
+	if (hops.count() == 0 || hops.count() > ZIGBEE_MAX_SOURCE_ROUTE_HOPS
+			|| netAddress == ZIGBEE_BROADCAST_ADDRESS)
+		return m_routes.remove(address) > 0;
+
+	QHash<quint64, ZigbeeSourceRoute>::iterator it = m_routes.find(address);
+
+	if (it != m_routes.end()) {
+		it.value().m_learned = now;
+
+		if (it.value().m_netAddress == netAddress && it.value().m_hops == hops)
+			return false;
+
+		it.value().m_netAddress = netAddress;
+		it.value().m_hops = hops;
+		m_changes++;
+
+		return true;
+	}
+
+	// a linear scan, but only when a new node shows up in a full table
+	if (m_routes.count() >= ZIGBEE_MAX_SOURCE_ROUTES) {
+		QHash<quint64, ZigbeeSourceRoute>::iterator oldest = m_routes.begin();
+
+		for (it = m_routes.begin(); it != m_routes.end(); ++it) {
+			if (it.value().m_learned < oldest.value().m_learned)
+				oldest = it;
+		}
+
+		m_routes.erase(oldest);
+	}
+
+	ZigbeeSourceRoute route;
+
+	route.m_netAddress = netAddress;
+	route.m_hops = hops;
+	route.m_learned = now;
+
+	m_routes.insert(address, route);
+	m_changes++;
+
+	return true;
+}
+
+bool ZigbeeSourceRoutes::lookup(quint64 address, ZigbeeSourceRoute *route) const
+{
+	QHash<quint64, ZigbeeSourceRoute>::const_iterator it = m_routes.constFind(address);
+
+	if (it == m_routes.constEnd())
+		return false;
+
+	if (route)
+		*route = it.value();
+
+	return true;
+}
+
+// after a delivery failure, true if there was a route to drop
+bool ZigbeeSourceRoutes::invalidate(quint64 address)
+{
+	if (m_routes.remove(address) == 0)
+		return false;
+
+	m_expired++;
+
+	return true;
+}
+
+int ZigbeeSourceRoutes::count() const
+{
+	return m_routes.count();
+}
+
+// A complete 0x21 frame. The frame id has to be 0, the radio never
+// answers a create source route.
+QByteArray ZigbeeSourceRoutes::buildCreateSourceRoute(quint64 address, const ZigbeeSourceRoute &route)
+{
+	QByteArray packet;
+	int len = 14 + 2 * route.m_hops.count();
+
+	packet.reserve(len + 4);
+	packet.append(ZIGBEE_START_DELIM);
+	putU16(&packet, len);
+	packet.append(ZIGBEE_FT_CREATE_SOURCE_ROUTE);
+	packet.append((char)0x00); // frame id
+	putU64(&packet, address);
+	putU16(&packet, route.m_netAddress);
+	packet.append((char)0x00); // route command options
+	packet.append((char)route.m_hops.count());
+
+	for (int i = 0; i < route.m_hops.count(); i++)
+		putU16(&packet, route.m_hops.at(i));
+
+	quint8 sum = 0;
+
+	for (int i = 3; i < packet.length(); i++)
+		sum += 0xff & packet.at(i);
+
+	packet.append((char)(0xff - sum));
+
+	return packet;
+}
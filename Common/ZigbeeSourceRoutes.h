@@ -0,0 +1,79 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef ZIGBEE_SOURCE_ROUTES_H
+#define ZIGBEE_SOURCE_ROUTES_H
+
+#include <qbytearray.h>
+#include <qhash.h>
+#include <qvector.h>
+
+// intermediate hops a create source route frame can carry
+#define ZIGBEE_MAX_SOURCE_ROUTE_HOPS 40
+
+// destinations we keep routes for, the oldest goes when a new one won't fit
+#define ZIGBEE_MAX_SOURCE_ROUTES 1024
+
+// The path a route record indicator reported from a remote node to us.
+// The hops are the 16-bit addresses of the routers in between, neighbor
+// of the remote first. That is also the order a create source route
+// frame wants them in, so they go back out as they came in. m_learned
+// is msecs on the controller's clock.
+class ZigbeeSourceRoute
+{
+public:
+	ZigbeeSourceRoute() : m_netAddress(0xFFFE), m_learned(0) {}
+
+	quint16 m_netAddress;
+	QVector<quint16> m_hops;
+	qint64 m_learned;
+};
+
+// Source routes by 64-bit destination, learned from route record
+// indicators when the local radio is a many-to-one concentrator. The
+// radio only holds one source route at a time, so the controller sends
+// a create source route frame ahead of data whenever the destination
+// changes. A route is dropped as soon as a delivery over it fails and
+// the radio falls back to its own route discovery until a new record
+// comes in.
+//
+// Not thread safe, the controller holds m_txMutex around every call.
+class ZigbeeSourceRoutes
+{
+public:
+	ZigbeeSourceRoutes();
+
+	void clear();
+	bool update(quint64 address, quint16 netAddress, const QVector<quint16> &hops, qint64 now);
+	bool lookup(quint64 address, ZigbeeSourceRoute *route) const;
+	bool invalidate(quint64 address);
+	int count() const;
+
+	static QByteArray buildCreateSourceRoute(quint64 address, const ZigbeeSourceRoute &route);
+
+	quint32 m_records;
+	quint32 m_changes;
+	quint32 m_expired;
+
+private:
+	QHash<quint64, ZigbeeSourceRoute> m_routes;
+};
+
+#endif // ZIGBEE_SOURCE_ROUTES_H
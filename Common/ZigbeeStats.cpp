@@ -27,6 +27,8 @@ ZigbeeStats::ZigbeeStats()
 	m_lastFrameID = 0;
 	m_txCount = 0;
 	m_rxCount = 0;
+	m_txMacRetries = 0;
+	m_txFailures = 0;
 	m_lastDeliveryStatus = 0;
 	m_lastDiscoveryStatus = 0;
 	m_lastReceiveOptions = 0;
@@ -45,6 +47,8 @@ ZigbeeStats::ZigbeeStats(quint64 address, quint8 frameID, quint16 netAddress, qu
 	m_lastFrameID = frameID;
 	m_txCount = 0;
 	m_rxCount = 0;
+	m_txMacRetries = 0;
+	m_txFailures = 0;
 	m_lastDeliveryStatus = 0;
 	m_lastDiscoveryStatus = 0;
 	m_lastReceiveOptions = 0;
@@ -69,6 +73,8 @@ ZigbeeStats& ZigbeeStats::operator=(const ZigbeeStats &rhs)
 		m_lastFrameID = rhs.m_lastFrameID;
 		m_txCount = rhs.m_txCount;
 		m_rxCount = rhs.m_rxCount;
+		m_txMacRetries = rhs.m_txMacRetries;
+		m_txFailures = rhs.m_txFailures;
 		m_lastDeliveryStatus = rhs.m_lastDeliveryStatus;
 		m_lastDiscoveryStatus = rhs.m_lastDiscoveryStatus;
 		m_lastReceiveOptions = rhs.m_lastReceiveOptions;
@@ -92,6 +98,8 @@ void ZigbeeStats::clear()
 	m_lastFrameID = 0;
 	m_txCount = 0;
 	m_rxCount = 0;
+	m_txMacRetries = 0;
+	m_txFailures = 0;
 	m_lastDeliveryStatus = 0;
 	m_lastDiscoveryStatus = 0;
 	m_lastReceiveOptions = 0;
@@ -44,6 +44,8 @@ public:
 	quint8 m_lastFrameID;
 	quint32 m_txCount;
 	quint32 m_rxCount;
+	quint32 m_txMacRetries;
+	quint32 m_txFailures;
 	quint8 m_lastDeliveryStatus;
 	quint8 m_lastDiscoveryStatus;
 	quint8 m_lastReceiveOptions;
@@ -0,0 +1,73 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef ZIGBEE_TX_FRAME
+#define ZIGBEE_TX_FRAME
+
+#include <qbytearray.h>
+
+#include "ZigbeeCommon.h"
+
+// A complete API frame waiting in the controller's tx queue. The queued
+// time is in nsecs from the controller's clock. The frame id in m_data
+// stays 0, the id leased when the frame is written only goes in the copy
+// on the wire, so the bytes can be shared with the frame pool and the
+// lease without being copied. The address is the destination that lease
+// is for, 0 for the local radio. A retransmit waits until m_due, msecs on
+// the same clock. The priority is one of the ZIGBEE_TX_ classes. An AT
+// command from a ZigbeeATBatch carries the batch id and its index there,
+// the batch id is 0 for anything else.
+class ZigbeeTxFrame
+{
+public:
+	ZigbeeTxFrame() : m_queued(0), m_address(0), m_priority(ZIGBEE_TX_CONTROL), m_attempts(0), m_due(0),
+		m_batchID(0), m_batchIndex(0) {}
+	ZigbeeTxFrame(const QByteArray &data, qint64 queued, quint64 address = 0, int priority = ZIGBEE_TX_CONTROL)
+		: m_data(data), m_queued(queued), m_address(address), m_priority(priority), m_attempts(0), m_due(0),
+		m_batchID(0), m_batchIndex(0) {}
+
+	quint8 frameType() const { return m_data.length() > 3 ? 0xff & m_data.at(3) : 0; }
+	// the 16-bit destination of a transmit request
+	void setNetAddress(quint16 netAddress) {
+		setByte(13, netAddress >> 8);
+		setByte(14, netAddress & 0xff);
+	}
+
+	// the checksum moves by the same amount the byte does
+	void setByte(int pos, quint8 value) {
+		if (pos < 3 || pos >= m_data.length() - 1)
+			return;
+
+		quint8 old = 0xff & m_data.at(pos);
+		m_data[pos] = (char)value;
+		m_data[m_data.length() - 1] = (char)((0xff & m_data.at(m_data.length() - 1)) - (value - old));
+	}
+
+	QByteArray m_data;
+	qint64 m_queued;
+	quint64 m_address;
+	int m_priority;
+	int m_attempts;
+	qint64 m_due;
+	quint32 m_batchID;
+	int m_batchIndex;
+};
+
+#endif // ZIGBEE_TX_FRAME
@@ -0,0 +1,101 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "ZigbeeTxPacer.h"
+
+#define NSECS_PER_SEC 1000000000LL
+#define NSECS_PER_MSEC 1000000LL
+
+
+ZigbeeTxPacer::ZigbeeTxPacer()
+{
+	m_minRate = ZIGBEE_DEFAULT_TX_RATE_MIN;
+	m_maxRate = ZIGBEE_DEFAULT_TX_RATE_MAX;
+
+	reset();
+}
+
+void ZigbeeTxPacer::configure(int minRate, int maxRate)
+{
+	m_maxRate = maxRate < 0 ? 0 : maxRate;
+	m_minRate = qBound(1, minRate, m_maxRate > 0 ? m_maxRate : 1);
+
+	reset();
+}
+
+void ZigbeeTxPacer::reset()
+{
+	m_rate = m_maxRate;
+	m_lastSend = -1;
+	m_lastDecrease = -1;
+	m_increases = 0;
+	m_decreases = 0;
+	m_stalls = 0;
+}
+
+bool ZigbeeTxPacer::enabled() const
+{
+	return m_maxRate > 0;
+}
+
+int ZigbeeTxPacer::rate() const
+{
+	return m_rate;
+}
+
+// when the next transmit request may go
+qint64 ZigbeeTxPacer::nextSend() const
+{
+	if (!enabled() || m_lastSend < 0)
+		return 0;
+
+	return m_lastSend + NSECS_PER_SEC / m_rate;
+}
+
+bool ZigbeeTxPacer::canSend(qint64 now) const
+{
+	return now >= nextSend();
+}
+
+void ZigbeeTxPacer::sent(qint64 now)
+{
+	m_lastSend = now;
+}
+
+void ZigbeeTxPacer::success()
+{
+	if (!enabled() || m_rate >= m_maxRate)
+		return;
+
+	m_rate = qMin(m_rate + ZIGBEE_TX_RATE_INCREASE, m_maxRate);
+	m_increases++;
+}
+
+void ZigbeeTxPacer::congestion(qint64 now)
+{
+	if (!enabled())
+		return;
+
+	if (m_lastDecrease >= 0 && now - m_lastDecrease < ZIGBEE_TX_DECREASE_HOLDOFF * NSECS_PER_MSEC)
+		return;
+
+	m_rate = qMax(m_rate / 2, m_minRate);
+	m_lastDecrease = now;
+	m_decreases++;
+}
@@ -0,0 +1,74 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef ZIGBEE_TX_PACER
+#define ZIGBEE_TX_PACER
+
+#include <qglobal.h>
+
+// transmit requests per second, a max of 0 turns pacing off
+#define ZIGBEE_DEFAULT_TX_RATE_MAX 100
+#define ZIGBEE_DEFAULT_TX_RATE_MIN 5
+
+// frames/sec added for each clean transmit status
+#define ZIGBEE_TX_RATE_INCREASE 1
+
+// a status with this many MAC retries means the air is busy
+#define ZIGBEE_TX_CONGESTED_RETRIES 2
+
+// msecs after a cut before another one, so one bad patch halves the
+// rate once instead of once per frame that was already in the air
+#define ZIGBEE_TX_DECREASE_HOLDOFF 250
+
+// AIMD pacing of the transmit requests the controller writes. The rate
+// starts at the max, goes up by ZIGBEE_TX_RATE_INCREASE for each clean
+// delivery and is halved, down to the min, when the mesh shows signs
+// of congestion. Times are nsecs on the controller's clock.
+//
+// Not thread safe, the controller holds m_txMutex around every call.
+class ZigbeeTxPacer
+{
+public:
+	ZigbeeTxPacer();
+
+	void configure(int minRate, int maxRate);
+	void reset();
+	bool enabled() const;
+	int rate() const;
+
+	qint64 nextSend() const;
+	bool canSend(qint64 now) const;
+	void sent(qint64 now);
+
+	void success();
+	void congestion(qint64 now);
+
+	quint32 m_increases;
+	quint32 m_decreases;
+	quint32 m_stalls;
+
+private:
+	int m_minRate;
+	int m_maxRate;
+	int m_rate;
+	qint64 m_lastSend;
+	qint64 m_lastDecrease;
+};
+
+#endif // ZIGBEE_TX_PACER
@@ -0,0 +1,435 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "ZigbeeTxScheduler.h"
+
+
+ZigbeeTxDestination::ZigbeeTxDestination()
+{
+	m_inFlight = 0;
+	m_limit = 0;
+	m_acks = 0;
+	m_congested = false;
+
+	for (int i = 0; i < ZIGBEE_TX_CLASSES; i++)
+		m_ready[i] = false;
+}
+
+int ZigbeeTxDestination::queuedData() const
+{
+	return m_queue[ZIGBEE_TX_INTERACTIVE].count() + m_queue[ZIGBEE_TX_BULK].count();
+}
+
+ZigbeeTxScheduler::ZigbeeTxScheduler()
+{
+	m_window = ZIGBEE_DEFAULT_TX_WINDOW;
+	m_windowCuts = 0;
+	m_highWater = ZIGBEE_DEFAULT_TX_HIGH_WATER;
+	m_lowWater = ZIGBEE_DEFAULT_TX_LOW_WATER;
+
+	m_depth[ZIGBEE_TX_CONTROL] = ZIGBEE_TX_CONTROL_DEPTH;
+	m_depth[ZIGBEE_TX_INTERACTIVE] = ZIGBEE_TX_INTERACTIVE_DEPTH;
+	m_depth[ZIGBEE_TX_BULK] = ZIGBEE_TX_BULK_DEPTH;
+
+	for (int i = 0; i < ZIGBEE_TX_CLASSES; i++)
+		m_dropped[i] = 0;
+
+	clear();
+}
+
+void ZigbeeTxScheduler::clear()
+{
+	m_control.clear();
+	m_destinations.clear();
+
+	for (int i = 0; i < ZIGBEE_TX_CLASSES; i++) {
+		m_ready[i].clear();
+		m_queued[i] = 0;
+	}
+
+	m_interactiveRun = 0;
+	m_windowCuts = 0;
+	m_watermarkEvents.clear();
+}
+
+// only while nothing is in flight
+void ZigbeeTxScheduler::setWindow(int window)
+{
+	m_window = window < 1 ? 1 : window;
+}
+
+int ZigbeeTxScheduler::window() const
+{
+	return m_window;
+}
+
+int ZigbeeTxScheduler::depth(int txClass) const
+{
+	if (txClass < ZIGBEE_TX_CONTROL || txClass > ZIGBEE_TX_BULK)
+		return 0;
+
+	return m_depth[txClass];
+}
+
+void ZigbeeTxScheduler::setWatermarks(int high, int low)
+{
+	m_highWater = high < 1 ? 1 : high;
+	m_lowWater = qBound(0, low, m_highWater - 1);
+}
+
+void ZigbeeTxScheduler::checkWatermarks(quint64 address, ZigbeeTxDestination &dest)
+{
+	int count = dest.queuedData();
+
+	if (!dest.m_congested && count >= m_highWater) {
+		dest.m_congested = true;
+		m_watermarkEvents.append(ZigbeeTxWatermark(address, true));
+	}
+	else if (dest.m_congested && count <= m_lowWater) {
+		dest.m_congested = false;
+		m_watermarkEvents.append(ZigbeeTxWatermark(address, false));
+	}
+}
+
+bool ZigbeeTxScheduler::hasWatermarkEvents() const
+{
+	return !m_watermarkEvents.isEmpty();
+}
+
+QList<ZigbeeTxWatermark> ZigbeeTxScheduler::takeWatermarkEvents()
+{
+	QList<ZigbeeTxWatermark> events = m_watermarkEvents;
+
+	m_watermarkEvents.clear();
+
+	return events;
+}
+
+int ZigbeeTxScheduler::frameClass(const ZigbeeTxFrame &txFrame) const
+{
+	if (txFrame.m_priority < ZIGBEE_TX_CONTROL || txFrame.m_priority > ZIGBEE_TX_BULK)
+		return ZIGBEE_TX_INTERACTIVE;
+
+	return txFrame.m_priority;
+}
+
+// Returns the number of older frames dropped to make room. For data that
+// is only ever the same destination's frames. AT batch commands are never
+// dropped, the batch would wait forever on their responses. There are
+// never more than the controller's batch window of them queued.
+int ZigbeeTxScheduler::enqueue(const ZigbeeTxFrame &txFrame)
+{
+	int txClass = frameClass(txFrame);
+	int dropped = 0;
+
+	if (txClass == ZIGBEE_TX_CONTROL) {
+		for (int i = 0; i < m_control.count() && m_control.count() >= m_depth[txClass]; ) {
+			if (m_control.at(i).m_batchID != 0) {
+				i++;
+				continue;
+			}
+
+			m_control.removeAt(i);
+			m_queued[txClass]--;
+			dropped++;
+		}
+
+		m_control.enqueue(txFrame);
+	}
+	else {
+		ZigbeeTxDestination &dest = m_destinations[txFrame.m_address];
+
+		while (dest.m_queue[txClass].count() >= m_depth[txClass]) {
+			dest.m_queue[txClass].dequeue();
+			m_queued[txClass]--;
+			dropped++;
+		}
+
+		dest.m_queue[txClass].enqueue(txFrame);
+		makeReady(txFrame.m_address, dest);
+		checkWatermarks(txFrame.m_address, dest);
+	}
+
+	m_queued[txClass]++;
+	m_dropped[txClass] += dropped;
+
+	return dropped;
+}
+
+int ZigbeeTxScheduler::windowFor(const ZigbeeTxDestination &dest) const
+{
+	if (dest.m_limit > 0 && dest.m_limit < m_window)
+		return dest.m_limit;
+
+	return m_window;
+}
+
+// Feedback from a transmit status, call before complete(). Halve the
+// window on congestion, after a full window of clean deliveries add one.
+void ZigbeeTxScheduler::adjustWindow(quint64 address, bool congested)
+{
+	QHash<quint64, ZigbeeTxDestination>::iterator it = m_destinations.find(address);
+
+	if (it == m_destinations.end())
+		return;
+
+	ZigbeeTxDestination &dest = it.value();
+	int window = windowFor(dest);
+
+	if (congested) {
+		dest.m_limit = qMax(1, window / 2);
+		dest.m_acks = 0;
+
+		if (dest.m_limit < window)
+			m_windowCuts++;
+
+		return;
+	}
+
+	if (window >= m_window)
+		return;
+
+	if (++dest.m_acks >= window) {
+		dest.m_limit = window + 1;
+		dest.m_acks = 0;
+		makeReady(address, dest);
+	}
+}
+
+// put the destination in line for each class it has frames and room for
+void ZigbeeTxScheduler::makeReady(quint64 address, ZigbeeTxDestination &dest)
+{
+	if (dest.m_inFlight >= windowFor(dest))
+		return;
+
+	for (int i = ZIGBEE_TX_INTERACTIVE; i <= ZIGBEE_TX_BULK; i++) {
+		if (!dest.m_ready[i] && !dest.m_queue[i].isEmpty()) {
+			m_ready[i].enqueue(address);
+			dest.m_ready[i] = true;
+		}
+	}
+}
+
+// true if a destination can send in txClass, dropping stale entries
+bool ZigbeeTxScheduler::readyHead(int txClass)
+{
+	while (!m_ready[txClass].isEmpty()) {
+		QHash<quint64, ZigbeeTxDestination>::iterator it = m_destinations.find(m_ready[txClass].head());
+
+		if (it != m_destinations.end()) {
+			ZigbeeTxDestination &dest = it.value();
+
+			if (!dest.m_queue[txClass].isEmpty() && dest.m_inFlight < windowFor(dest))
+				return true;
+
+			dest.m_ready[txClass] = false;
+		}
+
+		m_ready[txClass].dequeue();
+	}
+
+	return false;
+}
+
+// the class head() and dequeue() take from, -1 if nothing can go
+int ZigbeeTxScheduler::nextClass()
+{
+	if (!m_control.isEmpty())
+		return ZIGBEE_TX_CONTROL;
+
+	bool interactive = readyHead(ZIGBEE_TX_INTERACTIVE);
+	bool bulk = readyHead(ZIGBEE_TX_BULK);
+
+	if (interactive && bulk && m_interactiveRun >= ZIGBEE_TX_BULK_WEIGHT)
+		return ZIGBEE_TX_BULK;
+
+	if (interactive)
+		return ZIGBEE_TX_INTERACTIVE;
+
+	if (bulk)
+		return ZIGBEE_TX_BULK;
+
+	return -1;
+}
+
+// true when nothing can be sent right now, there may still be frames
+// queued behind full windows
+bool ZigbeeTxScheduler::isEmpty()
+{
+	return nextClass() < 0;
+}
+
+// call only when !isEmpty()
+const ZigbeeTxFrame &ZigbeeTxScheduler::head()
+{
+	int txClass = nextClass();
+
+	if (txClass == ZIGBEE_TX_CONTROL)
+		return m_control.head();
+
+	return m_destinations[m_ready[txClass].head()].m_queue[txClass].head();
+}
+
+// Takes head() off and counts it against its destination's window. The
+// destination goes to the back of the line if it can send again.
+ZigbeeTxFrame ZigbeeTxScheduler::dequeue()
+{
+	int txClass = nextClass();
+
+	m_queued[txClass]--;
+
+	if (txClass == ZIGBEE_TX_CONTROL)
+		return m_control.dequeue();
+
+	if (txClass == ZIGBEE_TX_INTERACTIVE)
+		m_interactiveRun++;
+	else
+		m_interactiveRun = 0;
+
+	quint64 address = m_ready[txClass].dequeue();
+	ZigbeeTxDestination &dest = m_destinations[address];
+
+	dest.m_ready[txClass] = false;
+
+	ZigbeeTxFrame txFrame = dest.m_queue[txClass].dequeue();
+	dest.m_inFlight++;
+
+	makeReady(address, dest);
+	checkWatermarks(address, dest);
+
+	return txFrame;
+}
+
+// A transmit request to address got its status or its frame id lease
+// expired, either way it is no longer in flight.
+void ZigbeeTxScheduler::complete(quint64 address)
+{
+	QHash<quint64, ZigbeeTxDestination>::iterator it = m_destinations.find(address);
+
+	if (it == m_destinations.end() || it.value().m_inFlight == 0)
+		return;
+
+	ZigbeeTxDestination &dest = it.value();
+
+	dest.m_inFlight--;
+
+	makeReady(address, dest);
+
+	// nothing left that refers to it. A cut window is kept until it has
+	// grown back, or the next burst would start at the full window again.
+	if (dest.m_inFlight == 0 && !dest.m_ready[ZIGBEE_TX_INTERACTIVE] && !dest.m_ready[ZIGBEE_TX_BULK]
+			&& dest.m_queue[ZIGBEE_TX_INTERACTIVE].isEmpty() && dest.m_queue[ZIGBEE_TX_BULK].isEmpty()
+			&& windowFor(dest) >= m_window)
+		m_destinations.erase(it);
+}
+
+// A transmit request that failed goes back to the front of its queue for
+// another try. Its window slot was held through the backoff and is given
+// back here, so later frames for the destination stay behind it.
+void ZigbeeTxScheduler::requeue(const ZigbeeTxFrame &txFrame)
+{
+	int txClass = frameClass(txFrame);
+
+	if (txClass == ZIGBEE_TX_CONTROL) {
+		m_control.prepend(txFrame);
+		m_queued[txClass]++;
+		return;
+	}
+
+	ZigbeeTxDestination &dest = m_destinations[txFrame.m_address];
+
+	if (dest.m_inFlight > 0)
+		dest.m_inFlight--;
+
+	dest.m_queue[txClass].prepend(txFrame);
+	m_queued[txClass]++;
+
+	makeReady(txFrame.m_address, dest);
+	checkWatermarks(txFrame.m_address, dest);
+}
+
+int ZigbeeTxScheduler::queued() const
+{
+	int count = 0;
+
+	for (int i = 0; i < ZIGBEE_TX_CLASSES; i++)
+		count += m_queued[i];
+
+	return count;
+}
+
+int ZigbeeTxScheduler::queued(int txClass) const
+{
+	return m_queued[txClass];
+}
+
+// data frames queued for one destination
+int ZigbeeTxScheduler::queued(quint64 address) const
+{
+	QHash<quint64, ZigbeeTxDestination>::const_iterator it = m_destinations.constFind(address);
+
+	if (it == m_destinations.constEnd())
+		return 0;
+
+	return it.value().queuedData();
+}
+
+quint32 ZigbeeTxScheduler::dropped(int txClass) const
+{
+	return m_dropped[txClass];
+}
+
+// destinations with frames waiting on a full window
+int ZigbeeTxScheduler::blocked() const
+{
+	int count = 0;
+
+	QHash<quint64, ZigbeeTxDestination>::const_iterator it;
+
+	for (it = m_destinations.constBegin(); it != m_destinations.constEnd(); ++it) {
+		const ZigbeeTxDestination &dest = it.value();
+
+		if (dest.m_inFlight < windowFor(dest))
+			continue;
+
+		if (!dest.m_queue[ZIGBEE_TX_INTERACTIVE].isEmpty() || !dest.m_queue[ZIGBEE_TX_BULK].isEmpty())
+			count++;
+	}
+
+	return count;
+}
+
+quint32 ZigbeeTxScheduler::windowCuts() const
+{
+	return m_windowCuts;
+}
+
+int ZigbeeTxScheduler::congested() const
+{
+	int count = 0;
+
+	QHash<quint64, ZigbeeTxDestination>::const_iterator it;
+
+	for (it = m_destinations.constBegin(); it != m_destinations.constEnd(); ++it) {
+		if (it.value().m_congested)
+			count++;
+	}
+
+	return count;
+}
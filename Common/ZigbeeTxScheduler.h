@@ -0,0 +1,144 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef ZIGBEE_TX_SCHEDULER
+#define ZIGBEE_TX_SCHEDULER
+
+#include <qqueue.h>
+#include <qhash.h>
+#include <qlist.h>
+#include <qpair.h>
+
+#include "ZigbeeTxFrame.h"
+
+#define ZIGBEE_DEFAULT_TX_WINDOW 2
+
+// queue depths, the data classes are per destination
+#define ZIGBEE_TX_CONTROL_DEPTH 32
+#define ZIGBEE_TX_INTERACTIVE_DEPTH 50
+#define ZIGBEE_TX_BULK_DEPTH 200
+
+// interactive frames sent in a row before a waiting bulk frame gets a turn
+#define ZIGBEE_TX_BULK_WEIGHT 4
+
+// queued data frames at which a destination is reported congested and
+// at which it is clear again
+#define ZIGBEE_DEFAULT_TX_HIGH_WATER 40
+#define ZIGBEE_DEFAULT_TX_LOW_WATER 10
+
+// a destination that crossed a watermark, true when it went over the high one
+typedef QPair<quint64, bool> ZigbeeTxWatermark;
+
+// Transmit requests for one 64-bit address, a queue for each data class
+// sharing the one window. m_limit is the window as cut back by
+// congestion, 0 until the first cut, and m_acks the clean deliveries
+// towards opening it up again.
+class ZigbeeTxDestination
+{
+public:
+	ZigbeeTxDestination();
+
+	QQueue<ZigbeeTxFrame> m_queue[ZIGBEE_TX_CLASSES];
+	bool m_ready[ZIGBEE_TX_CLASSES];
+	int m_inFlight;
+	int m_limit;
+	int m_acks;
+	bool m_congested;
+
+	int queuedData() const;
+};
+
+// The controller's tx queue, in three priority classes.
+//
+// Control frames, the AT commands, go in one queue that is always served
+// first. Interactive and bulk data queue per destination and class, and
+// each destination may only have window frames waiting on a transmit
+// status, so a slow or missing node holds up its own traffic and nobody
+// else's. Within a class destinations with room take turns. Interactive
+// goes ahead of bulk, but bulk gets one frame in every
+// ZIGBEE_TX_BULK_WEIGHT + 1 so it is never starved. A full queue drops
+// its oldest frame, other than AT batch commands.
+//
+// A destination's window is halved when its deliveries show congestion
+// and opens up by one again after a window's worth of clean ones.
+//
+// A destination whose queued data reaches the high watermark is reported
+// congested, and clear again once it drains to the low one, so the
+// senders can back off before anything has to be dropped. The crossings
+// are collected for the controller to take and signal.
+//
+// Not thread safe, the controller holds m_txMutex around every call.
+class ZigbeeTxScheduler
+{
+public:
+	ZigbeeTxScheduler();
+
+	void clear();
+	void setWindow(int window);
+	int window() const;
+	int depth(int txClass) const;
+	void setWatermarks(int high, int low);
+
+	int enqueue(const ZigbeeTxFrame &txFrame);
+	bool isEmpty();
+	const ZigbeeTxFrame &head();
+	ZigbeeTxFrame dequeue();
+	void complete(quint64 address);
+	void adjustWindow(quint64 address, bool congested);
+	void requeue(const ZigbeeTxFrame &txFrame);
+
+	int queued() const;
+	int queued(int txClass) const;
+	int queued(quint64 address) const;
+	quint32 dropped(int txClass) const;
+	int blocked() const;
+	int congested() const;
+	quint32 windowCuts() const;
+
+	bool hasWatermarkEvents() const;
+	QList<ZigbeeTxWatermark> takeWatermarkEvents();
+
+private:
+	int nextClass();
+	bool readyHead(int txClass);
+	void makeReady(quint64 address, ZigbeeTxDestination &dest);
+	int frameClass(const ZigbeeTxFrame &txFrame) const;
+	void checkWatermarks(quint64 address, ZigbeeTxDestination &dest);
+	int windowFor(const ZigbeeTxDestination &dest) const;
+
+	int m_window;
+	quint32 m_windowCuts;
+	int m_depth[ZIGBEE_TX_CLASSES];
+	int m_queued[ZIGBEE_TX_CLASSES];
+	quint32 m_dropped[ZIGBEE_TX_CLASSES];
+	int m_interactiveRun;
+	int m_highWater;
+	int m_lowWater;
+	QList<ZigbeeTxWatermark> m_watermarkEvents;
+
+	QQueue<ZigbeeTxFrame> m_control;
+	QHash<quint64, ZigbeeTxDestination> m_destinations;
+
+	// destinations with frames queued in a class and room in their window,
+	// in turn. An entry can go stale when the window fills from another
+	// class, those are dropped as they come to the head.
+	QQueue<quint64> m_ready[ZIGBEE_TX_CLASSES];
+};
+
+#endif // ZIGBEE_TX_SCHEDULER
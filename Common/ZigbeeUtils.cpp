@@ -19,11 +19,16 @@
 
 #include "ZigbeeUtils.h"
 
-quint16 getU16(QByteArray data, int start)
+quint16 getU16(const QByteArray &data, int start)
 {
-	quint16 val = 0xff & data.at(start);
+	return getU16(data.constData() + start);
+}
+
+quint16 getU16(const char *data)
+{
+	quint16 val = 0xff & data[0];
 	val <<= 8;
-	val += 0xff & data.at(start + 1);
+	val += 0xff & data[1];
 
 	return val;
 }
@@ -40,13 +45,18 @@ void putU16(QByteArray *data, quint16 val, int pos)
 	}
 }
 
-quint32 getU32(QByteArray data, int start)
+quint32 getU32(const QByteArray &data, int start)
 {
-	quint32	val = 0xff & data.at(start);
+	return getU32(data.constData() + start);
+}
 
-	for (int i = start + 1; i < start + 4; i++) {
+quint32 getU32(const char *data)
+{
+	quint32	val = 0xff & data[0];
+
+	for (int i = 1; i < 4; i++) {
 		val <<= 8;
-		val += 0xff & data.at(i);
+		val += 0xff & data[i];
 	}
 
 	return val;
@@ -68,13 +78,18 @@ void putU32(QByteArray *data, quint32 val, int pos)
 	}
 }
 
-quint64 getU64(QByteArray data, int start)
+quint64 getU64(const QByteArray &data, int start)
+{
+	return getU64(data.constData() + start);
+}
+
+quint64 getU64(const char *data)
 {
-	quint64	val = 0xff & data.at(start);
+	quint64	val = 0xff & data[0];
 
-	for (int i = start + 1; i < start + 8; i++) {
+	for (int i = 1; i < 8; i++) {
 		val <<= 8;
-		val += 0xff & data.at(i);
+		val += 0xff & data[i];
 	}
 
 	return val;
@@ -22,13 +22,16 @@
 
 #include <qbytearray.h>
 
-quint16 getU16(QByteArray data, int start);
+quint16 getU16(const QByteArray &data, int start);
+quint16 getU16(const char *data);
 void putU16(QByteArray *data, quint16 val, int pos = -1);
 
-quint32 getU32(QByteArray data, int start);
+quint32 getU32(const QByteArray &data, int start);
+quint32 getU32(const char *data);
 void putU32(QByteArray *data, quint32 val, int pos = -1);
 
-quint64 getU64(QByteArray data, int start);
+quint64 getU64(const QByteArray &data, int start);
+quint64 getU64(const char *data);
 void putU64(QByteArray *data, quint64 val, int pos = -1);
 
 #endif // ZIGBEE_UTILS
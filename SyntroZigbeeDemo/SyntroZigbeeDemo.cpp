@@ -44,6 +44,9 @@ SyntroZigbeeDemo::SyntroZigbeeDemo(QSettings *settings, QWidget *parent, Qt::WFl
 	connect(m_client, SIGNAL(receiveRadioList(QList<ZigbeeStats>)),
 			this, SLOT(receiveRadioList(QList<ZigbeeStats>)), Qt::DirectConnection);
 
+	connect(m_client, SIGNAL(receiveNodeUpdate(ZigbeeStats)),
+			this, SLOT(receiveNodeUpdate(ZigbeeStats)), Qt::DirectConnection);
+
 	m_client->resumeThread();
 
 	m_refreshTimer = startTimer(100);
@@ -137,6 +140,15 @@ void SyntroZigbeeDemo::receiveRadioList(QList<ZigbeeStats> list)
 	m_newRadioList = true;
 }
 
+void SyntroZigbeeDemo::receiveNodeUpdate(ZigbeeStats zb)
+{
+	QMutexLocker lock(&m_radioListMutex);
+
+	m_radioList.insert(zb.m_address, zb);
+
+	m_newRadioList = true;
+}
+
 void SyntroZigbeeDemo::receiveData(quint64 address, QByteArray data)
 {
 	QMutexLocker lock(&m_rxQMutex);
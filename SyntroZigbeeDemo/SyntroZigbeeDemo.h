@@ -45,6 +45,7 @@ public slots:
 	void onClear();
 	void receiveData(quint64 address, QByteArray data);
 	void receiveRadioList(QList<ZigbeeStats>);
+	void receiveNodeUpdate(ZigbeeStats);
 
 protected:
 	void closeEvent(QCloseEvent *);
@@ -2,12 +2,14 @@ HEADERS += SyntroZigbeeDemo.h \
     ../Common/ZigbeeCommon.h \
     ../Common/ZigbeeUtils.h \
     ../Common/ZigbeeStats.h \
+    ../Common/ZigbeeIOSample.h \
     ../Common/ZigbeeClient.h
 
 SOURCES += main.cpp \
     SyntroZigbeeDemo.cpp \
     ../Common/ZigbeeUtils.cpp \
     ../Common/ZigbeeStats.cpp \
+    ../Common/ZigbeeIOSample.cpp \
     ../Common/ZigbeeClient.cpp
 
 
@@ -126,8 +126,11 @@ void SyntroZigbeeGateway::onConnect()
 				connect(m_controller, SIGNAL(receiveData(quint64, QByteArray)),
 					m_client, SLOT(receiveData(quint64, QByteArray)), Qt::DirectConnection);
 
-				connect(m_client, SIGNAL(sendData(quint64,QByteArray)),
-					m_controller, SLOT(sendData(quint64,QByteArray)), Qt::DirectConnection);
+				connect(m_controller, SIGNAL(receiveIOSample(ZigbeeIOSample)),
+					m_client, SLOT(receiveIOSample(ZigbeeIOSample)), Qt::DirectConnection);
+
+				connect(m_client, SIGNAL(sendData(quint64,QByteArray,int)),
+					m_controller, SLOT(sendData(quint64,QByteArray,int)), Qt::DirectConnection);
 
 				connect(m_controller, SIGNAL(localRadioAddress(quint64)), 
 					m_client, SLOT(localRadioAddress(quint64)));
@@ -137,6 +140,18 @@ void SyntroZigbeeGateway::onConnect()
 
 				connect(m_controller, SIGNAL(nodeDiscoverResponse(QList<ZigbeeStats>)),
 					m_client, SLOT(nodeDiscoverResponse(QList<ZigbeeStats>)), Qt::DirectConnection);
+
+				connect(m_controller, SIGNAL(nodeUpdate(ZigbeeStats)),
+					m_client, SLOT(nodeUpdate(ZigbeeStats)), Qt::DirectConnection);
+
+				connect(m_controller, SIGNAL(deliveryReport(quint64, int, int)),
+					m_client, SLOT(deliveryReport(quint64, int, int)), Qt::DirectConnection);
+
+				connect(m_controller, SIGNAL(txCongestion(quint64, bool)),
+					m_client, SLOT(txCongestion(quint64, bool)), Qt::DirectConnection);
+
+				connect(m_controller, SIGNAL(txDropped(quint64, int)),
+					m_client, SLOT(txDropped(quint64, int)), Qt::DirectConnection);
 			}
 
 			connect(m_controller, SIGNAL(localRadioAddress(quint64)), 
@@ -148,6 +163,9 @@ void SyntroZigbeeGateway::onConnect()
 			connect(m_controller, SIGNAL(nodeDiscoverResponse(QList<ZigbeeStats>)),
 					this, SLOT(nodeDiscoverResponse(QList<ZigbeeStats>)), Qt::DirectConnection);
 
+			connect(m_controller, SIGNAL(nodeUpdate(ZigbeeStats)),
+					this, SLOT(nodeUpdate(ZigbeeStats)), Qt::DirectConnection);
+
 			connect(this, SIGNAL(requestNodeIDChange(quint64, QString)),
 				m_controller, SLOT(requestNodeIDChange(quint64, QString)));
 
@@ -182,8 +200,11 @@ void SyntroZigbeeGateway::onDisconnect()
 			disconnect(m_controller, SIGNAL(receiveData(quint64, QByteArray)),
 				m_client, SLOT(receiveData(quint64, QByteArray)));
 
-			disconnect(m_client, SIGNAL(sendData(quint64,QByteArray)),
-				m_controller, SLOT(sendData(quint64,QByteArray)));
+			disconnect(m_controller, SIGNAL(receiveIOSample(ZigbeeIOSample)),
+				m_client, SLOT(receiveIOSample(ZigbeeIOSample)));
+
+			disconnect(m_client, SIGNAL(sendData(quint64,QByteArray,int)),
+				m_controller, SLOT(sendData(quint64,QByteArray,int)));
 
 			disconnect(m_controller, SIGNAL(localRadioAddress(quint64)), 
 				m_client, SLOT(localRadioAddress(quint64)));
@@ -193,7 +214,22 @@ void SyntroZigbeeGateway::onDisconnect()
 
 			disconnect(m_controller, SIGNAL(nodeDiscoverResponse(QList<ZigbeeStats>)),
 				m_client, SLOT(nodeDiscoverResponse(QList<ZigbeeStats>)));
+
+			disconnect(m_controller, SIGNAL(nodeUpdate(ZigbeeStats)),
+				m_client, SLOT(nodeUpdate(ZigbeeStats)));
+
+			disconnect(m_controller, SIGNAL(deliveryReport(quint64, int, int)),
+				m_client, SLOT(deliveryReport(quint64, int, int)));
+
+			disconnect(m_controller, SIGNAL(txCongestion(quint64, bool)),
+				m_client, SLOT(txCongestion(quint64, bool)));
+
+			disconnect(m_controller, SIGNAL(txDropped(quint64, int)),
+				m_client, SLOT(txDropped(quint64, int)));
 		}
+
+		// the controller's queues go with it, nothing is congested now
+		m_client->txReset();
 	}
 
 	if (m_controller) {
@@ -206,6 +242,9 @@ void SyntroZigbeeGateway::onDisconnect()
 		disconnect(m_controller, SIGNAL(nodeDiscoverResponse(QList<ZigbeeStats>)),
 				this, SLOT(nodeDiscoverResponse(QList<ZigbeeStats>)));
 
+		disconnect(m_controller, SIGNAL(nodeUpdate(ZigbeeStats)),
+				this, SLOT(nodeUpdate(ZigbeeStats)));
+
 		disconnect(this, SIGNAL(requestNodeIDChange(quint64, QString)),
 			m_controller, SLOT(requestNodeIDChange(quint64, QString)));
 
@@ -227,18 +266,23 @@ void SyntroZigbeeGateway::localRadioAddress(quint64 address)
 
 void SyntroZigbeeGateway::nodeDiscoverResponse(QList<ZigbeeStats> list)
 {
-	ZigbeeStats zb;
+	for (int i = 0; i < list.count(); i++)
+		checkNodeID(list.at(i));
+}
 
-	for (int i = 0; i < list.count(); i++) {
-		zb = list.at(i);
+void SyntroZigbeeGateway::nodeUpdate(ZigbeeStats zb)
+{
+	checkNodeID(zb);
+}
 
-		if (m_nodeIDs.contains(zb.m_address)) {
-			if (m_nodeIDs[zb.m_address] != zb.m_nodeID)
-				emit requestNodeIDChange(zb.m_address, m_nodeIDs[zb.m_address]);
-		}
-		else if (zb.m_nodeID.length() > 0) {
-			m_nodeIDs.insert(zb.m_address, zb.m_nodeID);
-		}
+void SyntroZigbeeGateway::checkNodeID(const ZigbeeStats &zb)
+{
+	if (m_nodeIDs.contains(zb.m_address)) {
+		if (m_nodeIDs[zb.m_address] != zb.m_nodeID)
+			emit requestNodeIDChange(zb.m_address, m_nodeIDs[zb.m_address]);
+	}
+	else if (zb.m_nodeID.length() > 0) {
+		m_nodeIDs.insert(zb.m_address, zb.m_nodeID);
 	}
 }
 
@@ -47,6 +47,7 @@ public slots:
 	void onConfigure();
 	void localRadioAddress(quint64 address);
 	void nodeDiscoverResponse(QList<ZigbeeStats>);
+	void nodeUpdate(ZigbeeStats);
 
 signals:
 	void requestNodeDiscover();
@@ -61,6 +62,7 @@ private:
 	void populateRow(int row, ZigbeeStats *stat);
 	void loadLocalAddress();
 	void loadNodeIDList();
+	void checkNodeID(const ZigbeeStats &zb);
 	void initStatusBar();
 	void initStatTable();
 	void updateStatusBar();
@@ -23,13 +23,15 @@ ZigbeeData::ZigbeeData()
 {
 	m_address = 0;
 	m_expireTime = 0;
+	m_subType = 0;
 }
 
-ZigbeeData::ZigbeeData(quint64 address, qint64 expireTime, QByteArray data)
+ZigbeeData::ZigbeeData(quint64 address, qint64 expireTime, QByteArray data, int subType)
 {
 	m_address = address;
 	m_expireTime = expireTime;
 	m_data = data;
+	m_subType = subType;
 }
 
 ZigbeeData::ZigbeeData(const ZigbeeData &rhs)
@@ -43,6 +45,7 @@ ZigbeeData& ZigbeeData::operator=(const ZigbeeData &rhs)
 		m_address = rhs.m_address;
 		m_expireTime = rhs.m_expireTime;
 		m_data = rhs.m_data;
+		m_subType = rhs.m_subType;
 	}
 
 	return *this;
@@ -26,7 +26,7 @@ class ZigbeeData
 {
 public:
 	ZigbeeData();
-	ZigbeeData(quint64 address, qint64 expireTime, QByteArray data);
+	ZigbeeData(quint64 address, qint64 expireTime, QByteArray data, int subType = 0);
 	ZigbeeData(const ZigbeeData &rhs);
 	
 	ZigbeeData& operator=(const ZigbeeData &rhs);
@@ -36,6 +36,7 @@ public:
 	quint64 m_address;
 	qint64 m_expireTime;
 	QByteArray m_data;
+	int m_subType;
 };
 
 
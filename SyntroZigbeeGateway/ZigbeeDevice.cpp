@@ -24,14 +24,19 @@ ZigbeeDevice::ZigbeeDevice()
 	clear();
 }
 
-ZigbeeDevice::ZigbeeDevice(quint64 address, bool readOnly, int pollInterval)
+ZigbeeDevice::ZigbeeDevice(quint64 address, bool readOnly, int pollInterval, int txPriority)
 {
 	m_address = address;
 	m_readOnly = readOnly;
 	m_pollInterval = pollInterval;
+	m_txPriority = txPriority;
 
 	if (m_pollInterval < 0)
 		m_pollInterval = 0;
+
+	// control is for the controller's own AT commands
+	if (m_txPriority != ZIGBEE_TX_BULK)
+		m_txPriority = ZIGBEE_TX_INTERACTIVE;
 }
 
 ZigbeeDevice::ZigbeeDevice(const ZigbeeDevice &rhs)
@@ -45,6 +50,7 @@ ZigbeeDevice& ZigbeeDevice::operator=(const ZigbeeDevice &rhs)
 		m_address = rhs.m_address;
 		m_readOnly = rhs.m_readOnly;
 		m_pollInterval = rhs.m_pollInterval;
+		m_txPriority = rhs.m_txPriority;
 	}
 
 	return *this;
@@ -55,4 +61,5 @@ void ZigbeeDevice::clear()
 	m_address = 0;
 	m_readOnly = false;
 	m_pollInterval = 0;
+	m_txPriority = ZIGBEE_TX_INTERACTIVE;
 }
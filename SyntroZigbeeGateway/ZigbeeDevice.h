@@ -22,10 +22,12 @@
 
 #include <qglobal.h>
 
+#include "ZigbeeCommon.h"
+
 class ZigbeeDevice {
 public:
 	ZigbeeDevice();
-	ZigbeeDevice(quint64 address, bool readOnly, int pollInterval);
+	ZigbeeDevice(quint64 address, bool readOnly, int pollInterval, int txPriority = ZIGBEE_TX_INTERACTIVE);
 	ZigbeeDevice(const ZigbeeDevice &rhs);
 	
 	ZigbeeDevice& operator=(const ZigbeeDevice &rhs);
@@ -35,6 +37,7 @@ public:
 	quint64 m_address;
 	bool m_readOnly;
 	int m_pollInterval;
+	int m_txPriority;
 };
 
 #endif // ZIGBEE_DEVICE_H
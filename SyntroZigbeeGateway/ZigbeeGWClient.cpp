@@ -104,8 +104,9 @@ void ZigbeeGWClient::appClientInit()
 
 		bool readOnly = m_settings->value(ZIGBEE_READONLY, false).toBool();
 		int pollInterval = m_settings->value(ZIGBEE_POLLINTERVAL, 0).toInt();
+		int txPriority = m_settings->value(ZIGBEE_TXPRIORITY, ZIGBEE_TX_INTERACTIVE).toInt();
 
-		zb = new ZigbeeDevice(address, readOnly, pollInterval);
+		zb = new ZigbeeDevice(address, readOnly, pollInterval, txPriority);
 
 		if (!zb) {
 			logWarn("Error allocating new ZigbeeDevice");
@@ -135,6 +136,8 @@ void ZigbeeGWClient::appClientBackground()
 
 	issuePollRequests();
 
+	sendClearNotices();
+
 	sendReceivedData();
 }
 
@@ -207,11 +210,139 @@ void ZigbeeGWClient::appClientReceiveE2E(int servicePort, SYNTRO_EHEAD *header,
 		}
 	}
 
-	emit sendData(address, QByteArray((const char *)(p + 8), length - 8));
+	int dropped;
+
+	// the radio isn't keeping up with this destination, refuse rather
+	// than queue more and have the controller drop it
+	if (destinationBusy(address, &dropped)) {
+		sendTxNotice(&header->sourceUID, convertUC2ToInt(header->sourcePort), address, true, dropped);
+		addBusySender(address, header);
+		free(header);
+		return;
+	}
+
+	// No copy here, the controller encodes straight from the E2E message.
+	// That is only safe because the connection is direct and the slot has
+	// copied whatever it keeps by the time we free the header.
+	emit sendData(address, QByteArray::fromRawData((const char *)(p + 8), length - 8), zb->m_txPriority);
+
+	// a direct connection, so anything this pushed out is counted by now.
+	// Only a busy destination gets a clear notice later, a drop alone is
+	// reported as it happens.
+	bool busy = destinationBusy(address, &dropped);
+
+	if (busy || dropped > 0)
+		sendTxNotice(&header->sourceUID, convertUC2ToInt(header->sourcePort), address, busy, dropped);
+
+	if (busy)
+		addBusySender(address, header);
 
 	free(header);
 }
 
+// also takes the count of frames dropped for address since the last call
+bool ZigbeeGWClient::destinationBusy(quint64 address, int *dropped)
+{
+	QMutexLocker lock(&m_txMutex);
+
+	*dropped = m_txDropped.take(address);
+
+	return m_busyDestinations.contains(address);
+}
+
+void ZigbeeGWClient::addBusySender(quint64 address, SYNTRO_EHEAD *header)
+{
+	ZIGBEE_E2E_SENDER sender;
+
+	sender.uid = header->sourceUID;
+	sender.port = convertUC2ToInt(header->sourcePort);
+
+	QList<ZIGBEE_E2E_SENDER> &senders = m_busySenders[address];
+
+	for (int i = 0; i < senders.count(); i++) {
+		if (senders.at(i).port == sender.port && !memcmp(&senders.at(i).uid, &sender.uid, sizeof(SYNTRO_UID)))
+			return;
+	}
+
+	senders.append(sender);
+}
+
+// The reply mirrors what a client sends, the gateway's address 0 and then
+// a ZIGBEE_GATEWAY_RESPONSE with a single ZIGBEE_TX_NOTICE record.
+void ZigbeeGWClient::sendTxNotice(SYNTRO_UID *uid, int port, quint64 address, bool busy, int dropped)
+{
+	QByteArray data;
+
+	putU64(&data, 0);
+	putU16(&data, ZIGBEE_GATEWAY_TX_NOTICE);
+	putU16(&data, 1);
+	putU64(&data, address);
+	data.append((char)(busy ? ZIGBEE_TX_NOTICE_BUSY : ZIGBEE_TX_NOTICE_CLEAR));
+	putU16(&data, qMin(dropped, 0xffff));
+
+	SYNTRO_EHEAD *reply = clientBuildLocalE2EMessage(m_e2ePort, uid, port, data.length());
+
+	if (!reply)
+		return;
+
+	memcpy(reply + 1, data.constData(), data.length());
+
+	clientSendMessage(m_e2ePort, reply, data.length(), SYNTROLINK_MEDPRI);
+}
+
+// tell everyone who was turned away that a destination has drained
+void ZigbeeGWClient::sendClearNotices()
+{
+	m_txMutex.lock();
+	QList<quint64> cleared = m_clearedDestinations;
+	m_clearedDestinations.clear();
+	m_txMutex.unlock();
+
+	for (int i = 0; i < cleared.count(); i++) {
+		QList<ZIGBEE_E2E_SENDER> senders = m_busySenders.take(cleared.at(i));
+
+		for (int j = 0; j < senders.count(); j++)
+			sendTxNotice(&senders[j].uid, senders.at(j).port, cleared.at(i), false, 0);
+	}
+}
+
+void ZigbeeGWClient::txCongestion(quint64 address, bool congested)
+{
+	QMutexLocker lock(&m_txMutex);
+
+	if (congested) {
+		m_busyDestinations.insert(address);
+		m_clearedDestinations.removeAll(address);
+	}
+	else if (m_busyDestinations.remove(address)) {
+		m_clearedDestinations.append(address);
+	}
+}
+
+void ZigbeeGWClient::txDropped(quint64 address, int count)
+{
+	QMutexLocker lock(&m_txMutex);
+
+	m_txDropped[address] += count;
+}
+
+// The controller went away with its queues and won't report the busy
+// destinations clear, so do it here. The senders that were turned away
+// get their clear notices from the background as usual.
+void ZigbeeGWClient::txReset()
+{
+	QMutexLocker lock(&m_txMutex);
+	QSet<quint64>::const_iterator it;
+
+	for (it = m_busyDestinations.constBegin(); it != m_busyDestinations.constEnd(); ++it) {
+		if (!m_clearedDestinations.contains(*it))
+			m_clearedDestinations.append(*it);
+	}
+
+	m_busyDestinations.clear();
+	m_txDropped.clear();
+}
+
 void ZigbeeGWClient::issuePollRequests()
 {
 	// TODO
@@ -235,7 +366,7 @@ void ZigbeeGWClient::sendReceivedData()
 
 	convertIntToUC2(ZIGBEE_DATA_TYPE, head->type);
 	convertIntToUC2(sizeof(SYNTRO_RECORD_HEADER), head->headerLength);
-	convertIntToUC2(0, head->subType);
+	convertIntToUC2(zbData.m_subType, head->subType);
 	convertIntToUC2(0, head->param);
 	setSyntroTimestamp(&head->timestamp);
 
@@ -261,25 +392,49 @@ bool ZigbeeGWClient::getRxData(ZigbeeData *zbData)
 	return true;
 }
 
-void ZigbeeGWClient::receiveData(quint64 address, QByteArray data)
+void ZigbeeGWClient::receiveData(quint64 address, const QByteArray &data)
+{
+	QMutexLocker lock(&m_rxMutex);
+
+	if (!rxDeviceAllowed(address))
+		return;
+
+	while (m_rxQ.size() > MAX_RX_QUEUE_SIZE)
+		m_rxQ.removeFirst();
+
+	m_rxQ.enqueue(ZigbeeData(address, (1000 * m_rxQExpireSecs) + SyntroClock(), data));
+}
+
+// published with their own subType so clients don't mistake them for data
+void ZigbeeGWClient::receiveIOSample(const ZigbeeIOSample &sample)
 {
 	QMutexLocker lock(&m_rxMutex);
 
-	if (m_devices.contains(address) || m_promiscuousMode) {
-		while (m_rxQ.size() > MAX_RX_QUEUE_SIZE)
-			m_rxQ.removeFirst();
+	if (!rxDeviceAllowed(sample.m_address))
+		return;
+
+	while (m_rxQ.size() > MAX_RX_QUEUE_SIZE)
+		m_rxQ.removeFirst();
 
-		m_rxQ.enqueue(ZigbeeData(address, (1000 * m_rxQExpireSecs) + SyntroClock(), data));
+	m_rxQ.enqueue(ZigbeeData(sample.m_address, (1000 * m_rxQExpireSecs) + SyntroClock(),
+		sample.pack(), ZIGBEE_RECORD_IO_SAMPLE));
+}
+
+// call with m_rxMutex held
+bool ZigbeeGWClient::rxDeviceAllowed(quint64 address)
+{
+	if (m_devices.contains(address) || m_promiscuousMode)
+		return true;
+
+	if (m_badRxDevices.contains(address)) {
+		m_badRxDevices[address]++;
 	}
 	else {
-		if (m_badRxDevices.contains(address)) {
-			m_badRxDevices[address]++;
-		}
-		else {
-			m_badRxDevices.insert(address, 1);
-			logWarn(QString("Rejected data received from unauthorized device 0x%1").arg(address, 16, 16, QChar('0')));
-		}
+		m_badRxDevices.insert(address, 1);
+		logWarn(QString("Rejected data received from unauthorized device 0x%1").arg(address, 16, 16, QChar('0')));
 	}
+
+	return false;
 }
 
 // we only support one command right now, node discovery 'ND'
@@ -293,6 +448,50 @@ void ZigbeeGWClient::executeLocalRadioCommand(quint8 *request, int length)
 }
 
 void ZigbeeGWClient::nodeDiscoverResponse(QList<ZigbeeStats> list)
+{
+	QByteArray data = packNodeList(ZIGBEE_AT_CMD_ND, list);
+
+	// add to the multicast rx queue
+	m_rxMutex.lock();
+	m_rxQ.enqueue(ZigbeeData(0, SyntroClock(), data));
+	m_rxMutex.unlock();
+}
+
+// a single node joined or changed, clients merge it into their lists
+void ZigbeeGWClient::nodeUpdate(ZigbeeStats zb)
+{
+	QList<ZigbeeStats> list;
+
+	list.append(zb);
+
+	QByteArray data = packNodeList(ZIGBEE_GATEWAY_NODE_UPDATE, list);
+
+	m_rxMutex.lock();
+	m_rxQ.enqueue(ZigbeeData(0, SyntroClock(), data));
+	m_rxMutex.unlock();
+}
+
+// Only failures are published, a sender that hears nothing can assume its
+// data was delivered. Successes would double the multicast traffic.
+void ZigbeeGWClient::deliveryReport(quint64 address, int status, int attempts)
+{
+	QByteArray data;
+
+	if (status == ZIGBEE_DELIVERY_SUCCESS)
+		return;
+
+	putU16(&data, ZIGBEE_GATEWAY_DELIVERY_REPORT);
+	putU16(&data, 1);
+	putU64(&data, address);
+	data.append((char)status);
+	data.append((char)qMin(attempts, 255));
+
+	m_rxMutex.lock();
+	m_rxQ.enqueue(ZigbeeData(0, SyntroClock(), data));
+	m_rxMutex.unlock();
+}
+
+QByteArray ZigbeeGWClient::packNodeList(quint16 cmd, const QList<ZigbeeStats> &list)
 {
 	QByteArray data;
 	int i, j, len;
@@ -300,7 +499,7 @@ void ZigbeeGWClient::nodeDiscoverResponse(QList<ZigbeeStats> list)
 	int recCount = list.count();
 
 	// pack the ZIGBEE_GATEWAY_RESPONSE	header
-	putU16(&data, ZIGBEE_AT_CMD_ND);
+	putU16(&data, cmd);
 	putU16(&data, recCount);
 
 	// pack the ZIGBEE_NODE_DATA records
@@ -327,10 +526,7 @@ void ZigbeeGWClient::nodeDiscoverResponse(QList<ZigbeeStats> list)
 			data.append((char)0x00);
 	}
 
-	// add to the multicast rx queue
-	m_rxMutex.lock();
-	m_rxQ.enqueue(ZigbeeData(0, SyntroClock(), data));
-	m_rxMutex.unlock();
+	return data;
 }
 
 void ZigbeeGWClient::purgeExpiredQueueData()
@@ -22,12 +22,21 @@
 
 #include <qlist.h>
 #include <qqueue.h>
+#include <qset.h>
 
 #include "SyntroLib.h"
 #include "ZigbeeDevice.h"
 #include "ZigbeeCommon.h"
 #include "ZigbeeStats.h"
 #include "ZigbeeData.h"
+#include "ZigbeeIOSample.h"
+
+// where to send a clear notice once a busy destination drains
+typedef struct
+{
+	SYNTRO_UID uid;
+	int port;
+} ZIGBEE_E2E_SENDER;
 
 class ZigbeeGWClient : public Endpoint
 {
@@ -37,12 +46,18 @@ public:
 	ZigbeeGWClient(QObject *parent, QSettings *settings);
 
 public slots:
-	void receiveData(quint64 address, QByteArray data);
+	void receiveData(quint64 address, const QByteArray &data);
+	void receiveIOSample(const ZigbeeIOSample &sample);
 	void localRadioAddress(quint64 address);	
 	void nodeDiscoverResponse(QList<ZigbeeStats>);
+	void nodeUpdate(ZigbeeStats);
+	void deliveryReport(quint64 address, int status, int attempts);
+	void txCongestion(quint64 address, bool congested);
+	void txDropped(quint64 address, int count);
+	void txReset();
 
 signals:
-	void sendData(quint64 address, QByteArray data);
+	void sendData(quint64 address, QByteArray data, int priority);
 	void requestNodeDiscover();
 
 protected:
@@ -56,6 +71,12 @@ private:
 	bool getRxData(ZigbeeData *zbData);
 	void executeLocalRadioCommand(quint8 *request, int length);
 	void purgeExpiredQueueData();
+	bool rxDeviceAllowed(quint64 address);
+	QByteArray packNodeList(quint16 cmd, const QList<ZigbeeStats> &list);
+	bool destinationBusy(quint64 address, int *dropped);
+	void addBusySender(quint64 address, SYNTRO_EHEAD *header);
+	void sendTxNotice(SYNTRO_UID *uid, int port, quint64 address, bool busy, int dropped);
+	void sendClearNotices();
 
 	int m_multicastPort;
 	int m_e2ePort;
@@ -70,6 +91,16 @@ private:
 
 	QMap<quint64, int> m_badRxDevices;
 	QMap<quint64, int> m_badTxDevices;
+
+	// congestion state from the controller, m_txMutex because that comes
+	// in on the controller's threads
+	QMutex m_txMutex;
+	QSet<quint64> m_busyDestinations;
+	QMap<quint64, int> m_txDropped;
+	QList<quint64> m_clearedDestinations;
+
+	// only touched from the client thread
+	QMap<quint64, QList<ZIGBEE_E2E_SENDER> > m_busySenders;
 };
 
 #endif // ZIGBEECLIENT_H
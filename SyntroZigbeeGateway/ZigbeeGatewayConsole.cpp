@@ -48,8 +48,11 @@ ZigbeeGatewayConsole::ZigbeeGatewayConsole(QSettings *settings, QObject *parent)
 			connect(m_controller, SIGNAL(receiveData(quint64, QByteArray)),
 				m_client, SLOT(receiveData(quint64, QByteArray)), Qt::DirectConnection);
 
-			connect(m_client, SIGNAL(sendData(quint64,QByteArray)),
-				m_controller, SLOT(sendData(quint64,QByteArray)), Qt::DirectConnection);
+			connect(m_controller, SIGNAL(receiveIOSample(ZigbeeIOSample)),
+				m_client, SLOT(receiveIOSample(ZigbeeIOSample)), Qt::DirectConnection);
+
+			connect(m_client, SIGNAL(sendData(quint64,QByteArray,int)),
+				m_controller, SLOT(sendData(quint64,QByteArray,int)), Qt::DirectConnection);
 
 			connect(m_controller, SIGNAL(localRadioAddress(quint64)), 
 				m_client, SLOT(localRadioAddress(quint64)));
@@ -59,6 +62,18 @@ ZigbeeGatewayConsole::ZigbeeGatewayConsole(QSettings *settings, QObject *parent)
 
 			connect(m_controller, SIGNAL(nodeDiscoverResponse(QList<ZigbeeStats>)),
 				m_client, SLOT(nodeDiscoverResponse(QList<ZigbeeStats>)), Qt::DirectConnection);
+
+			connect(m_controller, SIGNAL(nodeUpdate(ZigbeeStats)),
+				m_client, SLOT(nodeUpdate(ZigbeeStats)), Qt::DirectConnection);
+
+			connect(m_controller, SIGNAL(deliveryReport(quint64, int, int)),
+				m_client, SLOT(deliveryReport(quint64, int, int)), Qt::DirectConnection);
+
+			connect(m_controller, SIGNAL(txCongestion(quint64, bool)),
+				m_client, SLOT(txCongestion(quint64, bool)), Qt::DirectConnection);
+
+			connect(m_controller, SIGNAL(txDropped(quint64, int)),
+				m_client, SLOT(txDropped(quint64, int)), Qt::DirectConnection);
 		}
 
 		connect(m_controller, SIGNAL(localRadioAddress(quint64)), 
@@ -70,6 +85,9 @@ ZigbeeGatewayConsole::ZigbeeGatewayConsole(QSettings *settings, QObject *parent)
 		connect(m_controller, SIGNAL(nodeDiscoverResponse(QList<ZigbeeStats>)),
 				this, SLOT(nodeDiscoverResponse(QList<ZigbeeStats>)), Qt::DirectConnection);
 
+		connect(m_controller, SIGNAL(nodeUpdate(ZigbeeStats)),
+				this, SLOT(nodeUpdate(ZigbeeStats)), Qt::DirectConnection);
+
 		connect(this, SIGNAL(requestNodeIDChange(quint64, QString)),
 			m_controller, SLOT(requestNodeIDChange(quint64, QString)));
 
@@ -94,8 +112,8 @@ void ZigbeeGatewayConsole::aboutToQuit()
             connect(m_controller, SIGNAL(receiveData(quint64, QByteArray)),
                 m_client, SLOT(receiveData(quint64, QByteArray)), Qt::DirectConnection);
 
-            connect(m_client, SIGNAL(sendData(quint64,QByteArray)),
-                m_controller, SLOT(sendData(quint64,QByteArray)), Qt::DirectConnection);
+            connect(m_client, SIGNAL(sendData(quint64,QByteArray,int)),
+                m_controller, SLOT(sendData(quint64,QByteArray,int)), Qt::DirectConnection);
 
             connect(m_controller, SIGNAL(localRadioAddress(quint64)),
                 m_client, SLOT(localRadioAddress(quint64)));
@@ -155,18 +173,23 @@ void ZigbeeGatewayConsole::loadNodeIDList()
 
 void ZigbeeGatewayConsole::nodeDiscoverResponse(QList<ZigbeeStats> list)
 {
-	ZigbeeStats zb;
+	for (int i = 0; i < list.count(); i++)
+		checkNodeID(list.at(i));
+}
 
-	for (int i = 0; i < list.count(); i++) {
-		zb = list.at(i);
+void ZigbeeGatewayConsole::nodeUpdate(ZigbeeStats zb)
+{
+	checkNodeID(zb);
+}
 
-		if (m_nodeIDs.contains(zb.m_address)) {
-			if (m_nodeIDs[zb.m_address] != zb.m_nodeID)
-				emit requestNodeIDChange(zb.m_address, m_nodeIDs[zb.m_address]);
-		}
-		else if (zb.m_nodeID.length() > 0) {
-			m_nodeIDs.insert(zb.m_address, zb.m_nodeID);
-		}
+void ZigbeeGatewayConsole::checkNodeID(const ZigbeeStats &zb)
+{
+	if (m_nodeIDs.contains(zb.m_address)) {
+		if (m_nodeIDs[zb.m_address] != zb.m_nodeID)
+			emit requestNodeIDChange(zb.m_address, m_nodeIDs[zb.m_address]);
+	}
+	else if (zb.m_nodeID.length() > 0) {
+		m_nodeIDs.insert(zb.m_address, zb.m_nodeID);
 	}
 }
 
@@ -182,27 +205,122 @@ void ZigbeeGatewayConsole::showStats()
 	if (m_localAddress != 0)
 		printf("\nLocal radio: %16llx\n\n", m_localAddress);
 
-	printf("         Address               Node ID  TX Count  RX Count\n");
-	printf("----------------  --------------------  --------  --------\n");
+	printf("         Address               Node ID  TX Count  RX Count   Retries    Failed\n");
+	printf("----------------  --------------------  --------  --------  --------  --------\n");
 
 	for (int i = 0; i < list.count(); i++) {
 		ZigbeeStats zb = list.at(i);
 
 		if (zb.m_deviceType & ZIGBEE_DEVICE_TYPE_LOCAL) {
-			printf("%16llx* %20s  %8d  %8d\n",
+			printf("%16llx* %20s  %8d  %8d  %8d  %8d\n",
 				zb.m_address,
 				qPrintable(zb.m_nodeID),
 				zb.m_txCount,
-				zb.m_rxCount);
+				zb.m_rxCount,
+				zb.m_txMacRetries,
+				zb.m_txFailures);
 		}
 		else {
-			printf("%16llx  %20s  %8d  %8d\n",
+			printf("%16llx  %20s  %8d  %8d  %8d  %8d\n",
 				zb.m_address,
 				qPrintable(zb.m_nodeID),
 				zb.m_txCount,
-				zb.m_rxCount);
+				zb.m_rxCount,
+				zb.m_txMacRetries,
+				zb.m_txFailures);
 		}
 	}
+
+	quint32 unclaimed = m_controller->unclaimedFrames();
+
+	if (unclaimed > 0)
+		printf("\nUnclaimed frames: %u\n", unclaimed);
+
+	showPerfStats();
+}
+
+void ZigbeeGatewayConsole::showPerfStats()
+{
+	ZigbeePerfStats perf = m_controller->perfStats();
+
+	printf("\nRX: %llu frames  %llu bytes  %u frames/s  %u bytes/s\n",
+		perf.m_rxFrames, perf.m_rxBytes, perf.m_rxFramesPerSec, perf.m_rxBytesPerSec);
+
+	printf("TX: %llu frames  %llu bytes  %u frames/s  %u bytes/s\n",
+		perf.m_txFrames, perf.m_txBytes, perf.m_txFramesPerSec, perf.m_txBytesPerSec);
+
+	if (perf.m_txWrites > 0) {
+		printf("TX writes: %llu  %.1f frames/write (max %u)  %.1f bytes/write (max %u)  %u partial\n",
+			perf.m_txWrites,
+			(double)perf.m_txFrames / perf.m_txWrites, perf.m_txWriteMaxFrames,
+			(double)perf.m_txBytes / perf.m_txWrites, perf.m_txWriteMaxBytes,
+			perf.m_txPartialWrites);
+	}
+
+	printf("Frame IDs: %d in flight  %u timed out  %u late  %u writer stalls\n",
+		perf.m_txLeasesLive, perf.m_txLeaseTimeouts, perf.m_txLateResponses, perf.m_txLeaseStalls);
+
+	printf("TX queue: %d queued  %d destinations blocked  %d congested  %u dropped  %u retries  %u failed\n",
+		perf.m_txQueued, perf.m_txBlocked, perf.m_txCongested, perf.m_txDropped, perf.m_txRetries, perf.m_txFailed);
+
+	printf("TX classes: control %d/%u  interactive %d/%u  bulk %d/%u (queued/dropped)\n",
+		perf.m_txClassQueued[ZIGBEE_TX_CONTROL], perf.m_txClassDropped[ZIGBEE_TX_CONTROL],
+		perf.m_txClassQueued[ZIGBEE_TX_INTERACTIVE], perf.m_txClassDropped[ZIGBEE_TX_INTERACTIVE],
+		perf.m_txClassQueued[ZIGBEE_TX_BULK], perf.m_txClassDropped[ZIGBEE_TX_BULK]);
+
+	printf("Fragments: NP %d  %u sent  %u reassembled  %u timed out  %u overflowed  %u malformed\n",
+		perf.m_maxPayload, perf.m_txFragments, perf.m_rxReassembled, perf.m_rxReassemblyTimeouts,
+		perf.m_rxReassemblyOverflows, perf.m_rxBadFragments);
+
+	printf("Bundles: %u sent  %u messages\n", perf.m_txBundles, perf.m_txBundledMessages);
+
+	printf("Frame pool: %u reused  %u allocated\n", perf.m_framePoolHits, perf.m_framePoolMisses);
+
+	printf("AT batches: %d pending  %u done  %u commands  %u timed out\n",
+		perf.m_atBatchesPending, perf.m_atBatchesDone, perf.m_atCommands, perf.m_atTimeouts);
+
+	printf("Address cache: %d entries  %u hits\n", perf.m_addressCacheEntries, perf.m_addressCacheHits);
+
+	printf("Source routes: %d known  %u records  %u changes  %u sent  %u expired\n",
+		perf.m_sourceRoutes, perf.m_routeRecords, perf.m_routeChanges, perf.m_sourceRoutesSent,
+		perf.m_sourceRoutesExpired);
+
+	printf("Pacing: %d frames/s  %u up  %u down  %u stalls  %u MAC retries  %u window cuts\n",
+		perf.m_txRate, perf.m_txRateIncreases, perf.m_txRateDecreases, perf.m_txPaceStalls,
+		perf.m_txMacRetries, perf.m_txWindowCuts);
+
+	if (perf.m_flowControl)
+		printf("Flow control: %u CTS holds  %lld msecs held\n", perf.m_ctsStalls, perf.m_ctsStallTime);
+
+	showHistograms("RX latency", perf.m_rxLatency);
+	showHistograms("TX queue dwell", perf.m_txDwell);
+	showHistograms("TX response", perf.m_txResponse);
+}
+
+void ZigbeeGatewayConsole::showHistograms(const char *title, const QMap<int, ZigbeeHistogram> &map)
+{
+	if (map.isEmpty())
+		return;
+
+	printf("\n%s (usecs)\n\n", title);
+	printf("Type     Count      Mean       p50       p99       Max\n");
+	printf("----  --------  --------  --------  --------  --------\n");
+
+	QMapIterator<int, ZigbeeHistogram> i(map);
+
+	while (i.hasNext()) {
+		i.next();
+
+		const ZigbeeHistogram &h = i.value();
+
+		printf("0x%02X  %8u  %8u  %8u  %8u  %8u\n",
+			i.key(),
+			h.m_count,
+			h.mean(),
+			h.percentile(50),
+			h.percentile(99),
+			h.m_max);
+	}
 }
 
 void ZigbeeGatewayConsole::showHelp()
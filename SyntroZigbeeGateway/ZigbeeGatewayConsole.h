@@ -38,6 +38,7 @@ public slots:
 	void aboutToQuit();
 	void localRadioAddress(quint64 address);
 	void nodeDiscoverResponse(QList<ZigbeeStats>);
+	void nodeUpdate(ZigbeeStats);
 
 signals:
 	void requestNodeDiscover();
@@ -48,7 +49,10 @@ protected:
 
 private:
 	void loadNodeIDList();
+	void checkNodeID(const ZigbeeStats &zb);
 	void showStats();
+	void showPerfStats();
+	void showHistograms(const char *title, const QMap<int, ZigbeeHistogram> &map);
 	void showHelp();
 
 	QSettings *m_settings;
@@ -87,6 +87,18 @@ QSettings *loadSettings(QStringList arglist)
 	if (!settings->contains(MULTICAST_Q_EXPIRE_INTERVAL))
 		settings->setValue(MULTICAST_Q_EXPIRE_INTERVAL, 60);
 
+	if (!settings->contains(ZIGBEE_API_MODE))
+		settings->setValue(ZIGBEE_API_MODE, 1);
+
+	if (!settings->contains(ZIGBEE_IO_THREAD))
+		settings->setValue(ZIGBEE_IO_THREAD, false);
+
+	if (!settings->contains(ZIGBEE_IO_PRIORITY))
+		settings->setValue(ZIGBEE_IO_PRIORITY, 0);
+
+	if (!settings->contains(ZIGBEE_IO_CPU))
+		settings->setValue(ZIGBEE_IO_CPU, -1);
+
 	if (!settings->contains(ZIGBEE_MULTICAST_SERVICE))
 		settings->setValue(ZIGBEE_MULTICAST_SERVICE, "zbmc");
 
@@ -0,0 +1,8 @@
+HEADERS += ../Common/ZigbeeEscape.h \
+    ../Common/ZigbeeUtils.h \
+    ../Common/ZigbeeFramePool.h
+
+SOURCES += main.cpp \
+    ../Common/ZigbeeEscape.cpp \
+    ../Common/ZigbeeUtils.cpp \
+    ../Common/ZigbeeFramePool.cpp
@@ -0,0 +1,24 @@
+TEMPLATE = app
+TARGET = ZigbeeBench
+
+win32* {
+	DESTDIR = Release
+}
+else {
+	DESTDIR = Output
+}
+
+QT += core
+QT -= gui
+
+CONFIG += release console
+
+unix {
+	macx:CONFIG -= app_bundle
+}
+
+INCLUDEPATH += ../Common
+
+OBJECTS_DIR += Release
+
+include(ZigbeeBench.pri)
@@ -0,0 +1,759 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <qelapsedtimer.h>
+#include <qvector.h>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <poll.h>
+#endif
+
+#include "ZigbeeCommon.h"
+#include "ZigbeeEscape.h"
+#include "ZigbeeUtils.h"
+#include "ZigbeeFramePool.h"
+
+// Micro-benchmarks for the hot paths of the controller. Each one runs
+// the code on synthetic frames and compares the per-frame cost to the
+// time the frame takes on the wire.
+
+#define BENCH_FRAMES 4096
+#define BENCH_ROUNDS 200
+
+// bits per byte on the wire, 8N1
+#define BITS_PER_CHAR 10
+
+static const int benchSpeeds[] = { 115200, 230400, 921600 };
+
+// keeps the compiler from optimizing the work away
+static volatile int benchSink;
+
+static void usage(const char *argv_0)
+{
+	printf("Usage: %s <benchmark> [args]\n", argv_0);
+	printf("Benchmarks:\n");
+	printf("  escape                 AP=2 escape/unescape codec\n");
+	printf("  encode                 E2E message to transmit request\n");
+	printf("  route <port> [nodes]   first packet latency with and without source routes\n");
+	printf("  at <port> [nodes]      remote AT reads one at a time and pipelined\n");
+	exit(1);
+}
+
+// the obvious byte at a time version, for comparison
+static int escapeReference(const char *src, int len, char *dst)
+{
+	int n = 0;
+
+	for (int i = 0; i < len; i++) {
+		quint8 c = 0xff & src[i];
+
+		if (c == ZIGBEE_START_DELIM || c == ZIGBEE_ESCAPE_CHAR || c == ZIGBEE_XON || c == ZIGBEE_XOFF) {
+			dst[n++] = ZIGBEE_ESCAPE_CHAR;
+			dst[n++] = c ^ ZIGBEE_ESCAPE_XOR;
+		}
+		else {
+			dst[n++] = c;
+		}
+	}
+
+	return n;
+}
+
+static void fillFrames(char *frames, int frameLen, bool worstCase)
+{
+	static const quint8 special[] = { ZIGBEE_START_DELIM, ZIGBEE_ESCAPE_CHAR, ZIGBEE_XON, ZIGBEE_XOFF };
+
+	for (int i = 0; i < BENCH_FRAMES * frameLen; i++) {
+		if (worstCase)
+			frames[i] = special[rand() & 3];
+		else
+			frames[i] = rand() & 0xff;
+	}
+}
+
+static void reportWireCost(double nsPerFrame, int wireLen, const char *what)
+{
+	for (unsigned int i = 0; i < sizeof(benchSpeeds) / sizeof(benchSpeeds[0]); i++) {
+		double wireNs = (1e9 * BITS_PER_CHAR * wireLen) / benchSpeeds[i];
+
+		printf("    %7d baud: %10.1f ns on the wire, %s is %.4f%%\n",
+			benchSpeeds[i], wireNs, what, 100.0 * nsPerFrame / wireNs);
+	}
+}
+
+static void benchEscapeCase(int frameLen, bool worstCase)
+{
+	char *frames = new char[BENCH_FRAMES * frameLen];
+	char *escaped = new char[2 * frameLen];
+	char *check = new char[2 * frameLen];
+	char *unescaped = new char[frameLen];
+	QElapsedTimer timer;
+	qint64 refNs, escNs, unescNs;
+	int escapedTotal = 0;
+	int written;
+	bool pending;
+
+	fillFrames(frames, frameLen, worstCase);
+
+	// make sure the fast path agrees with the reference before timing it
+	for (int i = 0; i < BENCH_FRAMES; i++) {
+		const char *f = frames + i * frameLen;
+
+		int n = zigbeeEscape(f, frameLen, escaped);
+
+		if (n != escapeReference(f, frameLen, check) || memcmp(escaped, check, n)) {
+			printf("Escape mismatch on frame %d\n", i);
+			exit(1);
+		}
+
+		pending = false;
+		zigbeeUnescape(escaped, n, unescaped, &written, &pending);
+
+		if (written != frameLen || memcmp(unescaped, f, frameLen)) {
+			printf("Unescape mismatch on frame %d\n", i);
+			exit(1);
+		}
+
+		escapedTotal += n;
+	}
+
+	timer.start();
+
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		for (int i = 0; i < BENCH_FRAMES; i++)
+			benchSink += escapeReference(frames + i * frameLen, frameLen, escaped);
+	}
+
+	refNs = timer.nsecsElapsed();
+
+	timer.restart();
+
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		for (int i = 0; i < BENCH_FRAMES; i++)
+			benchSink += zigbeeEscape(frames + i * frameLen, frameLen, escaped);
+	}
+
+	escNs = timer.nsecsElapsed();
+
+	int n = zigbeeEscape(frames, frameLen, escaped);
+
+	timer.restart();
+
+	for (int r = 0; r < BENCH_ROUNDS * BENCH_FRAMES; r++) {
+		pending = false;
+		benchSink += zigbeeUnescape(escaped, n, unescaped, &written, &pending);
+	}
+
+	unescNs = timer.nsecsElapsed();
+
+	double count = (double)BENCH_ROUNDS * BENCH_FRAMES;
+	int wireLen = 1 + escapedTotal / BENCH_FRAMES;
+
+	printf("\n%d byte frames, %s, %d bytes on the wire on average\n",
+		frameLen, worstCase ? "all special bytes" : "random bytes", wireLen);
+
+	printf("  reference escape: %8.1f ns/frame\n", refNs / count);
+	printf("  escape:           %8.1f ns/frame  %7.1f MB/s\n", escNs / count, (count * frameLen * 1000.0) / escNs);
+	printf("  unescape:         %8.1f ns/frame  %7.1f MB/s\n", unescNs / count, (count * frameLen * 1000.0) / unescNs);
+
+	reportWireCost((escNs + unescNs) / count, wireLen, "codec");
+
+	delete [] unescaped;
+	delete [] check;
+	delete [] escaped;
+	delete [] frames;
+}
+
+static void benchEscape()
+{
+	static const int frameLens[] = { 24, 100, 255 };
+
+	srand(1);
+
+	for (unsigned int i = 0; i < sizeof(frameLens) / sizeof(frameLens[0]); i++) {
+		benchEscapeCase(frameLens[i], false);
+		benchEscapeCase(frameLens[i], true);
+	}
+}
+
+// frames a destination might have queued, what the pool has to cover
+#define ENCODE_IN_FLIGHT 32
+
+#define ENCODE_MESSAGES 200000
+
+// What the gateway used to do with an E2E message. The client copies the
+// payload out, the controller appends the frame together a field at a
+// time and walks it again for the checksum, then the writer's frame id
+// detaches another copy.
+static QByteArray encodeReference(quint64 address, quint16 netAddress, const char *payload, int len)
+{
+	QByteArray data(payload, len);
+	QByteArray packet;
+
+	packet.reserve(18 + len);
+	packet.append(ZIGBEE_START_DELIM);
+	putU16(&packet, 14 + len);
+	packet.append(ZIGBEE_FT_TRANSMIT_REQUEST);
+	packet.append((char)0x00);
+	putU64(&packet, address);
+	putU16(&packet, netAddress);
+	packet.append((char)0x00);
+	packet.append((char)0x00);
+	packet.append(data);
+
+	quint8 sum = 0;
+
+	for (int i = 3; i < packet.length(); i++)
+		sum += 0xff & packet.at(i);
+
+	packet.append((char)(0xff - sum));
+
+	QByteArray queued = packet;
+	queued[4] = 1;
+
+	return packet;
+}
+
+// The pool path, the payload goes straight from the E2E message into a
+// reused buffer and the frame id only ever goes in the wire copy.
+static QByteArray encodePooled(ZigbeeFramePool *pool, const ZigbeeTxTemplate &txTemplate,
+		const char *payload, int len)
+{
+	QByteArray data = QByteArray::fromRawData(payload, len);
+
+	return pool->encodeTransmitRequest(txTemplate, data.constData(), data.length());
+}
+
+static void benchEncodeCase(int len)
+{
+	static QByteArray inFlight[ENCODE_IN_FLIGHT];
+	ZigbeeFramePool pool;
+	ZigbeeTxTemplate txTemplate;
+	QElapsedTimer timer;
+	char payload[256];
+	quint64 address = 0x0013a20040000001ULL;
+	quint16 netAddress = 0x1234;
+	qint64 refNs, poolNs;
+
+	for (int i = 0; i < len; i++)
+		payload[i] = rand() & 0xff;
+
+	txTemplate.set(address, netAddress);
+
+	QByteArray ref = encodeReference(address, netAddress, payload, len);
+	QByteArray pooled = encodePooled(&pool, txTemplate, payload, len);
+
+	if (ref.length() != pooled.length() || memcmp(ref.constData(), pooled.constData(), ref.length())) {
+		printf("Encode mismatch for %d bytes\n", len);
+		exit(1);
+	}
+
+	// each frame is held as if queued until ENCODE_IN_FLIGHT later ones
+	timer.start();
+
+	for (int i = 0; i < ENCODE_MESSAGES; i++)
+		inFlight[i % ENCODE_IN_FLIGHT] = encodeReference(address, netAddress, payload, len);
+
+	refNs = timer.nsecsElapsed();
+
+	for (int i = 0; i < ENCODE_IN_FLIGHT; i++)
+		inFlight[i] = QByteArray();
+
+	timer.restart();
+
+	for (int i = 0; i < ENCODE_MESSAGES; i++)
+		inFlight[i % ENCODE_IN_FLIGHT] = encodePooled(&pool, txTemplate, payload, len);
+
+	poolNs = timer.nsecsElapsed();
+
+	for (int i = 0; i < ENCODE_IN_FLIGHT; i++)
+		inFlight[i] = QByteArray();
+
+	printf("\n%d byte payload, %d byte frame\n", len, ref.length());
+	printf("  append and copy:  %8.1f ns/message\n", (double)refNs / ENCODE_MESSAGES);
+	printf("  pool:             %8.1f ns/message  %u reused  %u allocated\n",
+		(double)poolNs / ENCODE_MESSAGES, pool.m_hits, pool.m_misses);
+
+	reportWireCost((double)poolNs / ENCODE_MESSAGES, ref.length(), "encoding");
+}
+
+static void benchEncode()
+{
+	static const int payloadLens[] = { 8, 32, 72, 200 };
+
+	srand(1);
+
+	for (unsigned int i = 0; i < sizeof(payloadLens) / sizeof(payloadLens[0]); i++)
+		benchEncodeCase(payloadLens[i]);
+}
+
+#ifdef Q_OS_UNIX
+
+// how long to listen for route records after setting AR, and for a
+// transmit status
+#define ROUTE_RECORD_WAIT 2000
+#define ROUTE_STATUS_WAIT 5000
+
+#define ROUTE_MAX_NODES 256
+#define ROUTE_MAX_HOPS 40
+
+struct routeRecord
+{
+	quint64 address;
+	quint16 netAddress;
+	int hops;
+	quint16 hop[ROUTE_MAX_HOPS];
+};
+
+struct routeReader
+{
+	int fd;
+	unsigned char buff[1024];
+	int count;
+};
+
+static unsigned char frameChecksum(const unsigned char *data, int len)
+{
+	unsigned char sum = 0;
+
+	for (int i = 0; i < len; i++)
+		sum += data[i];
+
+	return 0xff - sum;
+}
+
+static quint64 getBE(const unsigned char *p, int len)
+{
+	quint64 val = 0;
+
+	for (int i = 0; i < len; i++)
+		val = (val << 8) + p[i];
+
+	return val;
+}
+
+static void putBE(unsigned char *p, quint64 val, int len)
+{
+	for (int i = len - 1; i >= 0; i--) {
+		p[i] = 0xff & val;
+		val >>= 8;
+	}
+}
+
+// frame data is type onwards, AP=1 only
+static bool writeApiFrame(int fd, const unsigned char *data, int len)
+{
+	unsigned char frame[300];
+
+	frame[0] = ZIGBEE_START_DELIM;
+	putBE(frame + 1, len, 2);
+	memcpy(frame + 3, data, len);
+	frame[3 + len] = frameChecksum(data, len);
+
+	return write(fd, frame, len + 4) == len + 4;
+}
+
+// The next good frame's data, type onwards, into data. Returns its length,
+// 0 if nothing came within msecs.
+static int readApiFrame(routeReader *rd, unsigned char *data, int msecs)
+{
+	QElapsedTimer timer;
+	struct pollfd pfd;
+
+	timer.start();
+
+	while (true) {
+		// drop anything in front of a delimiter
+		int start = 0;
+
+		while (start < rd->count && rd->buff[start] != ZIGBEE_START_DELIM)
+			start++;
+
+		if (start > 0) {
+			memmove(rd->buff, rd->buff + start, rd->count - start);
+			rd->count -= start;
+		}
+
+		if (rd->count >= 3) {
+			int len = (int)getBE(rd->buff + 1, 2);
+
+			if (len == 0 || len + 4 > (int)sizeof(rd->buff)) {
+				memmove(rd->buff, rd->buff + 1, --rd->count);
+				continue;
+			}
+
+			if (rd->count >= len + 4) {
+				bool good = frameChecksum(rd->buff + 3, len) == rd->buff[3 + len];
+
+				if (good)
+					memcpy(data, rd->buff + 3, len);
+
+				rd->count -= len + 4;
+				memmove(rd->buff, rd->buff + len + 4, rd->count);
+
+				if (good)
+					return len;
+
+				continue;
+			}
+		}
+
+		int left = msecs - (int)timer.elapsed();
+
+		if (left <= 0)
+			return 0;
+
+		pfd.fd = rd->fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+
+		if (poll(&pfd, 1, left) <= 0)
+			continue;
+
+		int n = read(rd->fd, rd->buff + rd->count, sizeof(rd->buff) - rd->count);
+
+		if (n > 0)
+			rd->count += n;
+	}
+}
+
+// Turns the radio into a concentrator and collects the route records
+// that come back, one per node.
+static int collectRoutes(routeReader *rd, routeRecord *routes, int maxRoutes)
+{
+	unsigned char data[300];
+	int count = 0;
+	int len;
+
+	data[0] = ZIGBEE_FT_AT_COMMAND;
+	data[1] = 1;
+	putBE(data + 2, ZIGBEE_AT_CMD_AR, 2);
+	data[4] = 0;
+
+	if (!writeApiFrame(rd->fd, data, 5)) {
+		printf("Write failed\n");
+		return 0;
+	}
+
+	while (count < maxRoutes && (len = readApiFrame(rd, data, ROUTE_RECORD_WAIT)) > 0) {
+		if (data[0] != ZIGBEE_FT_ROUTE_RECORD_IND || len < 13)
+			continue;
+
+		int hops = data[12];
+
+		if (hops > ROUTE_MAX_HOPS || len < 13 + 2 * hops)
+			continue;
+
+		routeRecord *route = routes + count++;
+
+		route->address = getBE(data + 1, 8);
+		route->netAddress = (quint16)getBE(data + 9, 2);
+		route->hops = hops;
+
+		for (int i = 0; i < hops; i++)
+			route->hop[i] = (quint16)getBE(data + 13 + 2 * i, 2);
+	}
+
+	return count;
+}
+
+// Usecs from writing a transmit request to its status coming back, with
+// a create source route in front if sourceRouted. -1 on a timeout.
+static qint64 firstPacket(routeReader *rd, const routeRecord *route, bool sourceRouted, quint8 frameID,
+		int *discovery)
+{
+	unsigned char data[300];
+	QElapsedTimer timer;
+	int len;
+
+	timer.start();
+
+	if (sourceRouted) {
+		data[0] = ZIGBEE_FT_CREATE_SOURCE_ROUTE;
+		data[1] = 0;
+		putBE(data + 2, route->address, 8);
+		putBE(data + 10, route->netAddress, 2);
+		data[12] = 0;
+		data[13] = route->hops;
+
+		for (int i = 0; i < route->hops; i++)
+			putBE(data + 14 + 2 * i, route->hop[i], 2);
+
+		writeApiFrame(rd->fd, data, 14 + 2 * route->hops);
+	}
+
+	data[0] = ZIGBEE_FT_TRANSMIT_REQUEST;
+	data[1] = frameID;
+	putBE(data + 2, route->address, 8);
+	putBE(data + 10, route->netAddress, 2);
+	data[12] = 0;
+	data[13] = 0;
+	memset(data + 14, 0x55, 16);
+
+	writeApiFrame(rd->fd, data, 30);
+
+	while ((len = readApiFrame(rd, data, ROUTE_STATUS_WAIT - (int)timer.elapsed())) > 0) {
+		if (data[0] == ZIGBEE_FT_TRANSMIT_STATUS && len >= 7 && data[1] == frameID) {
+			*discovery = data[6];
+			return timer.nsecsElapsed() / 1000;
+		}
+	}
+
+	return -1;
+}
+
+static void reportFirstPacket(const char *label, const QVector<qint64> &usecs, int discoveries, int timeouts)
+{
+	qint64 total = 0;
+	qint64 minUsecs = 0;
+	qint64 maxUsecs = 0;
+
+	for (int i = 0; i < usecs.count(); i++) {
+		total += usecs.at(i);
+
+		if (i == 0 || usecs.at(i) < minUsecs)
+			minUsecs = usecs.at(i);
+
+		if (usecs.at(i) > maxUsecs)
+			maxUsecs = usecs.at(i);
+	}
+
+	printf("  %-14s %4d nodes  mean %9.3f ms  min %9.3f ms  max %9.3f ms  %d route discoveries  %d timeouts\n",
+		label, usecs.count(), usecs.count() ? total / (1000.0 * usecs.count()) : 0.0,
+		minUsecs / 1000.0, maxUsecs / 1000.0, discoveries, timeouts);
+}
+
+// Against zb-emulator -R <ms>, or a real concentrator. Every node gets
+// exactly one transmit request, so each one is a first packet. Alternate
+// nodes go with and without the source route from their route record.
+static void benchRoute(const char *port, int maxNodes)
+{
+	static routeRecord routes[ROUTE_MAX_NODES];
+	QVector<qint64> aodv, sourceRouted;
+	int aodvDiscoveries = 0, sourceDiscoveries = 0;
+	int aodvTimeouts = 0, sourceTimeouts = 0;
+	struct termios tio;
+	routeReader rd;
+
+	rd.fd = open(port, O_RDWR | O_NOCTTY);
+	rd.count = 0;
+
+	if (rd.fd < 0) {
+		printf("Error opening %s\n", port);
+		exit(1);
+	}
+
+	tcgetattr(rd.fd, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(rd.fd, TCSANOW, &tio);
+
+	int count = collectRoutes(&rd, routes, qMin(maxNodes, ROUTE_MAX_NODES));
+
+	printf("\n%d route records\n", count);
+
+	if (count < 2) {
+		close(rd.fd);
+		exit(1);
+	}
+
+	for (int i = 0; i < count; i++) {
+		bool useRoute = (i & 1) != 0;
+		int discovery = 0;
+
+		qint64 usecs = firstPacket(&rd, routes + i, useRoute, 1 + (i % 255), &discovery);
+
+		if (usecs < 0) {
+			if (useRoute)
+				sourceTimeouts++;
+			else
+				aodvTimeouts++;
+
+			continue;
+		}
+
+		if (useRoute) {
+			sourceRouted.append(usecs);
+
+			if (discovery & 0x02)
+				sourceDiscoveries++;
+		}
+		else {
+			aodv.append(usecs);
+
+			if (discovery & 0x02)
+				aodvDiscoveries++;
+		}
+	}
+
+	close(rd.fd);
+
+	printf("First packet to a node, write to transmit status:\n");
+	reportFirstPacket("route discovery", aodv, aodvDiscoveries, aodvTimeouts);
+	reportFirstPacket("source route", sourceRouted, sourceDiscoveries, sourceTimeouts);
+}
+
+// the controller's AT_BATCH_WINDOW
+#define AT_BENCH_WINDOW 8
+
+static void writeRemoteNIRead(int fd, const routeRecord *node, quint8 frameID)
+{
+	unsigned char data[32];
+
+	data[0] = ZIGBEE_FT_REMOTE_AT_COMMAND;
+	data[1] = frameID;
+	putBE(data + 2, node->address, 8);
+	putBE(data + 10, node->netAddress, 2);
+	data[12] = 0;
+	putBE(data + 13, ZIGBEE_AT_CMD_NI, 2);
+
+	writeApiFrame(fd, data, 15);
+}
+
+// Reads NI from every node with up to window requests out at once, each
+// response matched to its request by frame id. Returns usecs for the
+// lot, the reads that got no answer are counted in timeouts.
+static qint64 remoteNIReads(routeReader *rd, const routeRecord *nodes, int count, int window, int *timeouts)
+{
+	unsigned char data[300];
+	bool answered[ROUTE_MAX_NODES];
+	QElapsedTimer timer;
+	int sent = 0, done = 0;
+	int len;
+
+	memset(answered, 0, sizeof(answered));
+	*timeouts = 0;
+	timer.start();
+
+	while (done < count) {
+		while (sent < count && sent - done < window) {
+			writeRemoteNIRead(rd->fd, nodes + sent, 1 + sent);
+			sent++;
+		}
+
+		len = readApiFrame(rd, data, ROUTE_STATUS_WAIT);
+
+		if (len == 0) {
+			// give up on everything still out
+			*timeouts += sent - done;
+			done = sent;
+			continue;
+		}
+
+		if (data[0] != ZIGBEE_FT_REMOTE_COMMAND_RESPONSE || len < 15)
+			continue;
+
+		int index = data[1] - 1;
+
+		if (index < 0 || index >= sent || answered[index])
+			continue;
+
+		answered[index] = true;
+		done++;
+	}
+
+	return timer.nsecsElapsed() / 1000;
+}
+
+// Against zb-emulator -d <ms>, or a real network. The same remote reads
+// serialized the way the controller used to send AT commands, then
+// pipelined the way an AT batch sends them.
+static void benchAT(const char *port, int maxNodes)
+{
+	static routeRecord nodes[ROUTE_MAX_NODES];
+	struct termios tio;
+	routeReader rd;
+	int timeouts;
+
+	rd.fd = open(port, O_RDWR | O_NOCTTY);
+	rd.count = 0;
+
+	if (rd.fd < 0) {
+		printf("Error opening %s\n", port);
+		exit(1);
+	}
+
+	tcgetattr(rd.fd, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(rd.fd, TCSANOW, &tio);
+
+	// frame ids are one byte
+	int count = collectRoutes(&rd, nodes, qMin(maxNodes, 255));
+
+	printf("\n%d nodes\n", count);
+
+	if (count < 1) {
+		close(rd.fd);
+		exit(1);
+	}
+
+	printf("Remote NI read from every node:\n");
+
+	qint64 usecs = remoteNIReads(&rd, nodes, count, 1, &timeouts);
+
+	printf("  %-14s total %9.3f ms  %9.3f ms/read  %d timeouts\n", "one at a time",
+		usecs / 1000.0, usecs / (1000.0 * count), timeouts);
+
+	usecs = remoteNIReads(&rd, nodes, count, AT_BENCH_WINDOW, &timeouts);
+
+	printf("  %-14s total %9.3f ms  %9.3f ms/read  %d timeouts\n", "pipelined",
+		usecs / 1000.0, usecs / (1000.0 * count), timeouts);
+
+	close(rd.fd);
+}
+
+#endif
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+		usage(argv[0]);
+
+	if (!strcmp(argv[1], "escape")) {
+		benchEscape();
+	}
+	else if (!strcmp(argv[1], "encode")) {
+		benchEncode();
+	}
+#ifdef Q_OS_UNIX
+	else if (!strcmp(argv[1], "route")) {
+		if (argc < 3)
+			usage(argv[0]);
+
+		benchRoute(argv[2], argc > 3 ? atoi(argv[3]) : ROUTE_MAX_NODES);
+	}
+	else if (!strcmp(argv[1], "at")) {
+		if (argc < 3)
+			usage(argv[0]);
+
+		benchAT(argv[2], argc > 3 ? atoi(argv[3]) : ROUTE_MAX_NODES);
+	}
+#endif
+	else {
+		usage(argv[0]);
+	}
+
+	return 0;
+}
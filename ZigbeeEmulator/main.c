@@ -0,0 +1,1110 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//	
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <termios.h>
+#include <poll.h>
+#include <time.h>
+
+// Pretends to be an XBee coordinator in API mode on the master side of a
+// pseudo-terminal, with a number of remote nodes behind it, so the gateway
+// can be load tested without hardware. Point zigbeePort at the pty.
+
+int openPty(const char *linkName);
+void closePty(int fd);
+int setSigHandler();
+void sigHandler(int sig);
+void runLoop(int fd);
+
+void initNodes();
+void readInput(int fd);
+void processFrame(int fd, unsigned char *rxBuff, int len);
+void processATCommand(int fd, unsigned char *rxBuff, int len);
+void processRemoteATCommand(int fd, unsigned char *rxBuff, int len);
+void processTransmitRequest(int fd, unsigned char *rxBuff, int len);
+void processCreateSourceRoute(unsigned char *rxBuff, int len);
+void sendNodeTraffic(int fd, int node);
+void sendNodeAnnounce(int node, long long due);
+void sendRouteRecord(int node, long long due);
+int buildNodeRecord(unsigned char *buff, int node);
+void sendATResponse(int fd, unsigned char frameID, unsigned int cmd, unsigned char status,
+		unsigned char *data, int dataLen);
+int findNode(unsigned char *addr);
+
+void queueFrame(long long due, unsigned char *frame, int len);
+void sendDueFrames(int fd, long long now);
+long long nextDue(long long now);
+
+int finishFrame(unsigned char *txBuff, int len);
+void writePacket(int fd, unsigned char *txBuff, int len);
+int isEscapeByte(unsigned char c);
+unsigned char calculateChecksum(unsigned char *buff, int len);
+
+void showStats(long long now);
+void debugDump(const char *prompt, unsigned char *buff, int len);
+long long usecs();
+unsigned int getU32(unsigned char *buff);
+void putU16(unsigned char *buff, unsigned int val);
+void putU32(unsigned char *buff, unsigned int val);
+
+
+#define MAX_NODES                      256
+#define MAX_FRAMELEN                   300
+#define MAX_DELAYED                    1024
+#define MAX_NODE_ID                    20
+
+// a node is this many hops out, cycling through 1 to MAX_HOPS
+#define MAX_HOPS                       4
+
+// real radios spread ND responses out over NT, we don't need to wait that long
+#define ND_RESPONSE_SPACING            10000
+#define STATS_INTERVAL                 10000000
+
+#define ZIGBEE_START_DELIM             0x7E
+#define ZIGBEE_ESCAPE_CHAR             0x7D
+#define ZIGBEE_XON                     0x11
+#define ZIGBEE_XOFF                    0x13
+#define ZIGBEE_ESCAPE_XOR              0x20
+
+#define ZIGBEE_FT_AT_COMMAND           0x08
+#define ZIGBEE_FT_AT_COMMAND_QUEUED    0x09
+#define ZIGBEE_FT_TRANSMIT_REQUEST     0x10
+#define ZIGBEE_FT_CREATE_SOURCE_ROUTE  0x21
+#define ZIGBEE_FT_REMOTE_AT_COMMAND    0x17
+#define ZIGBEE_FT_AT_COMMAND_RESPONSE  0x88
+#define ZIGBEE_FT_MODEM_STATUS         0x8A
+#define ZIGBEE_FT_TRANSMIT_STATUS      0x8B
+#define ZIGBEE_FT_RECEIVE_PACKET       0x90
+#define ZIGBEE_FT_NODE_ID_IND          0x95
+#define ZIGBEE_FT_REMOTE_AT_RESPONSE   0x97
+#define ZIGBEE_FT_ROUTE_RECORD_IND     0xA1
+
+#define ZIGBEE_AT_CMD_AC               0x4143
+#define ZIGBEE_AT_CMD_AR               0x4152
+
+#define ZIGBEE_AT_CMD_SH               0x5348
+#define ZIGBEE_AT_CMD_SL               0x534C
+#define ZIGBEE_AT_CMD_ID               0x4944
+#define ZIGBEE_AT_CMD_NI               0x4E49
+#define ZIGBEE_AT_CMD_ND               0x4E44
+
+#define AT_STATUS_OK                   0
+#define AT_STATUS_INVALID_COMMAND      2
+
+#define DELIVERY_SUCCESS               0x00
+#define DELIVERY_NETWORK_ACK_FAILURE   0x21
+
+#define DISCOVERY_NONE                 0x00
+#define DISCOVERY_ROUTE                0x02
+
+#define LOCAL_ADDRESS_HIGH             0x0013A200
+#define LOCAL_ADDRESS_LOW              0x40000000
+#define EMULATOR_PAN_ID                0x00000000000E4D00ULL
+
+struct node {
+	unsigned int addressLow;
+	unsigned short netAddress;
+	char nodeID[MAX_NODE_ID + 1];
+	unsigned int sequence;
+	long long nextTx;
+
+	// the radio found a route to it with a route discovery
+	int routeKnown;
+};
+
+struct delayedFrame {
+	long long due;
+	int len;
+	unsigned char buff[MAX_FRAMELEN];
+};
+
+// some globals
+int shutdownTime;
+int verbose;
+int escapedMode;
+int announceNodes;
+int numNodes = 4;
+double nodeRate = 1.0;
+int payloadLen = 16;
+int statusDelay;
+int routeDelay;
+int lossPercent;
+char localNodeID[MAX_NODE_ID + 1] = "EMULATOR";
+char linkName[128];
+
+// AR, 0xFF is not a concentrator, and the node whose route the gateway
+// loaded with a create source route, -1 for none
+int manyToOne = 0xFF;
+int sourceRouteNode = -1;
+
+struct node nodes[MAX_NODES];
+
+struct delayedFrame delayed[MAX_DELAYED];
+int numDelayed;
+
+unsigned char rxBuff[MAX_FRAMELEN + 4];
+int rxCount;
+int rxEscapeNext;
+
+unsigned long rxFrames, txFrames, txStatusFrames, lostFrames, droppedFrames, badFrames;
+unsigned long routeDiscoveries, sourceRouted;
+long long lastStatsTime;
+
+
+void usage(const char *argv_0)
+{
+	printf("Usage: %s [-n <nodes>] [-r <rate>] [-l <len>] [-d <ms>] [-R <ms>] [-x <pct>] [-L <link>] [-a] [-j] [-v]\n", argv_0);
+	printf("Options:\n");
+	printf("  -n <nodes>        remote nodes to simulate, default 4, max %d\n", MAX_NODES);
+	printf("  -r <rate>         receive packets per second from each node, default 1, 0 for none\n");
+	printf("  -l <len>          receive packet payload length, default 16\n");
+	printf("  -d <ms>           delay before a transmit status, default 0\n");
+	printf("  -R <ms>           extra delay for a route discovery, default 0\n");
+	printf("  -x <pct>          percent of transmits that fail delivery, default 0\n");
+	printf("  -L <link>         make a symlink to the pty, e.g. /tmp/ttyZB\n");
+	printf("  -a                escaped API mode, AP=2\n");
+	printf("  -j                nodes send a node identification indicator at startup\n");
+	printf("  -v                verbose debug output\n");
+	printf("  -h                show this help\n\n");
+	printf("  Example: %s -n 20 -r 10 -d 5 -x 1 -L /tmp/ttyZB\n", argv_0);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, fd;
+
+	while ((opt = getopt(argc, argv, "n:r:l:d:R:x:L:ajvh")) != -1) {
+		switch (opt) {
+		case 'n':
+			numNodes = atoi(optarg);
+
+			if (numNodes < 0 || numNodes > MAX_NODES)
+				usage(argv[0]);
+
+			break;
+
+		case 'r':
+			nodeRate = atof(optarg);
+
+			if (nodeRate < 0.0)
+				usage(argv[0]);
+
+			break;
+
+		case 'l':
+			payloadLen = atoi(optarg);
+
+			// 12 bytes of 0x90 header and the frame type
+			if (payloadLen < 4 || payloadLen > MAX_FRAMELEN - 16)
+				usage(argv[0]);
+
+			break;
+
+		case 'd':
+			statusDelay = atoi(optarg);
+			break;
+
+		case 'R':
+			routeDelay = atoi(optarg);
+
+			if (routeDelay < 0)
+				usage(argv[0]);
+
+			break;
+
+		case 'x':
+			lossPercent = atoi(optarg);
+
+			if (lossPercent < 0 || lossPercent > 100)
+				usage(argv[0]);
+
+			break;
+
+		case 'L':
+			if (strlen(optarg) > sizeof(linkName) - 1) {
+				printf("Link argument too long [%u] : %s\n", 
+					(unsigned int)strlen(optarg), optarg);
+
+				exit(1);
+			}
+
+			strcpy(linkName, optarg);
+			break;
+
+		case 'a':
+			escapedMode = 1;
+			break;
+
+		case 'j':
+			announceNodes = 1;
+			break;
+
+		case 'v':
+			verbose = 1;
+			break;
+
+		case 'h':
+		default:
+			usage(argv[0]);
+			break;
+		}
+	}
+
+	if (setSigHandler() < 0)
+		exit(1);
+
+	fd = openPty(linkName);
+
+	if (fd < 0)
+		exit(1);
+
+	srand(time(NULL));
+
+	initNodes();
+
+	runLoop(fd);
+
+	closePty(fd);
+
+	return 0;
+}
+
+int setSigHandler()
+{
+	struct sigaction sia;
+
+	bzero(&sia, sizeof(sia));
+	sia.sa_handler = sigHandler;
+
+	if (sigaction(SIGINT, &sia, NULL) < 0) {
+		perror("sigaction(SIGINT)");
+		return -1;
+	}
+	else if (sigaction(SIGTERM, &sia, NULL) < 0) {
+		perror("sigaction(SIGTERM)");
+		return -1;
+	}
+	else if (sigaction(SIGHUP, &sia, NULL) < 0) {
+		perror("sigaction(SIGHUP)");
+		return -1;
+	}
+
+	return 0;
+}
+
+void sigHandler(int sig)
+{
+	if (sig == SIGINT || sig == SIGTERM || sig == SIGHUP)
+		shutdownTime = 1;
+}
+
+// slave side, held open so the master keeps working across gateway restarts
+int slaveFd = -1;
+
+int openPty(const char *link)
+{
+	struct termios tio;
+	char *slaveName;
+	int fd;
+
+	if ((fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0) {
+		perror("posix_openpt");
+		return -1;
+	}
+
+	if (grantpt(fd) < 0 || unlockpt(fd) < 0) {
+		perror("grantpt/unlockpt");
+		close(fd);
+		return -1;
+	}
+
+	slaveName = ptsname(fd);
+
+	if ((slaveFd = open(slaveName, O_RDWR | O_NOCTTY)) < 0) {
+		perror("open slave");
+		close(fd);
+		return -1;
+	}
+
+	// no echo or newline mangling before the gateway gets to set the port up
+	tcgetattr(slaveFd, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(slaveFd, TCSANOW, &tio);
+
+	// a full pty drops frames like a radio with no flow control would
+	if (fcntl(fd, F_SETFL, O_NONBLOCK) == -1) {
+		perror("fcntl(F_SETFL)");
+		close(slaveFd);
+		close(fd);
+		return -1;
+	}
+
+	if (*link) {
+		unlink(link);
+
+		if (symlink(slaveName, link) < 0) {
+			perror("symlink");
+			link = NULL;
+		}
+	}
+
+	printf("Emulating a coordinator on %s%s%s\n", slaveName, 
+		(link && *link) ? " linked from " : "", (link && *link) ? link : "");
+
+	fflush(stdout);
+
+	return fd;
+}
+
+void closePty(int fd)
+{
+	if (*linkName)
+		unlink(linkName);
+
+	close(slaveFd);
+	close(fd);
+}
+
+void initNodes()
+{
+	int i;
+	long long now = usecs();
+
+	for (i = 0; i < numNodes; i++) {
+		nodes[i].addressLow = LOCAL_ADDRESS_LOW + i + 1;
+		nodes[i].netAddress = 0x1000 + i;
+		sprintf(nodes[i].nodeID, "NODE%d", i + 1);
+		nodes[i].sequence = 0;
+		nodes[i].routeKnown = 0;
+
+		// spread the nodes out so they don't all send at once
+		if (nodeRate > 0.0)
+			nodes[i].nextTx = now + (long long)((1000000.0 / nodeRate) * i / numNodes);
+
+		if (announceNodes)
+			sendNodeAnnounce(i, now + (i * ND_RESPONSE_SPACING));
+	}
+}
+
+void runLoop(int fd)
+{
+	struct pollfd pfd;
+	long long now, due, nextStats;
+	int i, timeout;
+
+	if (verbose)
+		printf("Starting run loop\n");
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	lastStatsTime = usecs();
+	nextStats = lastStatsTime + STATS_INTERVAL;
+
+	while (!shutdownTime) {
+		now = usecs();
+
+		sendDueFrames(fd, now);
+
+		if (nodeRate > 0.0) {
+			for (i = 0; i < numNodes; i++) {
+				// catch up, but don't burst forever after a stall
+				if (nodes[i].nextTx <= now) {
+					sendNodeTraffic(fd, i);
+					nodes[i].nextTx += (long long)(1000000.0 / nodeRate);
+
+					if (nodes[i].nextTx < now - 1000000)
+						nodes[i].nextTx = now;
+				}
+			}
+		}
+
+		if (now >= nextStats) {
+			showStats(now);
+			nextStats += STATS_INTERVAL;
+		}
+
+		due = nextDue(now);
+
+		if (due > nextStats)
+			due = nextStats;
+
+		timeout = (int)((due - now + 999) / 1000);
+
+		if (timeout < 0)
+			timeout = 0;
+
+		pfd.revents = 0;
+
+		if (poll(&pfd, 1, timeout) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("poll");
+			break;
+		}
+
+		if (pfd.revents & POLLIN)
+			readInput(fd);
+	}
+
+	showStats(usecs());
+
+	if (verbose)
+		printf("Received shutdown signal\n");
+}
+
+// the earliest time anything needs to happen
+long long nextDue(long long now)
+{
+	long long due = now + 1000000;
+	int i;
+
+	for (i = 0; i < numDelayed; i++) {
+		if (delayed[i].due < due)
+			due = delayed[i].due;
+	}
+
+	if (nodeRate > 0.0) {
+		for (i = 0; i < numNodes; i++) {
+			if (nodes[i].nextTx < due)
+				due = nodes[i].nextTx;
+		}
+	}
+
+	return due;
+}
+
+void readInput(int fd)
+{
+	unsigned char buff[256];
+	unsigned char c;
+	int i, len, framelen;
+
+	len = read(fd, buff, sizeof(buff));
+
+	for (i = 0; i < len; i++) {
+		c = buff[i];
+
+		if (escapedMode) {
+			// a raw delimiter always starts a new frame
+			if (c == ZIGBEE_START_DELIM) {
+				rxCount = 0;
+				rxEscapeNext = 0;
+			}
+			else if (c == ZIGBEE_ESCAPE_CHAR) {
+				rxEscapeNext = 1;
+				continue;
+			}
+			else if (rxEscapeNext) {
+				c ^= ZIGBEE_ESCAPE_XOR;
+				rxEscapeNext = 0;
+			}
+		}
+
+		if (rxCount == 0 && c != ZIGBEE_START_DELIM)
+			continue;
+
+		rxBuff[rxCount++] = c;
+
+		if (rxCount < 3)
+			continue;
+
+		framelen = (rxBuff[1] << 8) + rxBuff[2];
+
+		if (framelen == 0 || framelen + 4 > sizeof(rxBuff)) {
+			badFrames++;
+			rxCount = 0;
+			continue;
+		}
+
+		if (rxCount < framelen + 4)
+			continue;
+
+		if (calculateChecksum(rxBuff + 3, framelen) != rxBuff[framelen + 3]) {
+			if (verbose)
+				debugDump("bad checksum:", rxBuff, rxCount);
+
+			badFrames++;
+		}
+		else {
+			if (verbose)
+				debugDump("rx:", rxBuff, rxCount);
+
+			rxFrames++;
+			processFrame(fd, rxBuff, rxCount);
+		}
+
+		rxCount = 0;
+	}
+}
+
+void processFrame(int fd, unsigned char *frame, int len)
+{
+	switch (frame[3]) {
+	case ZIGBEE_FT_AT_COMMAND:
+	case ZIGBEE_FT_AT_COMMAND_QUEUED:
+		processATCommand(fd, frame, len);
+		break;
+
+	case ZIGBEE_FT_REMOTE_AT_COMMAND:
+		processRemoteATCommand(fd, frame, len);
+		break;
+
+	case ZIGBEE_FT_TRANSMIT_REQUEST:
+		processTransmitRequest(fd, frame, len);
+		break;
+
+	case ZIGBEE_FT_CREATE_SOURCE_ROUTE:
+		processCreateSourceRoute(frame, len);
+		break;
+
+	default:
+		if (verbose)
+			printf("Ignoring frame type 0x%02X\n", frame[3]);
+
+		break;
+	}
+}
+
+void processATCommand(int fd, unsigned char *frame, int len)
+{
+	unsigned char data[MAX_FRAMELEN];
+	unsigned char frameID;
+	unsigned int cmd;
+	int i, paramLen;
+	long long now;
+
+	if (len < 8)
+		return;
+
+	frameID = frame[4];
+	cmd = (frame[5] << 8) + frame[6];
+	paramLen = len - 8;
+
+	switch (cmd) {
+	case ZIGBEE_AT_CMD_SH:
+		putU32(data, LOCAL_ADDRESS_HIGH);
+		sendATResponse(fd, frameID, cmd, AT_STATUS_OK, data, 4);
+		break;
+
+	case ZIGBEE_AT_CMD_SL:
+		putU32(data, LOCAL_ADDRESS_LOW);
+		sendATResponse(fd, frameID, cmd, AT_STATUS_OK, data, 4);
+		break;
+
+	case ZIGBEE_AT_CMD_ID:
+		putU32(data, (unsigned int)(EMULATOR_PAN_ID >> 32));
+		putU32(data + 4, (unsigned int)EMULATOR_PAN_ID);
+		sendATResponse(fd, frameID, cmd, AT_STATUS_OK, data, 8);
+		break;
+
+	case ZIGBEE_AT_CMD_NI:
+		if (paramLen > 0) {
+			if (paramLen > MAX_NODE_ID)
+				paramLen = MAX_NODE_ID;
+
+			memcpy(localNodeID, frame + 7, paramLen);
+			localNodeID[paramLen] = 0;
+			sendATResponse(fd, frameID, cmd, AT_STATUS_OK, NULL, 0);
+		}
+		else {
+			sendATResponse(fd, frameID, cmd, AT_STATUS_OK,
+				(unsigned char *)localNodeID, strlen(localNodeID));
+		}
+
+		break;
+
+	// queued writes only touch NI and AR, which we apply as they come
+	case ZIGBEE_AT_CMD_AC:
+		sendATResponse(fd, frameID, cmd, AT_STATUS_OK, NULL, 0);
+		break;
+
+	case ZIGBEE_AT_CMD_AR:
+		if (paramLen > 0) {
+			manyToOne = frame[7];
+			sendATResponse(fd, frameID, cmd, AT_STATUS_OK, NULL, 0);
+
+			// the many-to-one broadcast goes out and every node answers
+			// with the path it took
+			if (manyToOne != 0xFF) {
+				now = usecs();
+
+				for (i = 0; i < numNodes; i++)
+					sendRouteRecord(i, now + ((i + 1) * ND_RESPONSE_SPACING));
+			}
+		}
+		else {
+			data[0] = manyToOne;
+			sendATResponse(fd, frameID, cmd, AT_STATUS_OK, data, 1);
+		}
+
+		break;
+
+	case ZIGBEE_AT_CMD_ND:
+		now = usecs();
+
+		// one response per remote node, the way the radio does it
+		for (i = 0; i < numNodes; i++) {
+			unsigned char txBuff[MAX_FRAMELEN];
+			int recLen = buildNodeRecord(data, i);
+
+			txBuff[0] = ZIGBEE_START_DELIM;
+			txBuff[3] = ZIGBEE_FT_AT_COMMAND_RESPONSE;
+			txBuff[4] = frameID;
+			putU16(txBuff + 5, cmd);
+			txBuff[7] = AT_STATUS_OK;
+			memcpy(txBuff + 8, data, recLen);
+
+			queueFrame(now + ((i + 1) * ND_RESPONSE_SPACING), txBuff, finishFrame(txBuff, 8 + recLen));
+		}
+
+		break;
+
+	default:
+		sendATResponse(fd, frameID, cmd, AT_STATUS_INVALID_COMMAND, NULL, 0);
+		break;
+	}
+}
+
+// MY, SH, SL, NI, parent, device type, status, profile and manufacturer,
+// the same in an ND response and a node identification indicator
+int buildNodeRecord(unsigned char *buff, int node)
+{
+	int len = strlen(nodes[node].nodeID);
+
+	putU16(buff, nodes[node].netAddress);
+	putU32(buff + 2, LOCAL_ADDRESS_HIGH);
+	putU32(buff + 6, nodes[node].addressLow);
+	memcpy(buff + 10, nodes[node].nodeID, len + 1);
+	len += 11;
+
+	putU16(buff + len, 0xFFFE);
+	buff[len + 2] = 0x01;   // router
+	buff[len + 3] = 0x00;
+	putU16(buff + len + 4, 0xC105);
+	putU16(buff + len + 6, 0x101E);
+
+	return len + 8;
+}
+
+// as if the commissioning button was pressed, or the node just joined with JN=1
+void sendNodeAnnounce(int node, long long due)
+{
+	unsigned char txBuff[MAX_FRAMELEN];
+	int recLen;
+
+	txBuff[0] = ZIGBEE_START_DELIM;
+	txBuff[3] = ZIGBEE_FT_NODE_ID_IND;
+	putU32(txBuff + 4, LOCAL_ADDRESS_HIGH);
+	putU32(txBuff + 8, nodes[node].addressLow);
+	putU16(txBuff + 12, nodes[node].netAddress);
+	txBuff[14] = 0x02;    // broadcast
+
+	recLen = buildNodeRecord(txBuff + 15, node);
+
+	// the source event, joined
+	txBuff[15 + recLen - 5] = 0x03;
+
+	queueFrame(due, txBuff, finishFrame(txBuff, 15 + recLen));
+}
+
+// The made up routers between a node and us, the node's neighbor first.
+// Nothing checks they exist, the gateway only echoes them back.
+void sendRouteRecord(int node, long long due)
+{
+	unsigned char txBuff[MAX_FRAMELEN];
+	int i, hops;
+
+	hops = 1 + (node % MAX_HOPS);
+
+	txBuff[0] = ZIGBEE_START_DELIM;
+	txBuff[3] = ZIGBEE_FT_ROUTE_RECORD_IND;
+	putU32(txBuff + 4, LOCAL_ADDRESS_HIGH);
+	putU32(txBuff + 8, nodes[node].addressLow);
+	putU16(txBuff + 12, nodes[node].netAddress);
+	txBuff[14] = 0x01;    // acknowledged
+	txBuff[15] = hops;
+
+	for (i = 0; i < hops; i++)
+		putU16(txBuff + 16 + (2 * i), 0x2000 + (node << 4) + i);
+
+	queueFrame(due, txBuff, finishFrame(txBuff, 16 + (2 * hops)));
+}
+
+// the radio only keeps the last one, no response
+void processCreateSourceRoute(unsigned char *frame, int len)
+{
+	int node;
+
+	if (len < 18)
+		return;
+
+	node = findNode(frame + 5);
+
+	if (node >= 0 && frame[16] > 0) {
+		sourceRouteNode = node;
+		return;
+	}
+
+	sourceRouteNode = -1;
+}
+
+void processRemoteATCommand(int fd, unsigned char *frame, int len)
+{
+	unsigned char txBuff[MAX_FRAMELEN];
+	unsigned char status = AT_STATUS_OK;
+	unsigned int cmd;
+	int node, paramLen;
+	int valueLen = 0;
+
+	if (len < 19)
+		return;
+
+	node = findNode(frame + 5);
+	cmd = (frame[16] << 8) + frame[17];
+	paramLen = len - 19;
+
+	// no response from a node that doesn't exist
+	if (node < 0)
+		return;
+
+	if (cmd == ZIGBEE_AT_CMD_NI && paramLen > 0) {
+		if (paramLen > MAX_NODE_ID)
+			paramLen = MAX_NODE_ID;
+
+		memcpy(nodes[node].nodeID, frame + 18, paramLen);
+		nodes[node].nodeID[paramLen] = 0;
+	}
+	else if (cmd == ZIGBEE_AT_CMD_NI) {
+		valueLen = strlen(nodes[node].nodeID);
+		memcpy(txBuff + 18, nodes[node].nodeID, valueLen);
+	}
+	else if (cmd != ZIGBEE_AT_CMD_AC) {
+		status = AT_STATUS_INVALID_COMMAND;
+	}
+
+	if (frame[4] == 0)
+		return;
+
+	txBuff[0] = ZIGBEE_START_DELIM;
+	txBuff[3] = ZIGBEE_FT_REMOTE_AT_RESPONSE;
+	txBuff[4] = frame[4];
+	putU32(txBuff + 5, LOCAL_ADDRESS_HIGH);
+	putU32(txBuff + 9, nodes[node].addressLow);
+	putU16(txBuff + 13, nodes[node].netAddress);
+	putU16(txBuff + 15, cmd);
+	txBuff[17] = status;
+
+	queueFrame(usecs() + (statusDelay * 1000LL), txBuff, finishFrame(txBuff, 18 + valueLen));
+}
+
+void processTransmitRequest(int fd, unsigned char *frame, int len)
+{
+	unsigned char txBuff[16];
+	long long delay = statusDelay * 1000LL;
+	int node;
+
+	if (len < 18)
+		return;
+
+	node = findNode(frame + 5);
+
+	txBuff[9] = DISCOVERY_NONE;
+
+	// the first transmit to a node without a source route waits on a
+	// route discovery, later ones reuse what it found
+	if (node >= 0 && node != sourceRouteNode) {
+		if (!nodes[node].routeKnown) {
+			delay += routeDelay * 1000LL;
+			txBuff[9] = DISCOVERY_ROUTE;
+			nodes[node].routeKnown = 1;
+			routeDiscoveries++;
+		}
+	}
+	else if (node >= 0) {
+		sourceRouted++;
+	}
+
+	txBuff[0] = ZIGBEE_START_DELIM;
+	txBuff[3] = ZIGBEE_FT_TRANSMIT_STATUS;
+	txBuff[4] = frame[4];
+	putU16(txBuff + 5, node < 0 ? 0xFFFE : nodes[node].netAddress);
+	txBuff[7] = 0;
+
+	if (node < 0 || (rand() % 100) < lossPercent) {
+		txBuff[8] = DELIVERY_NETWORK_ACK_FAILURE;
+		lostFrames++;
+
+		// the next one has to find a new route
+		if (node >= 0)
+			nodes[node].routeKnown = 0;
+	}
+	else {
+		txBuff[8] = DELIVERY_SUCCESS;
+	}
+
+	// frame id 0 asks for no status
+	if (frame[4] == 0)
+		return;
+
+	queueFrame(usecs() + delay, txBuff, finishFrame(txBuff, 10));
+}
+
+void sendNodeTraffic(int fd, int node)
+{
+	unsigned char txBuff[MAX_FRAMELEN];
+	int i;
+
+	txBuff[0] = ZIGBEE_START_DELIM;
+	txBuff[3] = ZIGBEE_FT_RECEIVE_PACKET;
+	putU32(txBuff + 4, LOCAL_ADDRESS_HIGH);
+	putU32(txBuff + 8, nodes[node].addressLow);
+	putU16(txBuff + 12, nodes[node].netAddress);
+	txBuff[14] = 0x01;    // acknowledged
+
+	// a sequence number so a receiver can spot gaps, then filler
+	putU32(txBuff + 15, nodes[node].sequence++);
+
+	for (i = 4; i < payloadLen; i++)
+		txBuff[15 + i] = 0xff & (node + i);
+
+	writePacket(fd, txBuff, finishFrame(txBuff, 15 + payloadLen));
+}
+
+void sendATResponse(int fd, unsigned char frameID, unsigned int cmd, unsigned char status,
+		unsigned char *data, int dataLen)
+{
+	unsigned char txBuff[MAX_FRAMELEN];
+
+	if (frameID == 0)
+		return;
+
+	txBuff[0] = ZIGBEE_START_DELIM;
+	txBuff[3] = ZIGBEE_FT_AT_COMMAND_RESPONSE;
+	txBuff[4] = frameID;
+	putU16(txBuff + 5, cmd);
+	txBuff[7] = status;
+
+	if (dataLen > 0)
+		memcpy(txBuff + 8, data, dataLen);
+
+	writePacket(fd, txBuff, finishFrame(txBuff, 8 + dataLen));
+}
+
+int findNode(unsigned char *addr)
+{
+	unsigned int low;
+	int node;
+
+	if (getU32(addr) != LOCAL_ADDRESS_HIGH)
+		return -1;
+
+	low = getU32(addr + 4);
+	node = low - (LOCAL_ADDRESS_LOW + 1);
+
+	if (node < 0 || node >= numNodes)
+		return -1;
+
+	return node;
+}
+
+void queueFrame(long long due, unsigned char *frame, int len)
+{
+	if (numDelayed >= MAX_DELAYED || len > MAX_FRAMELEN) {
+		droppedFrames++;
+		return;
+	}
+
+	delayed[numDelayed].due = due;
+	delayed[numDelayed].len = len;
+	memcpy(delayed[numDelayed].buff, frame, len);
+	numDelayed++;
+}
+
+void sendDueFrames(int fd, long long now)
+{
+	int i = 0;
+
+	while (i < numDelayed) {
+		if (delayed[i].due > now) {
+			i++;
+			continue;
+		}
+
+		writePacket(fd, delayed[i].buff, delayed[i].len);
+
+		// order doesn't matter, fill the hole with the last one
+		numDelayed--;
+
+		if (i < numDelayed)
+			delayed[i] = delayed[numDelayed];
+	}
+}
+
+// fills in the length and checksum given everything up to the checksum,
+// returns the length of the whole frame
+int finishFrame(unsigned char *txBuff, int len)
+{
+	int framelen = len - 3;
+
+	txBuff[1] = 0xff & (framelen >> 8);
+	txBuff[2] = 0xff & framelen;
+	txBuff[len] = calculateChecksum(txBuff + 3, framelen);
+
+	return len + 1;
+}
+
+unsigned char calculateChecksum(unsigned char *buff, int len)
+{
+	int i;
+	unsigned char sum = buff[0];
+
+	for (i = 1; i < len; i++)
+		sum += buff[i];
+
+	return 0xff - sum;
+}
+
+int isEscapeByte(unsigned char c)
+{
+	return c == ZIGBEE_START_DELIM || c == ZIGBEE_ESCAPE_CHAR
+		|| c == ZIGBEE_XON || c == ZIGBEE_XOFF;
+}
+
+// frames are written whole or not at all
+void writePacket(int fd, unsigned char *txBuff, int len)
+{
+	unsigned char escBuff[2 * (MAX_FRAMELEN + 4)];
+	int i, count;
+
+	if (verbose)
+		debugDump("tx:", txBuff, len);
+
+	if (escapedMode) {
+		// everything but the start delimiter
+		escBuff[0] = txBuff[0];
+
+		for (i = 1, count = 1; i < len; i++) {
+			if (isEscapeByte(txBuff[i])) {
+				escBuff[count++] = ZIGBEE_ESCAPE_CHAR;
+				escBuff[count++] = txBuff[i] ^ ZIGBEE_ESCAPE_XOR;
+			}
+			else {
+				escBuff[count++] = txBuff[i];
+			}
+		}
+
+		txBuff = escBuff;
+		len = count;
+	}
+
+	count = write(fd, txBuff, len);
+
+	if (count != len) {
+		// nobody reading, or not fast enough
+		droppedFrames++;
+		return;
+	}
+
+	if (txBuff[3] == ZIGBEE_FT_TRANSMIT_STATUS)
+		txStatusFrames++;
+
+	txFrames++;
+}
+
+void showStats(long long now)
+{
+	static unsigned long lastRx, lastTx;
+	double secs = (now - lastStatsTime) / 1000000.0;
+
+	if (secs <= 0.0)
+		secs = 1.0;
+
+	printf("rx %lu (%.0f/s)  tx %lu (%.0f/s)  status %lu  failed %lu  dropped %lu  bad %lu"
+		"  discoveries %lu  source routed %lu\n",
+		rxFrames, (rxFrames - lastRx) / secs, txFrames, (txFrames - lastTx) / secs,
+		txStatusFrames, lostFrames, droppedFrames, badFrames, routeDiscoveries, sourceRouted);
+
+	fflush(stdout);
+
+	lastStatsTime = now;
+	lastRx = rxFrames;
+	lastTx = txFrames;
+}
+
+void debugDump(const char *prompt, unsigned char *buff, int len)
+{
+	int i;
+
+	if (prompt)
+		printf("%s ", prompt);
+
+	for (i = 0; i < len; i++)
+		printf("%02X ", buff[i]);
+
+	printf("\n");
+}
+
+long long usecs()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (ts.tv_sec * 1000000LL) + (ts.tv_nsec / 1000);
+}
+
+unsigned int getU32(unsigned char *buff)
+{
+	unsigned int val = buff[0];
+	val <<= 8;
+	val += buff[1];
+	val <<= 8;
+	val += buff[2];
+	val <<= 8;
+	val += buff[3];
+
+	return val;
+}
+
+void putU16(unsigned char *buff, unsigned int val)
+{
+	buff[0] = 0xff & (val >> 8);
+	buff[1] = 0xff & val;
+}
+
+void putU32(unsigned char *buff, unsigned int val)
+{
+	buff[0] = 0xff & (val >> 24);
+	buff[1] = 0xff & (val >> 16);
+	buff[2] = 0xff & (val >> 8);
+	buff[3] = 0xff & val;
+}
@@ -2,12 +2,14 @@ HEADERS += MotionSensorViewer.h \
     ../../Common/ZigbeeCommon.h \
     ../../Common/ZigbeeUtils.h \
     ../../Common/ZigbeeStats.h \
+    ../../Common/ZigbeeIOSample.h \
     ../../Common/ZigbeeClient.h
 
 SOURCES += main.cpp \
     MotionSensorViewer.cpp \
     ../../Common/ZigbeeUtils.cpp \
     ../../Common/ZigbeeStats.cpp \
+    ../../Common/ZigbeeIOSample.cpp \
     ../../Common/ZigbeeClient.cpp
 
 
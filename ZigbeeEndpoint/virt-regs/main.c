@@ -44,6 +44,7 @@ void sendLocalATCommand(int fd, unsigned char frameID, unsigned int command);
 void processATCommandResponse(int fd, unsigned char *rxBuff, int len);
 
 void writePacket(int fd, unsigned char *txBuff, int len);
+int isEscapeByte(unsigned char c);
 unsigned char calculateChecksum(unsigned char *buff, int len);
 
 void debugDump(const char *prompt, unsigned char *buff, int len);
@@ -56,16 +57,18 @@ void putU32(unsigned char *buff, unsigned int val);
 struct termios oldtio;
 int shutdownTime;
 int verbose;
+int escapedMode;
 unsigned int localRadioAddressLow;
 unsigned int localRadioAddressHigh;
 
 
 void usage(const char *argv_0)
 {
-	printf("Usage: %s [-p <serial-port>] [-s <speed>]\n", argv_0);
+	printf("Usage: %s [-p <serial-port>] [-s <speed>] [-a]\n", argv_0);
 	printf("Options:\n");
 	printf("  -p <serial-port>  default is /dev/ttyUSB0\n");
 	printf("  -s <speed>        default is 115200\n");
+	printf("  -a                radio is in escaped API mode, AP=2\n");
 	printf("  -v                verbose debug output\n");
 	printf("  -h                show this help\n\n");
 	printf("  Example: %s -p /dev/ttyO1 -s 9600\n", argv_0);
@@ -80,7 +83,7 @@ int main(int argc, char **argv)
 
 	strcpy(port, "/dev/ttyUSB0");
 
-	while ((opt = getopt(argc, argv, "p:s:vh")) != -1) {
+	while ((opt = getopt(argc, argv, "p:s:avh")) != -1) {
 		switch (opt) {
 		case 'p':
 			if (strlen(optarg) > sizeof(port) - 1) {
@@ -97,6 +100,10 @@ int main(int argc, char **argv)
 			speed = atoi(optarg);
 			break;
 
+		case 'a':
+			escapedMode = 1;
+			break;
+
 		case 'v':
 			verbose = 1;
 			break;
@@ -231,6 +238,10 @@ void closePort(int fd)
 #define STATE_GET_CHECKSUM             4
 
 #define ZIGBEE_START_DELIM             0x7E
+#define ZIGBEE_ESCAPE_CHAR             0x7D
+#define ZIGBEE_XON                     0x11
+#define ZIGBEE_XOFF                    0x13
+#define ZIGBEE_ESCAPE_XOR              0x20
 
 #define ZIGBEE_FT_AT_COMMAND           0x08
 #define ZIGBEE_FT_TRANSMIT_REQUEST     0x10
@@ -245,7 +256,7 @@ void runCommandLoop(int fd)
 {
 	unsigned char buff[MAX_RXCHARS];
 	unsigned char c;
-	int count, state, framelen;
+	int count, state, framelen, escapeNext;
 	ssize_t readlen;
 
 	bzero(buff, MAX_RXCHARS);	
@@ -253,6 +264,7 @@ void runCommandLoop(int fd)
 	state = STATE_GET_START_DELIMITER;
 	framelen = 0;
 	count = 0;
+	escapeNext = 0;
 
 	if (verbose)
 		printf("Starting run loop\n");
@@ -273,6 +285,29 @@ void runCommandLoop(int fd)
 
 		//printf("--- %02X  count = %d  state = %d\n", c, count, state);
 
+		if (escapedMode) {
+			// a raw delimiter always starts a new frame
+			if (c == ZIGBEE_START_DELIM) {
+				if (state != STATE_GET_START_DELIMITER && verbose)
+					printf("Short frame, resyncing\n");
+
+				escapeNext = 0;
+				state = STATE_GET_START_DELIMITER;
+			}
+			else if (c == ZIGBEE_ESCAPE_CHAR) {
+				escapeNext = 1;
+				continue;
+			}
+			else if (escapeNext) {
+				c ^= ZIGBEE_ESCAPE_XOR;
+				escapeNext = 0;
+
+				// an escaped 0x7E is data, not the start of a frame
+				if (state == STATE_GET_START_DELIMITER)
+					continue;
+			}
+		}
+
 		switch (state) {
 		case STATE_GET_START_DELIMITER:
 			if (c == ZIGBEE_START_DELIM) {
@@ -289,7 +324,8 @@ void runCommandLoop(int fd)
 			if (count == 3) {
 				framelen = (buff[1] << 8) + buff[2];
 
-				if (framelen <= MAX_RXCHARS)
+				// room for the delimiter, length and checksum too
+				if (framelen + 4 <= MAX_RXCHARS)
 					state = STATE_GET_FRAME_TYPE;
 				else
 					state = STATE_GET_START_DELIMITER;
@@ -515,10 +551,40 @@ void processATCommandResponse(int fd, unsigned char *rxBuff, int len)
 	}
 }
 
+int isEscapeByte(unsigned char c)
+{
+	return c == ZIGBEE_START_DELIM || c == ZIGBEE_ESCAPE_CHAR
+		|| c == ZIGBEE_XON || c == ZIGBEE_XOFF;
+}
+
 void writePacket(int fd, unsigned char *txBuff, int len)
 {
-	int count;
+	int i, count;
 	int written = 0;
+	unsigned char *escBuff = NULL;
+
+	if (escapedMode) {
+		escBuff = malloc(2 * len);
+
+		if (!escBuff)
+			return;
+
+		// everything but the start delimiter
+		escBuff[0] = txBuff[0];
+
+		for (i = 1, count = 1; i < len; i++) {
+			if (isEscapeByte(txBuff[i])) {
+				escBuff[count++] = ZIGBEE_ESCAPE_CHAR;
+				escBuff[count++] = txBuff[i] ^ ZIGBEE_ESCAPE_XOR;
+			}
+			else {
+				escBuff[count++] = txBuff[i];
+			}
+		}
+
+		txBuff = escBuff;
+		len = count;
+	}
 
 	while (written < len) {
 		count = write(fd, txBuff + written, len - written);
@@ -530,6 +596,9 @@ void writePacket(int fd, unsigned char *txBuff, int len)
 
 		written += count;
 	}
+
+	if (escBuff)
+		free(escBuff);
 }
 
 void processWriteCommand(unsigned char *rxBuff, int start, int dataLen)
@@ -0,0 +1,91 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "ReplayReceiver.h"
+
+
+ReplayReceiver::ReplayReceiver()
+{
+	m_expected = 0;
+	m_received = 0;
+	m_lastReceived = 0;
+	m_clock.start();
+}
+
+qint64 ReplayReceiver::now() const
+{
+	return m_clock.nsecsElapsed();
+}
+
+// call before writing the bytes that complete the frame
+void ReplayReceiver::expect(qint64 sentAt)
+{
+	QMutexLocker lock(&m_mutex);
+
+	m_sent.enqueue(sentAt);
+	m_expected++;
+}
+
+int ReplayReceiver::expected()
+{
+	QMutexLocker lock(&m_mutex);
+
+	return m_expected;
+}
+
+int ReplayReceiver::received()
+{
+	QMutexLocker lock(&m_mutex);
+
+	return m_received;
+}
+
+qint64 ReplayReceiver::lastReceived()
+{
+	QMutexLocker lock(&m_mutex);
+
+	return m_lastReceived;
+}
+
+ZigbeeHistogram ReplayReceiver::latency()
+{
+	QMutexLocker lock(&m_mutex);
+
+	return m_latency;
+}
+
+// called on the controller's I/O thread
+void ReplayReceiver::receiveData(quint64, const QByteArray &)
+{
+	qint64 t = now();
+
+	QMutexLocker lock(&m_mutex);
+
+	m_received++;
+	m_lastReceived = t;
+
+	// more frames than the scan expected, nothing to match against
+	if (m_sent.isEmpty())
+		return;
+
+	qint64 usecs = (t - m_sent.dequeue()) / 1000;
+
+	m_latency.record(usecs < 0 ? 0 : (quint32)usecs);
+}
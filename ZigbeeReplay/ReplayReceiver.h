@@ -0,0 +1,60 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef REPLAY_RECEIVER_H
+#define REPLAY_RECEIVER_H
+
+#include <qobject.h>
+#include <qmutex.h>
+#include <qqueue.h>
+#include <qelapsedtimer.h>
+
+#include "ZigbeePerfStats.h"
+
+// Matches receiveData() signals from the controller against the times the
+// frames that should produce them finished going into the pty.
+class ReplayReceiver : public QObject
+{
+	Q_OBJECT
+
+public:
+	ReplayReceiver();
+
+	qint64 now() const;
+	void expect(qint64 sentAt);
+	int expected();
+	int received();
+	qint64 lastReceived();
+	ZigbeeHistogram latency();
+
+public slots:
+	void receiveData(quint64 address, const QByteArray &data);
+
+private:
+	QElapsedTimer m_clock;
+	QMutex m_mutex;
+	QQueue<qint64> m_sent;
+	ZigbeeHistogram m_latency;
+	int m_expected;
+	int m_received;
+	qint64 m_lastReceived;
+};
+
+#endif // REPLAY_RECEIVER_H
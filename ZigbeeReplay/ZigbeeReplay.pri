@@ -0,0 +1,41 @@
+HEADERS += ReplayReceiver.h \
+    ../Common/ZigbeeController.h \
+    ../Common/ZigbeeStats.h \
+    ../Common/ZigbeeCommon.h \
+    ../Common/ZigbeeUtils.h \
+    ../Common/ZigbeeRxRing.h \
+    ../Common/ZigbeeFrame.h \
+    ../Common/ZigbeeFrameHandler.h \
+    ../Common/ZigbeeTxFrame.h \
+    ../Common/ZigbeeTxScheduler.h \
+    ../Common/ZigbeeTxPacer.h \
+    ../Common/ZigbeeFrameLeases.h \
+    ../Common/ZigbeeFragment.h \
+    ../Common/ZigbeeBundle.h \
+    ../Common/ZigbeeAddressCache.h \
+    ../Common/ZigbeeSourceRoutes.h \
+    ../Common/ZigbeeFramePool.h \
+    ../Common/ZigbeeATBatch.h \
+    ../Common/ZigbeePerfStats.h \
+    ../Common/ZigbeeCapture.h \
+    ../Common/ZigbeeEscape.h \
+    ../Common/ZigbeeIOSample.h
+
+SOURCES += main.cpp \
+    ReplayReceiver.cpp \
+    ../Common/ZigbeeController.cpp \
+    ../Common/ZigbeeStats.cpp \
+    ../Common/ZigbeeUtils.cpp \
+    ../Common/ZigbeeRxRing.cpp \
+    ../Common/ZigbeePerfStats.cpp \
+    ../Common/ZigbeeCapture.cpp \
+    ../Common/ZigbeeFrameLeases.cpp \
+    ../Common/ZigbeeFragment.cpp \
+    ../Common/ZigbeeAddressCache.cpp \
+    ../Common/ZigbeeSourceRoutes.cpp \
+    ../Common/ZigbeeFramePool.cpp \
+    ../Common/ZigbeeATBatch.cpp \
+    ../Common/ZigbeeTxScheduler.cpp \
+    ../Common/ZigbeeTxPacer.cpp \
+    ../Common/ZigbeeEscape.cpp \
+    ../Common/ZigbeeIOSample.cpp
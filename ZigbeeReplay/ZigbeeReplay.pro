@@ -0,0 +1,28 @@
+TEMPLATE = app
+TARGET = ZigbeeReplay
+
+win32* {
+	DESTDIR = Release
+}
+else {
+	DESTDIR = Output
+}
+
+QT += core
+QT -= gui
+
+CONFIG += release console
+
+unix {
+	macx:CONFIG -= app_bundle
+}
+
+INCLUDEPATH += ../Common
+
+MOC_DIR += GeneratedFiles/Release
+
+OBJECTS_DIR += Release
+
+include(ZigbeeReplay.pri)
+
+include(../3rdparty/qextserialport/src/qextserialport.pri)
@@ -0,0 +1,424 @@
+//
+//  Copyright (c) 2012 Pansenti, LLC.
+//
+//  This file is part of Syntro
+//
+//  Syntro is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Syntro is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Syntro.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+#include <qcoreapplication.h>
+#include <qsettings.h>
+#include <qdir.h>
+#include <qfile.h>
+
+#include "ZigbeeController.h"
+#include "ZigbeeCapture.h"
+#include "ReplayReceiver.h"
+
+// Feeds the receive side of a capture from a gateway or test node into a
+// fresh controller through a pseudo-terminal and reports how it did.
+// The transmit side of the capture is not replayed, whatever the new
+// controller writes is read from the pty and thrown away.
+
+// how long to wait for the last frames to come out of the controller
+#define REPLAY_DRAIN_TIMEOUT 2000
+
+class ReplayRecord
+{
+public:
+	qint64 m_nsecs;
+	QByteArray m_data;
+
+	// receive data frames this record completes
+	int m_dataFrames;
+};
+
+// enough of a parser to know which records should produce receiveData()
+class FrameScanner
+{
+public:
+	FrameScanner(int apiMode) : m_apiMode(apiMode), m_escapePending(false) {}
+
+	int scan(const QByteArray &data);
+
+private:
+	int parse();
+
+	int m_apiMode;
+	bool m_escapePending;
+	QByteArray m_buff;
+};
+
+int FrameScanner::scan(const QByteArray &data)
+{
+	int count = 0;
+
+	for (int i = 0; i < data.length(); i++) {
+		quint8 c = 0xff & data.at(i);
+
+		if (m_apiMode == 2) {
+			// a raw delimiter always starts a new frame
+			if (c == ZIGBEE_START_DELIM) {
+				m_buff.clear();
+				m_escapePending = false;
+			}
+			else if (m_escapePending) {
+				c ^= ZIGBEE_ESCAPE_XOR;
+				m_escapePending = false;
+			}
+			else if (c == ZIGBEE_ESCAPE_CHAR) {
+				m_escapePending = true;
+				continue;
+			}
+		}
+
+		m_buff.append((char)c);
+		count += parse();
+	}
+
+	return count;
+}
+
+int FrameScanner::parse()
+{
+	int count = 0;
+
+	while (m_buff.length() > 0) {
+		int start = m_buff.indexOf((char)ZIGBEE_START_DELIM);
+
+		if (start < 0) {
+			m_buff.clear();
+			break;
+		}
+
+		if (start > 0)
+			m_buff.remove(0, start);
+
+		if (m_buff.length() < 3)
+			break;
+
+		int frameLen = ((0xff & m_buff.at(1)) << 8) + (0xff & m_buff.at(2));
+
+		if (frameLen == 0 || frameLen > MAX_RX_FRAME_LEN) {
+			m_buff.remove(0, 1);
+			continue;
+		}
+
+		if (m_buff.length() < frameLen + 4)
+			break;
+
+		quint8 sum = 0;
+
+		for (int i = 3; i < frameLen + 4; i++)
+			sum += 0xff & m_buff.at(i);
+
+		if (sum != 0xff) {
+			m_buff.remove(0, 1);
+			continue;
+		}
+
+		quint8 frameType = 0xff & m_buff.at(3);
+
+		if (frameType == ZIGBEE_FT_RECEIVE_PACKET || frameType == ZIGBEE_FT_EXPLICIT_RX_IND)
+			count++;
+
+		m_buff.remove(0, frameLen + 4);
+	}
+
+	return count;
+}
+
+static void usage(const char *argv_0)
+{
+	printf("Usage: %s [-s <speed>] <capture file>\n", argv_0);
+	printf("  -s <speed>    playback speed multiplier, 0 for as fast as possible (default 1)\n");
+	exit(1);
+}
+
+static bool loadCapture(const char *path, QList<ReplayRecord> *records, int *apiMode)
+{
+	ZigbeeCapture capture;
+	qint64 nsecs;
+	int direction;
+	QByteArray data;
+
+	if (!capture.openRead(path))
+		return false;
+
+	*apiMode = capture.apiMode();
+
+	FrameScanner scanner(*apiMode);
+
+	while (capture.read(&nsecs, &direction, &data)) {
+		if (direction != ZIGBEE_CAPTURE_RX)
+			continue;
+
+		ReplayRecord rec;
+
+		rec.m_nsecs = nsecs;
+		rec.m_data = data;
+		rec.m_dataFrames = scanner.scan(data);
+
+		records->append(rec);
+	}
+
+	return true;
+}
+
+static int openPty(QString *slaveName)
+{
+	int fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+	if (fd < 0) {
+		perror("posix_openpt");
+		return -1;
+	}
+
+	if (grantpt(fd) || unlockpt(fd)) {
+		perror("grantpt/unlockpt");
+		close(fd);
+		return -1;
+	}
+
+	*slaveName = ptsname(fd);
+
+	// so we can throw away what the controller writes without blocking
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	return fd;
+}
+
+static void drainPty(int fd)
+{
+	char buff[256];
+
+	while (read(fd, buff, sizeof(buff)) > 0)
+		;
+}
+
+static bool writePty(int fd, const char *data, int len)
+{
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN | POLLOUT;
+
+	while (len > 0) {
+		pfd.revents = 0;
+
+		if (poll(&pfd, 1, 1000) < 0 && errno != EINTR)
+			return false;
+
+		if (pfd.revents & POLLIN)
+			drainPty(fd);
+
+		if (!(pfd.revents & POLLOUT))
+			continue;
+
+		int n = write(fd, data, len);
+
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+
+			perror("write");
+			return false;
+		}
+
+		data += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+static void sleepUntil(ReplayReceiver *receiver, qint64 due, int fd)
+{
+	qint64 now = receiver->now();
+
+	while (now < due) {
+		struct timespec ts;
+		qint64 wait = qMin(due - now, (qint64)10000000);
+
+		ts.tv_sec = 0;
+		ts.tv_nsec = wait;
+		nanosleep(&ts, NULL);
+
+		drainPty(fd);
+		now = receiver->now();
+	}
+}
+
+static void report(const QList<ReplayRecord> &records, qint64 bytes, double speed, qint64 elapsed,
+				ZigbeePerfStats perf, ReplayReceiver *receiver)
+{
+	double secs = (double)elapsed / 1000000000.0;
+
+	if (secs <= 0.0)
+		secs = 1e-9;
+
+	printf("\nReplayed %d records, %lld bytes in %.3f s", records.count(), bytes, secs);
+
+	if (speed > 0.0)
+		printf(" at %gx\n", speed);
+	else
+		printf(" at max speed\n");
+
+	printf("\nFrames parsed:    %llu (%.0f frames/s)\n", perf.m_rxFrames, perf.m_rxFrames / secs);
+	printf("Checksum errors:  %u\n", perf.m_rxChecksumErrors);
+	printf("Resyncs:          %u\n", perf.m_rxResyncs);
+	printf("receiveData:      %d of %d expected\n", receiver->received(), receiver->expected());
+
+	ZigbeeHistogram latency = receiver->latency();
+
+	if (latency.m_count > 0) {
+		printf("\nreceiveData latency from the last byte written (usecs)\n\n");
+		printf("   Count      Mean       p50       p90       p99       Max\n");
+		printf("--------  --------  --------  --------  --------  --------\n");
+		printf("%8u  %8u  %8u  %8u  %8u  %8u\n",
+			latency.m_count,
+			latency.mean(),
+			latency.percentile(50),
+			latency.percentile(90),
+			latency.percentile(99),
+			latency.m_max);
+	}
+
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	QList<ReplayRecord> records;
+	QString slaveName;
+	double speed = 1.0;
+	int apiMode = 1;
+	int opt;
+
+	QCoreApplication a(argc, argv);
+
+	while ((opt = getopt(argc, argv, "s:h")) != -1) {
+		switch (opt) {
+		case 's':
+			speed = atof(optarg);
+
+			if (speed < 0.0)
+				usage(argv[0]);
+
+			break;
+
+		default:
+			usage(argv[0]);
+			break;
+		}
+	}
+
+	if (optind != argc - 1)
+		usage(argv[0]);
+
+	if (!loadCapture(argv[optind], &records, &apiMode))
+		return 1;
+
+	if (records.isEmpty()) {
+		printf("No receive records in %s\n", argv[optind]);
+		return 1;
+	}
+
+	int fd = openPty(&slaveName);
+
+	if (fd < 0)
+		return 1;
+
+	// the controller only takes its configuration from settings
+	QString iniFile = QDir::tempPath() + QString("/ZigbeeReplay-%1.ini").arg(getpid());
+
+	QSettings *settings = new QSettings(iniFile, QSettings::IniFormat);
+
+	settings->setValue(ZIGBEE_PORT, slaveName);
+	settings->setValue(ZIGBEE_SPEED, 115200);
+	settings->setValue(ZIGBEE_API_MODE, apiMode);
+	settings->setValue(ZIGBEE_IO_THREAD, true);
+	settings->setValue(NODE_DISCOVER_INTERVAL, 0);
+
+	ZigbeeController *controller = new ZigbeeController();
+	ReplayReceiver *receiver = new ReplayReceiver();
+
+	bool opened = controller->openDevice(settings);
+
+	delete settings;
+	QFile::remove(iniFile);
+
+	if (!opened) {
+		printf("Failed to open %s\n", qPrintable(slaveName));
+		return 1;
+	}
+
+	QObject::connect(controller, SIGNAL(receiveData(quint64,QByteArray)),
+		receiver, SLOT(receiveData(quint64,QByteArray)), Qt::DirectConnection);
+
+	controller->startRunLoop();
+
+	qint64 bytes = 0;
+	qint64 first = records.at(0).m_nsecs;
+	qint64 start = receiver->now();
+
+	for (int i = 0; i < records.count(); i++) {
+		const ReplayRecord &rec = records.at(i);
+
+		if (speed > 0.0)
+			sleepUntil(receiver, start + (qint64)((rec.m_nsecs - first) / speed), fd);
+
+		qint64 sentAt = receiver->now();
+
+		for (int j = 0; j < rec.m_dataFrames; j++)
+			receiver->expect(sentAt);
+
+		if (!writePty(fd, rec.m_data.constData(), rec.m_data.length()))
+			break;
+
+		bytes += rec.m_data.length();
+	}
+
+	// give the controller a chance to catch up
+	qint64 waitStart = receiver->now();
+
+	while (receiver->received() < receiver->expected()) {
+		if (receiver->now() - waitStart > (qint64)REPLAY_DRAIN_TIMEOUT * 1000000)
+			break;
+
+		sleepUntil(receiver, receiver->now() + 1000000, fd);
+	}
+
+	qint64 end = qMax(receiver->lastReceived(), waitStart);
+
+	report(records, bytes, speed, end - start, controller->perfStats(), receiver);
+
+	controller->closeDevice();
+	close(fd);
+
+	delete controller;
+	delete receiver;
+
+	return 0;
+}
@@ -82,6 +82,9 @@ void ZigbeeTestNode::onConnect()
 			connect(m_controller, SIGNAL(nodeDiscoverResponse(QList<ZigbeeStats>)),
 				this, SLOT(nodeDiscoverResponse(QList<ZigbeeStats>)), Qt::DirectConnection);
 
+			connect(m_controller, SIGNAL(nodeUpdate(ZigbeeStats)),
+				this, SLOT(nodeUpdate(ZigbeeStats)), Qt::DirectConnection);
+
 			m_controller->startRunLoop();
 			m_refreshTimer = startTimer(500);
 
@@ -126,6 +129,9 @@ void ZigbeeTestNode::onDisconnect()
 		disconnect(m_controller, SIGNAL(nodeDiscoverResponse(QList<ZigbeeStats>)),
 			this, SLOT(nodeDiscoverResponse(QList<ZigbeeStats>)));
 
+		disconnect(m_controller, SIGNAL(nodeUpdate(ZigbeeStats)),
+			this, SLOT(nodeUpdate(ZigbeeStats)));
+
 		delete m_controller;
 		m_controller = NULL;
 
@@ -168,6 +174,15 @@ void ZigbeeTestNode::nodeDiscoverResponse(QList<ZigbeeStats> list)
 	m_newRadioList = true;
 }
 
+void ZigbeeTestNode::nodeUpdate(ZigbeeStats zb)
+{
+	QMutexLocker lock(&m_radioListMutex);
+
+	m_radioList.insert(zb.m_address, zb);
+
+	m_newRadioList = true;
+}
+
 void ZigbeeTestNode::onSend()
 {
 	quint64 address = getCurrentRadio();
@@ -264,7 +279,7 @@ void ZigbeeTestNode::updateRadioListDisplay()
 	m_newRadioList = false;
 }
 
-void ZigbeeTestNode::receiveData(quint64 address, QByteArray data)
+void ZigbeeTestNode::receiveData(quint64 address, const QByteArray &data)
 {
 	QMutexLocker lock(&m_rxQMutex);
 
@@ -45,9 +45,10 @@ public slots:
 	void onConnect();
 	void onDisconnect();
 	void onConfigure();
-	void receiveData(quint64 address, QByteArray data);
+	void receiveData(quint64 address, const QByteArray &data);
 	void localRadioAddress(quint64 address);
 	void nodeDiscoverResponse(QList<ZigbeeStats>);
+	void nodeUpdate(ZigbeeStats);
 
 signals:
 	void requestNodeDiscover();